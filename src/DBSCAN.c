@@ -2,17 +2,27 @@
 #include <stdlib.h>
 #include <math.h>
 #include "io.h"
+#include "points.h"
+#include "options.h"
+#include "memory.h"
 #include "countPoints.h"
 #include "clusters.h"
+#include "cellDBSCAN.h"
+#include "optics.h"
 
 int main(int argc, char ** argv) {
 	
-	if(argc != 7) {
+	if(argc < 7) {
 		printf("ERROR! Incorrect number of input arguments\n");
-		printf("DBSCAN inputEvents output searchRadius minPts minCorPointsInEachCluster nonCorePoints\n");
+		printf("DBSCAN inputEvents output searchRadius minPts minCorPointsInEachCluster nonCorePoints [options]\n");
+		printOptionsUsage();
 		return 1;
 	}
 
+	struct options opts;
+	parseOptions(argc, argv, 7, &opts);
+	setMemoryPolicy(opts.hugePages, opts.numa);
+
 	double xMin = 999999999, yMin = 999999999, xMax = -999999999, yMax = -999999999;
 	
 	FILE * input;
@@ -52,16 +62,44 @@ int main(int argc, char ** argv) {
 
 	fclose(input);
 	
-	int nBlockX = ceil((xMax - xMin) / radius);
-	int nBlockY = ceil((yMax - yMin) / radius);
+	if(opts.subdivide == 0) {
+		opts.subdivide = pickSubdivide(x, y, count, xMin, yMin, xMax, yMax, radius);
+		printf("Index blocks per search radius: %d\n", opts.subdivide);
+	}
 
-	int * index;
+	struct gridIndex * index;
 
-	index = indexPoints(x, y, count, xMin, yMin, nBlockX, nBlockY, radius);
-	
-	int * countPoints = countInDistance_Single(x, y, index, nBlockX, nBlockY, radius);
+	index = indexPoints(x, y, count, xMin, yMin, xMax, yMax, radius, opts.subdivide, opts.order);
 
-	int * clusters = doClusterDBSCAN(x, y, index, nBlockX, nBlockY, radius, minPts, xMin, yMin, countPoints, minCore, nonCorePoints);
+	struct pointStore * ps = buildPointStore(x, y, NULL, count, opts.precision, xMin, yMin, xMax, yMax, opts.resolution, true);
+	boundBlocks(index, ps);
+	if(opts.validate) {
+		printf("Precision validation: %lld point pairs differ from double precision\n", validatePrecision(ps, index, radius, 20));
+	}
+	spillCoordinates(ps, opts.tmpDir);
+	printf("Point store: %.1lf bytes per point\n", pointStoreBytes(ps));
+	
+	struct neighborCounts * nc = NULL;
+	int * clusters;
+
+	if(opts.optics != NULL) {
+		//the clusters of searchRadius come from the ordering, as any smaller radius will
+		struct opticsOrder * oo = computeOPTICS(ps, index, radius, minPts);
+		saveOPTICS(opts.optics, oo);
+		clusters = extractDBSCAN(oo, radius, minCore, nonCorePoints);
+		freeOPTICS(oo);
+	}
+	else if(opts.engine == ENGINE_CELL) {
+		clusters = doClusterDBSCAN_Cells(ps, radius, minPts, minCore, nonCorePoints);
+	}
+	else if(opts.engine == ENGINE_APPROX) {
+		clusters = doClusterDBSCAN_Approx(ps, radius, opts.rho, minPts, minCore, nonCorePoints);
+	}
+	else {
+		nc = allocNeighborCounts(count, maxStencilCount(index), false);
+		countInDistance_Single(ps, index, radius, nc);
+		clusters = doClusterDBSCAN(ps, index, radius, minPts, nc, minCore, nonCorePoints);
+	}
 	
 	//Output 
 	if(NULL == (output = fopen(argv[2], "w"))) {
@@ -69,22 +107,23 @@ int main(int argc, char ** argv) {
 		exit(1);
 	}
 	
+	double px, py;
 	for(int i = 0; i < count; i++)
 	{
-		fprintf(output, "%lf,%lf,%d\n", x[i], y[i], clusters[i]);
+		originalPoint(ps, i, &px, &py);
+		fprintf(output, "%lf,%lf,%d\n", px, py, clusters[i]);
 	}
 
 	fclose(output);
 
 	free(clusters);
 
+	printMemoryReport();
 
+	freePointStore(ps);
 
-	free(x);
-	free(y);
-
-	free(index);
-	free(countPoints);
+	freeGridIndex(index);
+	freeNeighborCounts(nc);
 
 	return 0;
 }
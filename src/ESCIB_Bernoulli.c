@@ -3,15 +3,28 @@
 #include <math.h>
 #include <string.h>
 #include "io.h"
+#include "points.h"
+#include "options.h"
+#include "memory.h"
 #include "countPoints.h"
 #include "clusters.h"
 #include "mc.h"
+#include "mcio.h"
 
 int main(int argc, char ** argv) {
 
-	if(argc != 10) {
+	if(argc < 10) {
 		printf("ERROR! Incorrect number of input arguments\n");
-		printf("ESCIB_Bernoulli inputCase inputControl output searchRadius significance(alpha) baselineRatio minCorPointsInEachCluster nonCorePoints nSim\n");
+		printf("ESCIB_Bernoulli inputCase inputControl output searchRadius significance(alpha) baselineRatio minCorPointsInEachCluster nonCorePoints nSim [options]\n");
+		printOptionsUsage();
+		return 1;
+	}
+
+	struct options opts;
+	parseOptions(argc, argv, 10, &opts);
+	setMemoryPolicy(opts.hugePages, opts.numa);
+	if(opts.simEnd > atoi(argv[9])) {
+		printf("ERROR: -simRange ends after nSim\n");
 		return 1;
 	}
 
@@ -44,9 +57,12 @@ int main(int argc, char ** argv) {
 	}
 
 		
-	int countCas = getCount(inputCas, xMin, xMax, yMin, yMax);
-	int countCon = getCount(inputCon, xMin, xMax, yMin, yMax);
-	int count = countCas + countCon;
+	//a weighted line stands for as many points at its location, the points are counted in the tests and the locations are stored
+	int countCas, countCon;
+	int nCas = getCount(inputCas, xMin, xMax, yMin, yMax, countCas);
+	int nCon = getCount(inputCon, xMin, xMax, yMin, yMax, countCon);
+	int count = nCas + nCon;
+	bool weighted = opts.collapse || countCas != nCas || countCon != nCon;
 
 	double * x;
 	double * y;
@@ -67,77 +83,99 @@ int main(int argc, char ** argv) {
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
+	int * weight = NULL;
+	if(weighted && NULL == (weight = (int *)malloc(sizeof(int) * count)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
 
 	printf("Number of cases: %d\n", countCas);
 	printf("Number of controls: %d\n", countCon);
 	printf("X Range: %lf - %lf\n", xMin, xMax);
 	printf("Y Range: %lf - %lf\n", yMin, yMax);
 
-	readPoints(inputCas, x, y);
-	readPoints(inputCon, x + countCas, y + countCas);
+	if(weighted) {
+		readPoints(inputCas, x, y, weight);
+		if(opts.collapse)
+			nCas = collapseDuplicates(x, y, weight, nCas);
+		readPoints(inputCon, x + nCas, y + nCas, weight + nCas);
+		if(opts.collapse)
+			nCon = collapseDuplicates(x + nCas, y + nCas, weight + nCas, nCon);
+		count = nCas + nCon;
+		printf("Weighted locations: %d\n", count);
+	}
+	else {
+		readPoints(inputCas, x, y);
+		readPoints(inputCon, x + nCas, y + nCas);
+	}
 
-	for(int i = 0; i < countCas; i++) {
+	for(int i = 0; i < nCas; i++) {
 		ind[i] = 1;
 	}
-	for(int i = countCas; i < count; i++) {
+	for(int i = nCas; i < count; i++) {
 		ind[i] = 0;
 	}
 
-	int nBlockX = ceil((xMax - xMin) / radius);
-	int nBlockY = ceil((yMax - yMin) / radius);
+	if(opts.subdivide == 0) {
+		opts.subdivide = pickSubdivide(x, y, count, xMin, yMin, xMax, yMax, radius);
+		printf("Index blocks per search radius: %d\n", opts.subdivide);
+	}
 
-//	printf("Index blocks: %d * %d\n", nBlockX, nBlockY);
+	struct gridIndex * index;
 
-	int * index;
+	index = indexPoints(x, y, ind, weight, count, xMin, yMin, xMax, yMax, radius, opts.subdivide, opts.order);
 
-	index = indexPoints(x, y, ind, count, xMin, yMin, nBlockX, nBlockY, radius);
+//	printf("Index blocks: %d * %d\n", index->nBlockX, index->nBlockY);
 
 	fclose(inputCas);
 	fclose(inputCon);
 
-	int * countPointsCas;
-	int * countPointsCon;
-
-	if(NULL == (countPointsCas = (int *)malloc(sizeof(int) * count)))
-	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
-	}
-	if(NULL == (countPointsCon = (int *)malloc(sizeof(int) * count)))
-	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
+	struct pointStore * ps = buildPointStore(x, y, ind, count, opts.precision, xMin, yMin, xMax, yMax, opts.resolution, true);
+	ps->weight = weight;
+	boundBlocks(index, ps);
+	if(opts.validate) {
+		printf("Precision validation: %lld point pairs differ from double precision\n", validatePrecision(ps, index, radius, 20));
 	}
+	spillCoordinates(ps, opts.tmpDir);
+	printf("Point store: %.1lf bytes per point\n", pointStoreBytes(ps));
+
+	struct neighborCounts * nc = allocNeighborCounts(count, maxStencilCount(index, ps->weight), true);
 
-	countInDistance(x, y, ind, index, nBlockX, nBlockY, radius, countPointsCon, countPointsCas);
+	countInDistance(ps, ps->label, index, radius, nc);
 
 	double p = baseLineRatio * countCas / (countCas + countCon); 
 
-	struct clusterInfo * cInfo;
+	struct clusterInfo * cInfo = NULL;
 
-	int * clusters = doClusterBer(x, y, ind, index, nBlockX, nBlockY, radius, xMin, yMin, countCas, countCon, countPointsCas, countPointsCon, p, significance, minCore, nonCorePoints, &cInfo);
+	int * clusters = doClusterBer(ps, ps->label, index, radius, countCas, countCon, nc, p, significance, minCore, nonCorePoints, &cInfo);
 		//Output 
 	if(NULL == (output = fopen(argv[3], "w"))) {
 		printf("ERROR: Can't open the output file.\n");
 		exit(1);
 	}
 
-	fprintf(output, "X,Y,CaseOrCon,ClusterID\n");
+	fprintf(output, weighted ? "X,Y,CaseOrCon,ClusterID,Weight\n" : "X,Y,CaseOrCon,ClusterID\n");
+	double px, py;
 	for(int i = 0; i < count; i++) {
+		originalPoint(ps, i, &px, &py);
 		if(clusters[i] == 0) {
             clusters[i] = -1;
         }
-		fprintf(output, "%lf,%lf,%d,%d\n", x[i], y[i], ind[i], clusters[i]);
+		if(weighted)
+			fprintf(output, "%lf,%lf,%d,%d,%d\n", px, py, GET_LABEL(ps->label, i), clusters[i], ps->weight[i]);
+		else
+			fprintf(output, "%lf,%lf,%d,%d\n", px, py, GET_LABEL(ps->label, i), clusters[i]);
 	}
 
 	fclose(output);
-	free(countPointsCas);
-	free(countPointsCon);
+	freeNeighborCounts(nc);
 	free(clusters);
 
 
 	if(nSim > 0) {
-		monteCarloBer(x, y, ind, index, nBlockX, nBlockY, radius, xMin, yMin, countCas, countCon, p, significance, minCore, nonCorePoints, nSim, cInfo);
+		printf("Random seed: %llu\n", opts.seed);
+		monteCarloBer(ps, index, radius, countCas, countCon, p, significance, minCore, nonCorePoints, nSim, &opts, cInfo);
 	}
 
 	char * outputCInfo = (char *) malloc((strlen(argv[3]) + 10) * sizeof(char));
@@ -145,38 +183,15 @@ int main(int argc, char ** argv) {
 	strcat(outputCInfo, argv[3]);
 	strcat(outputCInfo, "_Info");
 
-	if(NULL == (output = fopen(outputCInfo, "w"))) {
-		printf("ERROR: Can't open the output file.\n");
-		exit(1);
-	}
-
-	if(nSim > 0) {
-		fprintf(output, "ClusterID,nCas,nCon,LL,pValue\n");
-	}
-	else {
-		fprintf(output, "ClusterID,nCas,nCon,LL\n");
-	}
-	struct clusterInfo * curInfo = cInfo;
-	while(curInfo != NULL) {
-		cInfo = curInfo->next;
-		if(nSim > 0) {
-			fprintf(output, "%d,%d,%d,%lf,%lf\n", curInfo->clusterID, curInfo->count1, curInfo->count0, curInfo->ll, curInfo->pValue);
-		}
-		else {
-			fprintf(output, "%d,%d,%d,%lf\n", curInfo->clusterID, curInfo->count1, curInfo->count0, curInfo->ll);
-		}
-		free(curInfo);
-		curInfo = cInfo;		
-	}
-
-	fclose(output);
+	//a shard only holds part of the replications, its p-values come from ESCIB_Merge
+	writeClusterInfo(outputCInfo, MODEL_BERNOULLI, cInfo, nSim > 0);
+	freeClusterInfo(cInfo);
 
 	free(outputCInfo);	
 
-	free(x);
-	free(y);
-	free(ind);
-	free(index);
+	printMemoryReport();
+	freePointStore(ps);
+	freeGridIndex(index);
 
 
 	return 0;
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "clusters.h"
+#include "mcio.h"
+
+int main(int argc, char ** argv) {
+
+	if(argc < 3) {
+		printf("ERROR! Incorrect number of input arguments\n");
+		printf("ESCIB_Merge outputInfo shard1 [shard2 ...]\n");
+		return 1;
+	}
+
+	int nShards = argc - 2;
+	struct mcShard ** shards;
+	if(NULL == (shards = (struct mcShard **)malloc(sizeof(struct mcShard *) * nShards))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	for(int i = 0; i < nShards; i++) {
+		shards[i] = loadShard(argv[i + 2]);
+	}
+
+	//order the shards by their first replication
+	struct mcShard * tmp;
+	for(int i = 1; i < nShards; i++) {
+		for(int j = i; j > 0 && shards[j - 1]->first > shards[j]->first; j--) {
+			tmp = shards[j];
+			shards[j] = shards[j - 1];
+			shards[j - 1] = tmp;
+		}
+	}
+
+	//all shards must come from the same run and cover every replication exactly once
+	struct mcShard * sh0 = shards[0];
+	struct clusterInfo * info0;
+	struct clusterInfo * info;
+	int next = 0;
+	for(int i = 0; i < nShards; i++) {
+		if(shards[i]->model != sh0->model || shards[i]->seed != sh0->seed || shards[i]->nSim != sh0->nSim) {
+			printf("ERROR: Shard %d was written by a different run (model, seed or nSim).\n", i);
+			exit(1);
+		}
+		info0 = sh0->cInfo;
+		info = shards[i]->cInfo;
+		while(info0 != NULL && info != NULL && info0->clusterID == info->clusterID && info0->ll == info->ll) {
+			info0 = info0->next;
+			info = info->next;
+		}
+		if(info0 != NULL || info != NULL) {
+			printf("ERROR: Shard %d was written for different clusters.\n", i);
+			exit(1);
+		}
+		if(shards[i]->first != next) {
+			//a gap ends where the shard starts, an overlap where the shards before it end
+			if(shards[i]->first > next)
+				printf("ERROR: Replications %d to %d are missing.\n", next, shards[i]->first - 1);
+			else
+				printf("ERROR: Replications %d to %d are in more than one shard.\n", shards[i]->first, next - 1);
+			exit(1);
+		}
+		next = shards[i]->first + shards[i]->nDone;
+	}
+	if(next != sh0->nSim) {
+		printf("ERROR: Replications %d to %d are missing.\n", next, sh0->nSim - 1);
+		exit(1);
+	}
+
+	//the same tallies as a single run: replications not below each cluster
+	for(info = sh0->cInfo; info != NULL; info = info->next) {
+		int llAbove = 0;
+		for(int i = 0; i < nShards; i++) {
+			for(int j = 0; j < shards[i]->nDone; j++) {
+				if(info->ll <= shards[i]->simLL[j]) {
+					llAbove ++;
+				}
+			}
+		}
+		info->pValue = (double)(1 + llAbove) / (1 + sh0->nSim);
+	}
+
+	printf("Merged %d shards of %d replications\n", nShards, sh0->nSim);
+	writeClusterInfo(argv[1], sh0->model, sh0->cInfo, true);
+
+	for(int i = 0; i < nShards; i++) {
+		freeShard(shards[i]);
+	}
+	free(shards);
+
+	return 0;
+}
@@ -3,15 +3,30 @@
 #include <math.h>
 #include <string.h>
 #include "io.h"
+#include "points.h"
+#include "options.h"
+#include "memory.h"
 #include "countPoints.h"
 #include "clusters.h"
 #include "mc.h"
+#include "mcio.h"
+#include "tiles.h"
+#include "raster.h"
 
 int main(int argc, char ** argv) {
 
-	if(argc != 10) {
+	if(argc < 10) {
 		printf("ERROR! Incorrect number of input arguments\n");
-		printf("ESCIB_Poisson inputBackground inputEvents output searchRadius significance(alpha) baselineRatio minCorPointsInEachCluster nonCorePoints nSim\n");
+		printf("ESCIB_Poisson inputBackground inputEvents output searchRadius significance(alpha) baselineRatio minCorPointsInEachCluster nonCorePoints nSim [options]\n");
+		printOptionsUsage();
+		return 1;
+	}
+
+	struct options opts;
+	parseOptions(argc, argv, 10, &opts);
+	setMemoryPolicy(opts.hugePages, opts.numa);
+	if(opts.simEnd > atoi(argv[9])) {
+		printf("ERROR: -simRange ends after nSim\n");
 		return 1;
 	}
 
@@ -43,183 +58,251 @@ int main(int argc, char ** argv) {
 	}
 
 		
-	int countB = getCount(inputB, xMin, xMax, yMin, yMax);
-	int countE = getCount(inputE, xMin, xMax, yMin, yMax);
-	int count = countE + countB;
-
-	double * x;
-	double * y;
-	int * ind;
-
-	if(NULL == (x = (double *)malloc(sizeof(double) * count)))
-	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
-	}
-	if(NULL == (y = (double *)malloc(sizeof(double) * count)))
-	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
-	}
-	if(NULL == (ind = (int *)malloc(sizeof(int) * count)))
-	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
+	//a raster background is not read as points, its cells are within the study area
+	struct rasterGrid * ra = NULL;
+	int countB = 0;
+	int nB = 0;
+	if(opts.raster) {
+		ra = readRaster(inputB);
+		xMin = ra->xMin;
+		yMin = ra->yMin;
+		xMax = ra->xMin + ra->nCols * ra->cellSize;
+		yMax = ra->yMin + ra->nRows * ra->cellSize;
+		printf("Background raster: %d * %d cells of %lf, %lf background points\n", ra->nCols, ra->nRows, ra->cellSize, ra->total);
 	}
 
-	printf("Number of background points: %d\n", countB);
+	//a weighted line stands for as many points at its location, the points are counted in the tests and the locations are stored
+	int countE;
+	if(!opts.raster)
+		nB = getCount(inputB, xMin, xMax, yMin, yMax, countB);
+	int nE = getCount(inputE, xMin, xMax, yMin, yMax, countE);
+	int count = nB + nE;
+	bool weighted = opts.collapse || countB != nB || countE != nE;
+
+	if(!opts.raster)
+		printf("Number of background points: %d\n", countB);
 	printf("Number of event points: %d\n", countE);
 	printf("X Range: %lf - %lf\n", xMin, xMax);
 	printf("Y Range: %lf - %lf\n", yMin, yMax);
 	printf("Search radius %lf\n", radius);
-	
-	int nBlockX = ceil((xMax - xMin) / radius);
-	int nBlockY = ceil((yMax - yMin) / radius);
 
-	readPoints(inputB, x, y);
-	readPoints(inputE, x + countB, y + countB);
+	struct clusterInfo * cInfo = NULL;
+	//the store and index of the observed data, kept for the MC
+	struct pointStore * ps = NULL;
+	struct gridIndex * index = NULL;
 
-	for(int i = 0; i < countB; i++) {
-		ind[i] = 0;
-	}
-	for(int i = countB; i < count; i++) {
-		ind[i] = 1;
-	}
+	if(opts.raster) {
+		//Events against the background raster
+		if(opts.tile > 0) {
+			printf("ERROR: -raster is not available with -tile\n");
+			return 1;
+		}
+		if(weighted) {
+			printf("ERROR: Weighted or collapsed points are not available with -raster\n");
+			return 1;
+		}
 
-	double * xB;
-	double * yB;
-	int * indexB;
-	
-	if(nSim > 0) {
-		//Point index for MC
+		double * x;
+		double * y;
 
-		if(NULL == (xB = (double *)malloc(sizeof(double) * countB))) {
+		if(NULL == (x = (double *)malloc(sizeof(double) * nE)))
+		{
 			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 			exit(1);
 		}
-		if(NULL == (yB = (double *)malloc(sizeof(double) * countB))) {
+		if(NULL == (y = (double *)malloc(sizeof(double) * nE)))
+		{
 			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 			exit(1);
 		}
+		readPoints(inputE, x, y);
 
-		for(int i = 0; i < countB; i++) {
-			xB[i] = x[i];
-			yB[i] = y[i];
+		if(opts.subdivide == 0) {
+			opts.subdivide = pickSubdivide(x, y, nE, xMin, yMin, xMax, yMax, radius);
+			printf("Index blocks per search radius: %d\n", opts.subdivide);
 		}
 
-		indexB = indexPoints(xB, yB, countB, xMin, yMin, nBlockX, nBlockY, radius);
-	}
+		index = indexPoints(x, y, nE, xMin, yMin, xMax, yMax, radius, opts.subdivide, opts.order);
+		ps = buildPointStore(x, y, NULL, nE, opts.precision, xMin, yMin, xMax, yMax, opts.resolution, true);
+		boundBlocks(index, ps);
+		if(opts.validate) {
+			printf("Precision validation: %lld point pairs differ from double precision\n", validatePrecision(ps, index, radius, 20));
+		}
+		spillCoordinates(ps, opts.tmpDir);
+		printf("Point store: %.1lf bytes per point\n", pointStoreBytes(ps));
 
+		struct neighborCounts * nc = allocNeighborCounts(nE, maxStencilCount(index), false);
+		countInDistance_Single(ps, index, radius, nc);
 
+		int * clusters = doClusterPoiRaster(ps, index, ra, radius, countE, nc, baseLineRatio, significance, minCore, nonCorePoints, &cInfo, NULL);
 
-//	printf("Index blocks: %d * %d\n", nBlockX, nBlockY);
+		//Output 
+		if(NULL == (output = fopen(argv[3], "w"))) {
+			printf("ERROR: Can't open the output file.\n");
+			exit(1);
+		}
+		double px, py;
+		for(int i = 0; i < nE; i++) {
+			originalPoint(ps, i, &px, &py);
+			fprintf(output, "%lf,%lf,%d\n", px, py, clusters[i]);
+		}
 
-	int * index;
+		fclose(output);
+		freeNeighborCounts(nc);
+		free(clusters);
+	}
+	else if(opts.tile > 0) {
+		//Tiles streamed from disk
+		if(opts.validate) {
+			printf("ERROR: -validate is not available with -tile\n");
+			return 1;
+		}
+		if(weighted) {
+			printf("ERROR: Weighted or collapsed points are not available with -tile\n");
+			return 1;
+		}
+		//the replications would need every background point in memory again
+		if(nSim > 0) {
+			printf("ERROR: -tile is only available with nSim 0, the Monte Carlo simulation holds all background points in memory\n");
+			return 1;
+		}
 
+		FILE * inputs[2] = {inputB, inputE};
+		struct tileSet * ts = partitionTiles(inputs, 2, xMin, yMin, xMax, yMax, radius, opts.tile, opts.tmpDir);
+		printf("Tiles: %d * %d, at most %d points in a tile with its halo\n", ts->nTileX, ts->nTileY, ts->maxRecords);
 
-	index = indexPoints(x, y, ind, count, xMin, yMin, nBlockX, nBlockY, radius);
+		if(opts.subdivide == 0) {
+			opts.subdivide = pickSubdivideTiles(ts, count);
+			printf("Index blocks per search radius: %d\n", opts.subdivide);
+		}
 
-	fclose(inputB);
-	fclose(inputE);
+		cInfo = clusterPoiTiles(ts, countB, countE, baseLineRatio, significance, minCore, nonCorePoints, &opts, argv[3]);
+		freeTileSet(ts);
+	}
+	else {
+		double * x;
+		double * y;
+		int * ind;
 
-	int * countPointsE;
-	int * countPointsB;
+		if(NULL == (x = (double *)malloc(sizeof(double) * count)))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		if(NULL == (y = (double *)malloc(sizeof(double) * count)))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		if(NULL == (ind = (int *)malloc(sizeof(int) * count)))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		int * weight = NULL;
+		if(weighted && NULL == (weight = (int *)malloc(sizeof(int) * count)))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
 
-	if(NULL == (countPointsE = (int *)malloc(sizeof(int) * count)))
-	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
-	}
-	if(NULL == (countPointsB = (int *)malloc(sizeof(int) * count)))
-	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
-	}
+		int nBLoc = nB;
+		if(weighted) {
+			readPoints(inputB, x, y, weight);
+			if(opts.collapse)
+				nBLoc = collapseDuplicates(x, y, weight, nB);
+			readPoints(inputE, x + nBLoc, y + nBLoc, weight + nBLoc);
+			count = nBLoc + (opts.collapse ? collapseDuplicates(x + nBLoc, y + nBLoc, weight + nBLoc, nE) : nE);
+			printf("Weighted locations: %d\n", count);
+		}
+		else {
+			readPoints(inputB, x, y);
+			readPoints(inputE, x + nB, y + nB);
+		}
 
-	countInDistance(x, y, ind, index, nBlockX, nBlockY, radius, countPointsB, countPointsE);
+		for(int i = 0; i < nBLoc; i++) {
+			ind[i] = 0;
+		}
+		for(int i = nBLoc; i < count; i++) {
+			ind[i] = 1;
+		}
 
-	double * lambda;
-	if(NULL == (lambda = (double *)malloc(sizeof(double) * count)))
-	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
-	}
+		if(opts.subdivide == 0) {
+			opts.subdivide = pickSubdivide(x, y, count, xMin, yMin, xMax, yMax, radius);
+			printf("Index blocks per search radius: %d\n", opts.subdivide);
+		}
 
-	for(int i = 0; i < count; i++)
-	{
-		//lambda[i] = (double)(countPointsB[i]) * countE / countB;
-		lambda[i] = (double)(countPointsB[i]) * countE * baseLineRatio / countB;
-	}
-	
-	struct clusterInfo * cInfo;
 
-	int * clusters = doClusterPoi(x, y, ind, index, nBlockX, nBlockY, radius, xMin, yMin, countB, countE, countPointsE, lambda, significance, minCore, nonCorePoints, &cInfo);
+		index = indexPoints(x, y, ind, weight, count, xMin, yMin, xMax, yMax, radius, opts.subdivide, opts.order);
 
-	//Output 
-	if(NULL == (output = fopen(argv[3], "w"))) {
-		printf("ERROR: Can't open the output file.\n");
-		exit(1);
-	}
+//		printf("Index blocks: %d * %d\n", index->nBlockX, index->nBlockY);
+
+		ps = buildPointStore(x, y, ind, count, opts.precision, xMin, yMin, xMax, yMax, opts.resolution, true);
+		ps->weight = weight;
+		boundBlocks(index, ps);
+		if(opts.validate) {
+			printf("Precision validation: %lld point pairs differ from double precision\n", validatePrecision(ps, index, radius, 20));
+		}
+		spillCoordinates(ps, opts.tmpDir);
+		printf("Point store: %.1lf bytes per point\n", pointStoreBytes(ps));
 
+		struct neighborCounts * nc = allocNeighborCounts(count, maxStencilCount(index, ps->weight), true);
 
-	for(int i = 0; i < count; i++) {
-		if(ind[i] == 1) {
-			fprintf(output, "%lf,%lf,%d\n", x[i], y[i], clusters[i]);
+		countInDistance_NearEvents(ps, ps->label, index, radius, nc);
+
+		int * clusters = doClusterPoi(ps, ps->label, index, radius, countB, countE, nc, baseLineRatio, significance, minCore, nonCorePoints, &cInfo);
+
+		//Output 
+		if(NULL == (output = fopen(argv[3], "w"))) {
+			printf("ERROR: Can't open the output file.\n");
+			exit(1);
 		}
-	}
 
-	fclose(output);
-	free(lambda);
-	free(x);
-	free(y);
-	free(ind);
-	free(index);
-	free(countPointsE);
-	free(countPointsB);
-	free(clusters);
 
-	if(nSim > 0) {
-		//MC
-		monteCarloPoi(xB, yB, indexB, nBlockX, nBlockY, radius, xMin, yMin, countE, countB, baseLineRatio, significance, minCore, nonCorePoints, nSim, cInfo);
+		double px, py;
+		for(int i = 0; i < count; i++) {
+			originalPoint(ps, i, &px, &py);
+			if(GET_LABEL(ps->label, i) == 1 && weighted) {
+				fprintf(output, "%lf,%lf,%d,%d\n", px, py, clusters[i], ps->weight[i]);
+			}
+			else if(GET_LABEL(ps->label, i) == 1) {
+				fprintf(output, "%lf,%lf,%d\n", px, py, clusters[i]);
+			}
+		}
 
+		fclose(output);
+		freeNeighborCounts(nc);
+		free(clusters);
+	}
 
-		free(xB);
-		free(yB);
-		free(indexB);
+	if(nSim > 0 && opts.raster) {
+		//MC, the events of each replication are drawn from the raster
+		printf("Random seed: %llu\n", opts.seed);
+		monteCarloPoiRaster(ra, xMin, yMin, xMax, yMax, radius, countE, baseLineRatio, significance, minCore, nonCorePoints, nSim, &opts, cInfo);
+	}
+	else if(nSim > 0) {
+		//MC on the index of the observed data, whose events are left out
+		printf("Random seed: %llu\n", opts.seed);
+		monteCarloPoi(ps, index, radius, countE, countB, baseLineRatio, significance, minCore, nonCorePoints, nSim, &opts, cInfo);
 	}
 
+	printMemoryReport();
+	if(ps != NULL)
+		freePointStore(ps);
+	if(index != NULL)
+		freeGridIndex(index);
+	freeRaster(ra);
+	fclose(inputB);
+	fclose(inputE);
 
 	char * outputCInfo = (char *) malloc((strlen(argv[3]) + 10) * sizeof(char));
 	outputCInfo[0] = '\0';
 	strcat(outputCInfo, argv[3]);
 	strcat(outputCInfo, "_Info");
 
-	if(NULL == (output = fopen(outputCInfo, "w"))) {
-		printf("ERROR: Can't open the output file.\n");
-		exit(1);
-	}
-
-	if(nSim > 0) {
-		fprintf(output, "ClusterID,Events,expEvents,LL,PValue\n");
-	}
-	else {
-		fprintf(output, "ClusterID,Events,expEvents,LL\n");
-	}
-	struct clusterInfo * curInfo = cInfo;
-	while(curInfo != NULL) {
-		cInfo = curInfo->next;
-		if(nSim > 0) {
-			fprintf(output, "%d,%d,%lf,%lf,%lf\n", curInfo->clusterID, curInfo->count1, curInfo->expCount1, curInfo->ll, curInfo->pValue);
-		}
-		else {
-			fprintf(output, "%d,%d,%lf,%lf\n", curInfo->clusterID, curInfo->count1, curInfo->expCount1, curInfo->ll);
-		}
-		free(curInfo);
-		curInfo = cInfo;		
-	}
-	
-
-	fclose(output);
+	//a shard only holds part of the replications, its p-values come from ESCIB_Merge
+	writeClusterInfo(outputCInfo, MODEL_POISSON, cInfo, nSim > 0);
+	freeClusterInfo(cInfo);
 	free(outputCInfo);	
 	
 	return 0;
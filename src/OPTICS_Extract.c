@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "optics.h"
+
+int main(int argc, char ** argv) {
+
+	if(argc < 6) {
+		printf("ERROR! Incorrect number of input arguments\n");
+		printf("OPTICS_Extract inputOrdering output searchRadius minCorPointsInEachCluster nonCorePoints\n");
+		return 1;
+	}
+
+	FILE * output;
+
+	double radius = atof(argv[3]);
+	int minCore = atoi(argv[4]);
+	bool nonCorePoints = true;
+	if(atoi(argv[5]) == 0)
+		nonCorePoints = false;
+
+	struct opticsOrder * oo = loadOPTICS(argv[1]);
+	if(radius > oo->maxRadius) {
+		printf("ERROR: The ordering only extends to a search radius of %lf\n", oo->maxRadius);
+		return 1;
+	}
+
+	int * clusters = extractDBSCAN(oo, radius, minCore, nonCorePoints);
+
+	//Output
+	if(NULL == (output = fopen(argv[2], "w"))) {
+		printf("ERROR: Can't open the output file.\n");
+		exit(1);
+	}
+
+	for(int i = 0; i < oo->count; i++)
+	{
+		fprintf(output, "%lf,%lf,%d\n", oo->x[i], oo->y[i], clusters[i]);
+	}
+
+	fclose(output);
+
+	free(clusters);
+	freeOPTICS(oo);
+
+	return 0;
+}
@@ -0,0 +1,1014 @@
+/**
+ * cellDBSCAN.c
+ * Date: 10/18/2026
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "points.h"
+#include "cellDBSCAN.h"
+
+//a grid of cells with a diagonal of one search radius, so all points of a cell are usually neighbors of each other
+template <typename T>
+struct cellGrid {
+	int nCellX;
+	int nCellY;
+	int * start;		//the points of cell c are point[start[c]] to point[start[c + 1] - 1]
+	int * coreEnd;		//the core points of cell c are point[start[c]] to point[coreEnd[c] - 1]
+	int * point;
+	T * bxMin;			//the bounding box of the points of each cell
+	T * byMin;
+	T * bxMax;
+	T * byMax;
+	bool * compact;		//whether every two points of a cell are within the search radius
+};
+
+/**
+ * NAME:	buildCells
+ * DESCRIPTION:	put the points into square cells and find the bounding box of the points of each cell. the bounding boxes are in the precision of the point store, so tests against them agree with the tests of the points in them
+ * PARAMETERS:
+ * 	T * x: 			the array of points' X values, in the precision of the point store
+ * 	T * y: 			the array of points' Y values, in the precision of the point store
+ * 	int count:		the number of points
+ * 	double originX:	the X value of the lower left corner of the grid, in the units of the point store
+ * 	double originY:	the Y value of the lower left corner of the grid, in the units of the point store
+ * 	double side:	the side length of a cell, in the units of the point store
+ *	D dist2:		the squared search radius in the precision of the point store
+ * 	struct cellGrid<T> &cg:	the resulting cells
+ * RETURN: none
+ */
+template <typename T, typename D>
+static void buildCells(T * x, T * y, int count, double originX, double originY, double side, D dist2, struct cellGrid<T> &cg)
+{
+	int * cellOf;
+	if(NULL == (cellOf = (int *)malloc(sizeof(int) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	int * col;
+	if(NULL == (col = (int *)malloc(sizeof(int) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	cg.nCellX = 1;
+	cg.nCellY = 1;
+	int row;
+	for(int i = 0; i < count; i++)
+	{
+		col[i] = (int)floor(((double)x[i] - originX) / side);
+		row = (int)floor(((double)y[i] - originY) / side);
+		if(col[i] < 0)
+			col[i] = 0;
+		if(row < 0)
+			row = 0;
+		if(col[i] >= cg.nCellX)
+			cg.nCellX = col[i] + 1;
+		if(row >= cg.nCellY)
+			cg.nCellY = row + 1;
+		cellOf[i] = row;
+	}
+	for(int i = 0; i < count; i++)
+	{
+		cellOf[i] = cellOf[i] * cg.nCellX + col[i];
+	}
+	free(col);
+
+	int nCells = cg.nCellX * cg.nCellY;
+	if(NULL == (cg.start = (int *)malloc(sizeof(int) * (nCells + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (cg.coreEnd = (int *)malloc(sizeof(int) * (nCells + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (cg.point = (int *)malloc(sizeof(int) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (cg.bxMin = (T *)malloc(sizeof(T) * nCells)) || NULL == (cg.byMin = (T *)malloc(sizeof(T) * nCells))
+		|| NULL == (cg.bxMax = (T *)malloc(sizeof(T) * nCells)) || NULL == (cg.byMax = (T *)malloc(sizeof(T) * nCells)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (cg.compact = (bool *)malloc(sizeof(bool) * nCells)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	//counting sort of the points by cell, keeping the storage order within each cell
+	for(int c = 0; c <= nCells; c++)
+	{
+		cg.start[c] = 0;
+	}
+	for(int i = 0; i < count; i++)
+	{
+		cg.start[cellOf[i] + 1] ++;
+	}
+	for(int c = 0; c < nCells; c++)
+	{
+		cg.start[c + 1] += cg.start[c];
+		cg.coreEnd[c] = cg.start[c];
+	}
+	int c;
+	for(int i = 0; i < count; i++)
+	{
+		c = cellOf[i];
+		if(cg.coreEnd[c] == cg.start[c])
+		{
+			cg.bxMin[c] = cg.bxMax[c] = x[i];
+			cg.byMin[c] = cg.byMax[c] = y[i];
+		}
+		else
+		{
+			if(x[i] < cg.bxMin[c])
+				cg.bxMin[c] = x[i];
+			if(x[i] > cg.bxMax[c])
+				cg.bxMax[c] = x[i];
+			if(y[i] < cg.byMin[c])
+				cg.byMin[c] = y[i];
+			if(y[i] > cg.byMax[c])
+				cg.byMax[c] = y[i];
+		}
+		cg.point[cg.coreEnd[c]] = i;
+		cg.coreEnd[c] ++;
+	}
+	free(cellOf);
+
+	for(int c = 0; c < nCells; c++)
+	{
+		cg.coreEnd[c] = cg.start[c];
+		cg.compact[c] = (cg.start[c + 1] > cg.start[c]) && inDistance(cg.bxMin[c], cg.byMin[c], cg.bxMax[c], cg.byMax[c], dist2);
+	}
+}
+
+/**
+ * NAME:	freeCells
+ * DESCRIPTION:	free the cells
+ * PARAMETERS:
+ * 	struct cellGrid<T> &cg:	the cells
+ * RETURN: none
+ */
+template <typename T>
+static void freeCells(struct cellGrid<T> &cg)
+{
+	free(cg.start);
+	free(cg.coreEnd);
+	free(cg.point);
+	free(cg.bxMin);
+	free(cg.byMin);
+	free(cg.bxMax);
+	free(cg.byMax);
+	free(cg.compact);
+}
+
+/**
+ * NAME:	nearCell
+ * DESCRIPTION:	test whether any point of a cell may be within the search radius of a point, using the point of the bounding box nearest to it
+ */
+template <typename T, typename D>
+static inline bool nearCell(struct cellGrid<T> &cg, int c, T px, T py, D dist2)
+{
+	T nx = (px < cg.bxMin[c]) ? cg.bxMin[c] : ((px > cg.bxMax[c]) ? cg.bxMax[c] : px);
+	T ny = (py < cg.byMin[c]) ? cg.byMin[c] : ((py > cg.byMax[c]) ? cg.byMax[c] : py);
+	return inDistance(px, py, nx, ny, dist2);
+}
+
+/**
+ * NAME:	withinCell
+ * DESCRIPTION:	test whether all points of a cell are within the search radius of a point, using the corner of the bounding box farthest from it
+ */
+template <typename T, typename D>
+static inline bool withinCell(struct cellGrid<T> &cg, int c, T px, T py, D dist2)
+{
+	T fx = ((D)px - (D)cg.bxMin[c] > (D)cg.bxMax[c] - (D)px) ? cg.bxMin[c] : cg.bxMax[c];
+	T fy = ((D)py - (D)cg.byMin[c] > (D)cg.byMax[c] - (D)py) ? cg.byMin[c] : cg.byMax[c];
+	return inDistance(px, py, fx, fy, dist2);
+}
+
+/**
+ * NAME:	nearCells
+ * DESCRIPTION:	test whether any two points of two cells may be within the search radius, using the nearest points of their bounding boxes
+ */
+template <typename T, typename D>
+static inline bool nearCells(struct cellGrid<T> &cg, int a, int b, D dist2)
+{
+	T ax = cg.bxMin[a], bx = cg.bxMin[a];
+	T ay = cg.byMin[a], by = cg.byMin[a];
+	if(cg.bxMax[a] < cg.bxMin[b]) {
+		ax = cg.bxMax[a];
+		bx = cg.bxMin[b];
+	}
+	else if(cg.bxMax[b] < cg.bxMin[a]) {
+		bx = cg.bxMax[b];
+	}
+	if(cg.byMax[a] < cg.byMin[b]) {
+		ay = cg.byMax[a];
+		by = cg.byMin[b];
+	}
+	else if(cg.byMax[b] < cg.byMin[a]) {
+		by = cg.byMax[b];
+	}
+	return inDistance(ax, ay, bx, by, dist2);
+}
+
+/**
+ * NAME:	findRoot
+ * DESCRIPTION:	find the root of a point in a union-find forest, halving the path on the way
+ */
+static inline int findRoot(int * parent, int i)
+{
+	while(parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+/**
+ * NAME:	isCore
+ * DESCRIPTION:	test whether a point has at least minPts points within the search radius. whole cells are counted without distance tests when their bounding box is within the radius, and counting stops as soon as minPts is reached
+ * PARAMETERS:
+ * 	T * x: 			the array of points' X values, in the precision of the point store
+ * 	T * y: 			the array of points' Y values, in the precision of the point store
+ * 	struct cellGrid<T> &cg:	the cells
+ * 	int c:			the cell of the point
+ * 	int i:			the point
+ *	D dist2:		the squared search radius in the precision of the point store
+ *	int minPts:		the minimum points to form a core points
+ * RETURN:
+ * 	TYPE:	bool
+ * 	VALUE:	whether the point is a core point
+ */
+template <typename T, typename D>
+static bool isCore(T * x, T * y, struct cellGrid<T> &cg, int c, int i, D dist2, int minPts)
+{
+	int colID = c % cg.nCellX;
+	int rowID = c / cg.nCellX;
+	int colMin = (colID < 2) ? 0 : (colID - 2);
+	int colMax = (colID > cg.nCellX - 3) ? (cg.nCellX - 1) : (colID + 2);
+	int rowMin = (rowID < 2) ? 0 : (rowID - 2);
+	int rowMax = (rowID > cg.nCellY - 3) ? (cg.nCellY - 1) : (rowID + 2);
+	int nbID;
+	int n = 0;
+
+	for(int row = rowMin; row <= rowMax; row ++)
+	{
+		for(int col = colMin; col <= colMax; col ++)
+		{
+			nbID = row * cg.nCellX + col;
+			if(cg.start[nbID] == cg.start[nbID + 1] || !nearCell(cg, nbID, x[i], y[i], dist2))
+				continue;
+			if(withinCell(cg, nbID, x[i], y[i], dist2))
+			{
+				n += cg.start[nbID + 1] - cg.start[nbID];
+			}
+			else
+			{
+				for(int k = cg.start[nbID]; k < cg.start[nbID + 1] && n < minPts; k++)
+				{
+					if(inDistance(x[i], y[i], x[cg.point[k]], y[cg.point[k]], dist2))
+						n ++;
+				}
+			}
+			if(n >= minPts)
+				return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * NAME:	linkCells
+ * DESCRIPTION:	join the clusters of the core points of two cells that are within the search radius of each other. when both cells are compact, the core points of each are already one cluster, and the search stops at the first pair within the radius
+ * PARAMETERS:
+ * 	T * x: 			the array of points' X values, in the precision of the point store
+ * 	T * y: 			the array of points' Y values, in the precision of the point store
+ * 	struct cellGrid<T> &cg:	the cells
+ * 	int a:			the first cell
+ * 	int b:			the second cell
+ *	D dist2:		the squared search radius in the precision of the point store
+ * 	int * parent:	the union-find forest of the core points
+ * RETURN: none
+ */
+template <typename T, typename D>
+static void linkCells(T * x, T * y, struct cellGrid<T> &cg, int a, int b, D dist2, int * parent)
+{
+	bool whole = cg.compact[a] && cg.compact[b];
+	int p, q, rootP, rootQ;
+
+	if(whole && findRoot(parent, cg.point[cg.start[a]]) == findRoot(parent, cg.point[cg.start[b]]))
+		return;
+
+	for(int k = cg.start[a]; k < cg.coreEnd[a]; k++)
+	{
+		p = cg.point[k];
+		for(int l = cg.start[b]; l < cg.coreEnd[b]; l++)
+		{
+			q = cg.point[l];
+			if(!inDistance(x[p], y[p], x[q], y[q], dist2))
+				continue;
+			rootP = findRoot(parent, p);
+			rootQ = findRoot(parent, q);
+			if(rootP == rootQ)
+				continue;
+			if(rootP < rootQ)
+				parent[rootQ] = rootP;
+			else
+				parent[rootP] = rootQ;
+			if(whole)
+				return;
+		}
+	}
+}
+
+/**
+ * NAME:	cellDBSCAN
+ * DESCRIPTION:	cluster all event points using DBSCAN algorithm on cells with a diagonal of one search radius (Gunawan's algorithm). a compact cell with at least minPts points is all core points without any distance test; the core points of other cells are found by counting that stops at minPts. the core points of a compact cell are one cluster, and clusters of neighboring cells are joined by a search for a pair of core points within the radius. border points are assigned last. clusters are numbered, and border points assigned, as clusterDBSCAN does, so the result is the same
+ * PARAMETERS:
+ * 	T * x: 			the array of events' X values, in the precision of the point store
+ * 	T * y: 			the array of events' Y values, in the precision of the point store
+ * 	int count:		the number of events
+ * 	double originX:	the X value of the lower left corner of the cells, in the units of the point store
+ * 	double originY:	the Y value of the lower left corner of the cells, in the units of the point store
+ * 	double side:	the side length of a cell (the search radius / sqrt(2)), in the units of the point store
+ *	D dist2:			the squared search radius in the precision of the point store
+ *	int minPts:		the minimum points to form a core points
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ * RETURN:
+ * 	TYPE:	int *
+ * 	VALUE:	an array of length count: the cluster ID of each event
+ */
+template <typename T, typename D>
+static int * cellDBSCAN(T * x, T * y, int count, double originX, double originY, double side, D dist2, int minPts, int minCore, bool nonCorePoints)
+{
+	struct cellGrid<T> cg;
+	buildCells(x, y, count, originX, originY, side, dist2, cg);
+	int nCells = cg.nCellX * cg.nCellY;
+
+	bool * core;
+	if(NULL == (core = (bool *)malloc(sizeof(bool) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	//FindCores, then put the core points of each cell before the others
+	int k, l, tmp;
+	for(int c = 0; c < nCells; c++)
+	{
+		if(cg.compact[c] && cg.start[c + 1] - cg.start[c] >= minPts)
+		{
+			for(k = cg.start[c]; k < cg.start[c + 1]; k++)
+				core[cg.point[k]] = true;
+			cg.coreEnd[c] = cg.start[c + 1];
+			continue;
+		}
+		for(k = cg.start[c]; k < cg.start[c + 1]; k++)
+		{
+			core[cg.point[k]] = isCore(x, y, cg, c, cg.point[k], dist2, minPts);
+		}
+		l = cg.start[c];
+		for(k = cg.start[c]; k < cg.start[c + 1]; k++)
+		{
+			if(core[cg.point[k]])
+			{
+				tmp = cg.point[k];
+				cg.point[k] = cg.point[l];
+				cg.point[l] = tmp;
+				l ++;
+			}
+		}
+		cg.coreEnd[c] = l;
+	}
+
+	int * parent;
+	if(NULL == (parent = (int *)malloc(sizeof(int) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int i = 0; i < count; i++)
+	{
+		parent[i] = i;
+	}
+
+	//ConnectCores, first within each cell
+	for(int c = 0; c < nCells; c++)
+	{
+		if(cg.coreEnd[c] == cg.start[c])
+			continue;
+		if(cg.compact[c])
+		{
+			for(k = cg.start[c] + 1; k < cg.coreEnd[c]; k++)
+				parent[cg.point[k]] = cg.point[cg.start[c]];
+		}
+		else
+		{
+			linkCells(x, y, cg, c, c, dist2, parent);
+		}
+	}
+
+	int colID, rowID, colMin, colMax, rowMax;
+	int nbID;
+	for(int c = 0; c < nCells; c++)
+	{
+		if(cg.coreEnd[c] == cg.start[c])
+			continue;
+
+		//each pair of neighboring cells once, from the cell before in row-major order
+		colID = c % cg.nCellX;
+		rowID = c / cg.nCellX;
+		colMin = (colID < 2) ? 0 : (colID - 2);
+		colMax = (colID > cg.nCellX - 3) ? (cg.nCellX - 1) : (colID + 2);
+		rowMax = (rowID > cg.nCellY - 3) ? (cg.nCellY - 1) : (rowID + 2);
+		for(int row = rowID; row <= rowMax; row ++)
+		{
+			for(int col = colMin; col <= colMax; col ++)
+			{
+				nbID = row * cg.nCellX + col;
+				if(nbID <= c || cg.coreEnd[nbID] == cg.start[nbID] || !nearCells(cg, c, nbID, dist2))
+					continue;
+				linkCells(x, y, cg, c, nbID, dist2, parent);
+			}
+		}
+	}
+
+	//number the clusters in the order clusterDBSCAN finds them: by their first core point, dropping those with too few core points
+	int * clusterID;
+	if(NULL == (clusterID = (int *)malloc(sizeof(int) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	int * rootCount;
+	if(NULL == (rootCount = (int *)malloc(sizeof(int) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int i = 0; i < count; i++)
+	{
+		rootCount[i] = 0;
+	}
+	for(int i = 0; i < count; i++)
+	{
+		if(core[i])
+			rootCount[findRoot(parent, i)] ++;
+	}
+	//the cluster ID of each root replaces its count once the root is reached
+	int cID = 0;
+	int root;
+	for(int i = 0; i < count; i++)
+	{
+		clusterID[i] = -1;
+		if(!core[i])
+			continue;
+		root = findRoot(parent, i);
+		if(rootCount[root] > 0)
+		{
+			if(rootCount[root] > minCore)
+				rootCount[root] = -(++ cID);
+			else
+				rootCount[root] = 0;
+		}
+		if(rootCount[root] < 0)
+			clusterID[i] = -rootCount[root];
+	}
+
+	//AssignBorders: clusterDBSCAN gives a border point to the first cluster that reaches it
+	int best, id, q;
+	if(nonCorePoints)
+	{
+		for(int c = 0; c < nCells; c++)
+		{
+			colID = c % cg.nCellX;
+			rowID = c / cg.nCellX;
+			colMin = (colID < 2) ? 0 : (colID - 2);
+			colMax = (colID > cg.nCellX - 3) ? (cg.nCellX - 1) : (colID + 2);
+			rowMax = (rowID > cg.nCellY - 3) ? (cg.nCellY - 1) : (rowID + 2);
+			for(k = cg.coreEnd[c]; k < cg.start[c + 1]; k++)
+			{
+				int i = cg.point[k];
+				best = INT_MAX;
+				for(int row = (rowID < 2) ? 0 : (rowID - 2); row <= rowMax; row ++)
+				{
+					for(int col = colMin; col <= colMax; col ++)
+					{
+						nbID = row * cg.nCellX + col;
+						if(cg.coreEnd[nbID] == cg.start[nbID] || !nearCell(cg, nbID, x[i], y[i], dist2))
+							continue;
+						if(cg.compact[nbID] && withinCell(cg, nbID, x[i], y[i], dist2))
+						{
+							id = clusterID[cg.point[cg.start[nbID]]];
+							if(id > 0 && id < best)
+								best = id;
+							continue;
+						}
+						for(l = cg.start[nbID]; l < cg.coreEnd[nbID]; l++)
+						{
+							q = cg.point[l];
+							id = clusterID[q];
+							if(id > 0 && id < best && inDistance(x[i], y[i], x[q], y[q], dist2))
+								best = id;
+						}
+					}
+				}
+				if(best != INT_MAX)
+					clusterID[i] = best;
+			}
+		}
+	}
+
+	free(rootCount);
+	free(parent);
+	free(core);
+	freeCells(cg);
+
+	return clusterID;
+}
+
+/**
+ * NAME:	compareKeys
+ * DESCRIPTION:	compare two 64-bit keys for qsort
+ */
+static int compareKeys(const void * a, const void * b)
+{
+	unsigned long long ka = *(const unsigned long long *)a;
+	unsigned long long kb = *(const unsigned long long *)b;
+	return (ka > kb) - (ka < kb);
+}
+
+/**
+ * NAME:	nearSubCell
+ * DESCRIPTION:	test whether a sub-cell intersects the search radius around a point, using the point of the sub-cell nearest to it. every point of such a sub-cell is within (1 + rho) * radius of the point
+ * PARAMETERS:
+ * 	double px:		the X value of the point, in the units of the point store
+ * 	double py:		the Y value of the point, in the units of the point store
+ * 	double sx:		the X value of the lower left corner of the sub-cell
+ * 	double sy:		the Y value of the lower left corner of the sub-cell
+ * 	double subSide:	the side length of a sub-cell
+ * 	double eps2:	the squared search radius, in the units of the point store
+ * RETURN:
+ * 	TYPE:	bool
+ * 	VALUE:	whether the sub-cell intersects the search radius
+ */
+static inline bool nearSubCell(double px, double py, double sx, double sy, double subSide, double eps2)
+{
+	double dx = (px < sx) ? (sx - px) : ((px > sx + subSide) ? (px - sx - subSide) : 0);
+	double dy = (py < sy) ? (sy - py) : ((py > sy + subSide) ? (py - sy - subSide) : 0);
+	return dx * dx + dy * dy <= eps2;
+}
+
+//the cells after a cell in row-major order that may hold points within the search radius of it
+static const int forwardCol[12] = {1, 2, -2, -1, 0, 1, 2, -2, -1, 0, 1, 2};
+static const int forwardRow[12] = {0, 0, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2};
+
+/**
+ * NAME:	approxDBSCAN
+ * DESCRIPTION:	cluster all event points using rho-approximate DBSCAN (Gan and Tao). the cells of cellDBSCAN are divided into sub-cells with a diagonal of at most rho * radius, and each cell keeps the number of points and of core points of its non-empty sub-cells. points are counted, and cells are connected, by testing the sub-cells against the search radius instead of the points in them, so a point is a core point if it has minPts points within the radius and is not if it has fewer within (1 + rho) * radius, and two core points within the radius are always in the same cluster, while two farther apart than (1 + rho) * radius are only if other core points connect them. the cells are processed in parallel
+ * PARAMETERS:
+ * 	T * x: 			the array of events' X values, in the precision of the point store
+ * 	T * y: 			the array of events' Y values, in the precision of the point store
+ * 	int count:		the number of events
+ * 	double originX:	the X value of the lower left corner of the cells, in the units of the point store
+ * 	double originY:	the Y value of the lower left corner of the cells, in the units of the point store
+ * 	double side:	the side length of a cell (the search radius / sqrt(2)), in the units of the point store
+ *	D dist2:		the squared search radius in the precision of the point store
+ *	double rho:		the approximation of the search radius
+ *	int minPts:		the minimum points to form a core points
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ * RETURN:
+ * 	TYPE:	int *
+ * 	VALUE:	an array of length count: the cluster ID of each event
+ */
+template <typename T, typename D>
+static int * approxDBSCAN(T * x, T * y, int count, double originX, double originY, double side, D dist2, double rho, int minPts, int minCore, bool nonCorePoints)
+{
+	struct cellGrid<T> cg;
+	buildCells(x, y, count, originX, originY, side, dist2, cg);
+	int nCells = cg.nCellX * cg.nCellY;
+
+	int nSubSide = (int)ceil(1 / rho);
+	double subSide = side / nSubSide;
+	double eps2 = 2 * side * side;
+
+	int * cellOf;
+	unsigned long long * keyed;
+	int * nSub;
+	if(NULL == (cellOf = (int *)malloc(sizeof(int) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (keyed = (unsigned long long *)malloc(sizeof(unsigned long long) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (nSub = (int *)malloc(sizeof(int) * (nCells + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	//order the points of each cell by sub-cell
+	#pragma omp parallel for schedule(dynamic, 256)
+	for(int c = 0; c < nCells; c++)
+	{
+		int colID = c % cg.nCellX;
+		int rowID = c / cg.nCellX;
+		int p, sx, sy;
+		for(int k = cg.start[c]; k < cg.start[c + 1]; k++)
+		{
+			p = cg.point[k];
+			cellOf[p] = c;
+			sx = (int)floor(((double)x[p] - originX) / subSide) - colID * nSubSide;
+			sy = (int)floor(((double)y[p] - originY) / subSide) - rowID * nSubSide;
+			sx = (sx < 0) ? 0 : ((sx >= nSubSide) ? (nSubSide - 1) : sx);
+			sy = (sy < 0) ? 0 : ((sy >= nSubSide) ? (nSubSide - 1) : sy);
+			keyed[k] = ((unsigned long long)(sy * nSubSide + sx) << 32) | (unsigned int)p;
+		}
+		qsort(keyed + cg.start[c], cg.start[c + 1] - cg.start[c], sizeof(unsigned long long), compareKeys);
+		nSub[c] = 0;
+		for(int k = cg.start[c]; k < cg.start[c + 1]; k++)
+		{
+			cg.point[k] = (int)(keyed[k] & 0xFFFFFFFFULL);
+			if(k == cg.start[c] || (keyed[k] >> 32) != (keyed[k - 1] >> 32))
+				nSub[c] ++;
+		}
+	}
+
+	//the summaries of the non-empty sub-cells: their corner and number of points, in cell order
+	int * subStart;
+	if(NULL == (subStart = (int *)malloc(sizeof(int) * (nCells + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	subStart[0] = 0;
+	for(int c = 0; c < nCells; c++)
+	{
+		subStart[c + 1] = subStart[c] + nSub[c];
+	}
+	int nSubs = subStart[nCells];
+	double * subX;
+	double * subY;
+	int * subCount;
+	int * subCore;
+	if(NULL == (subX = (double *)malloc(sizeof(double) * (nSubs + 1))) || NULL == (subY = (double *)malloc(sizeof(double) * (nSubs + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (subCount = (int *)malloc(sizeof(int) * (nSubs + 1))) || NULL == (subCore = (int *)malloc(sizeof(int) * (nSubs + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	#pragma omp parallel for schedule(dynamic, 256)
+	for(int c = 0; c < nCells; c++)
+	{
+		int colID = c % cg.nCellX;
+		int rowID = c / cg.nCellX;
+		int e = subStart[c] - 1;
+		int key;
+		for(int k = cg.start[c]; k < cg.start[c + 1]; k++)
+		{
+			if(k == cg.start[c] || (keyed[k] >> 32) != (keyed[k - 1] >> 32))
+			{
+				e ++;
+				key = (int)(keyed[k] >> 32);
+				subX[e] = originX + ((double)colID * nSubSide + key % nSubSide) * subSide;
+				subY[e] = originY + ((double)rowID * nSubSide + key / nSubSide) * subSide;
+				subCount[e] = 0;
+				subCore[e] = 0;
+			}
+			subCount[e] ++;
+		}
+	}
+	free(keyed);
+
+	bool * core;
+	if(NULL == (core = (bool *)malloc(sizeof(bool) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	//FindCores, counting the points of sub-cells within the radius, and the core points of each sub-cell
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(int c = 0; c < nCells; c++)
+	{
+		int colID = c % cg.nCellX;
+		int rowID = c / cg.nCellX;
+		int colMin = (colID < 2) ? 0 : (colID - 2);
+		int colMax = (colID > cg.nCellX - 3) ? (cg.nCellX - 1) : (colID + 2);
+		int rowMin = (rowID < 2) ? 0 : (rowID - 2);
+		int rowMax = (rowID > cg.nCellY - 3) ? (cg.nCellY - 1) : (rowID + 2);
+		bool dense = cg.compact[c] && cg.start[c + 1] - cg.start[c] >= minPts;
+		int p, n, nbID;
+		//the points of a sub-cell are consecutive
+		int e = subStart[c];
+		int subEnd = cg.start[c] + ((nSub[c] > 0) ? subCount[e] : 0);
+		for(int k = cg.start[c]; k < cg.start[c + 1]; k++)
+		{
+			if(k == subEnd)
+			{
+				e ++;
+				subEnd += subCount[e];
+			}
+			p = cg.point[k];
+			n = dense ? minPts : 0;
+			for(int row = rowMin; row <= rowMax && n < minPts; row ++)
+			{
+				for(int col = colMin; col <= colMax && n < minPts; col ++)
+				{
+					nbID = row * cg.nCellX + col;
+					if(cg.start[nbID] == cg.start[nbID + 1] || !nearCell(cg, nbID, x[p], y[p], dist2))
+						continue;
+					if(withinCell(cg, nbID, x[p], y[p], dist2))
+					{
+						n += cg.start[nbID + 1] - cg.start[nbID];
+						continue;
+					}
+					for(int f = subStart[nbID]; f < subStart[nbID + 1] && n < minPts; f++)
+					{
+						if(nearSubCell((double)x[p], (double)y[p], subX[f], subY[f], subSide, eps2))
+							n += subCount[f];
+					}
+				}
+			}
+			core[p] = (n >= minPts);
+			if(core[p])
+				subCore[e] ++;
+		}
+	}
+
+	int * cellCore;
+	if(NULL == (cellCore = (int *)malloc(sizeof(int) * (nCells + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int c = 0; c < nCells; c++)
+	{
+		cellCore[c] = 0;
+		for(int e = subStart[c]; e < subStart[c + 1]; e++)
+			cellCore[c] += subCore[e];
+	}
+
+	//ConnectCores: the core points of a cell are within the radius of each other, so cells are connected as a whole. each pair of neighboring cells is tested once in parallel, then joined
+	bool * linked;
+	if(NULL == (linked = (bool *)malloc(sizeof(bool) * 12 * (nCells + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(int c = 0; c < nCells; c++)
+	{
+		int colID = c % cg.nCellX;
+		int rowID = c / cg.nCellX;
+		int col, row, nbID, p;
+		for(int j = 0; j < 12; j++)
+		{
+			linked[c * 12 + j] = false;
+			col = colID + forwardCol[j];
+			row = rowID + forwardRow[j];
+			if(cellCore[c] == 0 || col < 0 || col >= cg.nCellX || row >= cg.nCellY)
+				continue;
+			nbID = row * cg.nCellX + col;
+			if(cellCore[nbID] == 0 || !nearCells(cg, c, nbID, dist2))
+				continue;
+			for(int k = cg.start[c]; k < cg.start[c + 1] && !linked[c * 12 + j]; k++)
+			{
+				p = cg.point[k];
+				if(!core[p])
+					continue;
+				for(int f = subStart[nbID]; f < subStart[nbID + 1]; f++)
+				{
+					if(subCore[f] > 0 && nearSubCell((double)x[p], (double)y[p], subX[f], subY[f], subSide, eps2))
+					{
+						linked[c * 12 + j] = true;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	int * parent;
+	if(NULL == (parent = (int *)malloc(sizeof(int) * (nCells + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int c = 0; c < nCells; c++)
+	{
+		parent[c] = c;
+	}
+	int rootA, rootB;
+	for(int c = 0; c < nCells; c++)
+	{
+		for(int j = 0; j < 12; j++)
+		{
+			if(!linked[c * 12 + j])
+				continue;
+			rootA = findRoot(parent, c);
+			rootB = findRoot(parent, c + forwardRow[j] * cg.nCellX + forwardCol[j]);
+			if(rootA < rootB)
+				parent[rootB] = rootA;
+			else if(rootB < rootA)
+				parent[rootA] = rootB;
+		}
+	}
+	free(linked);
+
+	//number the clusters by their first core point, dropping those with too few core points
+	int * rootCount;
+	if(NULL == (rootCount = (int *)malloc(sizeof(int) * (nCells + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int c = 0; c < nCells; c++)
+	{
+		rootCount[c] = 0;
+	}
+	for(int c = 0; c < nCells; c++)
+	{
+		rootCount[findRoot(parent, c)] += cellCore[c];
+	}
+	int * clusterID;
+	if(NULL == (clusterID = (int *)malloc(sizeof(int) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	int cID = 0;
+	int root;
+	for(int i = 0; i < count; i++)
+	{
+		clusterID[i] = -1;
+		if(!core[i])
+			continue;
+		root = findRoot(parent, cellOf[i]);
+		if(rootCount[root] > 0)
+		{
+			if(rootCount[root] > minCore)
+				rootCount[root] = -(++ cID);
+			else
+				rootCount[root] = 0;
+		}
+		if(rootCount[root] < 0)
+			clusterID[i] = -rootCount[root];
+	}
+	//the cluster of the core points of each cell
+	for(int c = 0; c < nCells; c++)
+	{
+		root = findRoot(parent, c);
+		cellCore[c] = (cellCore[c] > 0 && rootCount[root] < 0) ? -rootCount[root] : 0;
+	}
+
+	//AssignBorders: to the first cluster with a core sub-cell within the radius
+	if(nonCorePoints)
+	{
+		#pragma omp parallel for schedule(dynamic, 64)
+		for(int c = 0; c < nCells; c++)
+		{
+			int colID = c % cg.nCellX;
+			int rowID = c / cg.nCellX;
+			int colMin = (colID < 2) ? 0 : (colID - 2);
+			int colMax = (colID > cg.nCellX - 3) ? (cg.nCellX - 1) : (colID + 2);
+			int rowMin = (rowID < 2) ? 0 : (rowID - 2);
+			int rowMax = (rowID > cg.nCellY - 3) ? (cg.nCellY - 1) : (rowID + 2);
+			int p, nbID, best;
+			for(int k = cg.start[c]; k < cg.start[c + 1]; k++)
+			{
+				p = cg.point[k];
+				if(core[p])
+					continue;
+				best = INT_MAX;
+				for(int row = rowMin; row <= rowMax; row ++)
+				{
+					for(int col = colMin; col <= colMax; col ++)
+					{
+						nbID = row * cg.nCellX + col;
+						if(cellCore[nbID] == 0 || cellCore[nbID] >= best || !nearCell(cg, nbID, x[p], y[p], dist2))
+							continue;
+						for(int f = subStart[nbID]; f < subStart[nbID + 1]; f++)
+						{
+							if(subCore[f] > 0 && nearSubCell((double)x[p], (double)y[p], subX[f], subY[f], subSide, eps2))
+							{
+								best = cellCore[nbID];
+								break;
+							}
+						}
+					}
+				}
+				if(best != INT_MAX)
+					clusterID[p] = best;
+			}
+		}
+	}
+
+	free(rootCount);
+	free(parent);
+	free(cellCore);
+	free(core);
+	free(subX);
+	free(subY);
+	free(subCount);
+	free(subCore);
+	free(subStart);
+	free(nSub);
+	free(cellOf);
+	freeCells(cg);
+
+	return clusterID;
+}
+
+/**
+ * NAME:	doClusterDBSCAN_Cells
+ * DESCRIPTION:	cluster all event points using DBSCAN algorithm on cells with a diagonal of one search radius, in the precision of the point store. the result is the same as doClusterDBSCAN, which needs the neighbor count of every point
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all events
+ *	double radius:		the search radius
+ *	int minPts:		the minimum points to form a core points
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ * RETURN:
+ * 	TYPE:	int *
+ * 	VALUE:	an array of length count: the cluster ID of each event
+ */
+int * doClusterDBSCAN_Cells(struct pointStore * ps, double radius, int minPts, int minCore, bool nonCorePoints)
+{
+	double side = radius / sqrt(2.0);
+	if(ps->precision == PRECISION_FLOAT)
+		return cellDBSCAN(ps->xf, ps->yf, ps->count, 0, 0, side, floatDist2(radius), minPts, minCore, nonCorePoints);
+	if(ps->precision == PRECISION_INT)
+		return cellDBSCAN(ps->xq, ps->yq, ps->count, 0, 0, side / ps->resolution, quantDist2(ps, radius), minPts, minCore, nonCorePoints);
+	return cellDBSCAN(ps->x, ps->y, ps->count, ps->xMin, ps->yMin, side, radius * radius, minPts, minCore, nonCorePoints);
+}
+
+/**
+ * NAME:	doClusterDBSCAN_Approx
+ * DESCRIPTION:	cluster all event points using rho-approximate DBSCAN algorithm, in the precision of the point store
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all events
+ *	double radius:		the search radius
+ *	double rho:		the approximation of the search radius: points within radius are always neighbors, points farther than (1 + rho) * radius never are
+ *	int minPts:		the minimum points to form a core points
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ * RETURN:
+ * 	TYPE:	int *
+ * 	VALUE:	an array of length count: the cluster ID of each event
+ */
+int * doClusterDBSCAN_Approx(struct pointStore * ps, double radius, double rho, int minPts, int minCore, bool nonCorePoints)
+{
+	double side = radius / sqrt(2.0);
+	if(ps->precision == PRECISION_FLOAT)
+		return approxDBSCAN(ps->xf, ps->yf, ps->count, 0, 0, side, floatDist2(radius), rho, minPts, minCore, nonCorePoints);
+	if(ps->precision == PRECISION_INT)
+		return approxDBSCAN(ps->xq, ps->yq, ps->count, 0, 0, side / ps->resolution, quantDist2(ps, radius), rho, minPts, minCore, nonCorePoints);
+	return approxDBSCAN(ps->x, ps->y, ps->count, ps->xMin, ps->yMin, side, radius * radius, rho, minPts, minCore, nonCorePoints);
+}
+
+/**
+ * NAME:	parseEngine
+ * DESCRIPTION:	get the DBSCAN engine from its name
+ * PARAMETERS:
+ * 	const char * name:	stencil, cell or approx
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	ENGINE_STENCIL, ENGINE_CELL or ENGINE_APPROX, -1 if the name is unknown
+ */
+int parseEngine(const char * name)
+{
+	if(strcmp(name, "stencil") == 0)
+		return ENGINE_STENCIL;
+	if(strcmp(name, "cell") == 0)
+		return ENGINE_CELL;
+	if(strcmp(name, "approx") == 0)
+		return ENGINE_APPROX;
+	return -1;
+}
@@ -0,0 +1,14 @@
+#ifndef CELLDBSCANH
+#define CELLDBSCANH
+
+#define ENGINE_STENCIL 0
+#define ENGINE_CELL 1
+#define ENGINE_APPROX 2
+
+struct pointStore;
+
+int * doClusterDBSCAN_Cells(struct pointStore * ps, double radius, int minPts, int minCore, bool nonCorePoints);
+int * doClusterDBSCAN_Approx(struct pointStore * ps, double radius, double rho, int minPts, int minCore, bool nonCorePoints);
+int parseEngine(const char * name);
+
+#endif
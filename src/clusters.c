@@ -8,7 +8,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <limits.h>
+#include "io.h"
+#include "points.h"
+#include "memory.h"
 #include "clusters.h"
+#include "raster.h"
 
 /**
  * NAME:	PossionTest
@@ -62,410 +67,684 @@ double BinomialTest(int nCas, int nCon, double p)
 }
 
 /**
- * NAME:	doClusterPoi
- * DESCRIPTION:	cluster all event points based on a Possion Test
+ * NAME:	centerBlock
+ * DESCRIPTION:	find the index block of a point being expanded. double coordinates are mapped to their block directly, reduced precision coordinates are looked up from the point's array index so that the block is always the one it was indexed in
  * PARAMETERS:
- * 	double * x: 		the array of points' X values
- * 	double * y: 		the array of points' Y values
- * 	int * ind:			the array of points' type indicator (1: events, 0: background)
- * 	int * index:		the index of all event points
- * 	int nBlockX:		the number of index blocks along X dimension
- * 	int nBlockY:		the number of index blocks along Y dimension
- *	double radius:		the search radius, which is also the block size
- *	double xMin:		the minimum X of all points
- *	double yMin:		the minimum Y of all points
- *	int countB:			the number of background points
- *	int countE:			the number of event points
- *	int * eC:			the number of event (1) points (within radius) near each point
- *	double * lambda:	the local lambda of Possion distribution of each event points
- *	double significance: 	the significane level to tell a cluste core point
- *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
- *	bool nonCorePoints:	whether a cluster include non-core points
- *	struct clusterInfo ** pCInfo: the resulting output clusterInfo
+ * 	struct gridIndex * g:	the index of all points
+ * 	T * x: 		the array of points' X values
+ * 	T * y: 		the array of points' Y values
+ * 	int i:		the array index of the point
  * RETURN:
- * 	TYPE:	int *
- * 	VALUE:	the cluster ID of each point
+ * 	TYPE:	int
+ * 	VALUE:	the (row-major) ID of the block
  */
-int * doClusterPoi(double * x, double * y, int * ind, int * index, int nBlockX, int nBlockY, double radius, double xMin, double yMin, int countB, int countE, int * eC, double * lambda, double significance, int minCore, bool nonCorePoints, struct clusterInfo ** pCInfo)
+static inline int centerBlock(struct gridIndex * g, double * x, double * y, int i)
 {
-	int count = index[nBlockX * nBlockY];
+	int colID = (int)((x[i] - g->xMin) / g->blockSize);
+	int rowID = (int)((y[i] - g->yMin) / g->blockSize);
+	return rowID * g->nBlockX + colID;
+}
 
-	int * clusterID;
-	if(NULL == (clusterID = (int *)malloc(sizeof(int) * count)))
+template <typename T>
+static inline int centerBlock(struct gridIndex * g, T * x, T * y, int i)
+{
+	return blockOfPoint(g, i);
+}
+
+/**
+ * NAME:	pointCopies
+ * DESCRIPTION:	get the number of points of each type at a stored location
+ * PARAMETERS:
+ * 	unsigned long long * label:	points' bit-packed type labels
+ * 	int * weight:	the number of points at each location (NULL: one point at every location)
+ * 	int * weight1:	the number of type 1 points at each location (NULL: all points at a location are of its label's type)
+ * 	int i:		the array index of the location
+ * 	int &n0:	output, the number of type 0 points
+ * 	int &n1:	output, the number of type 1 points
+ * RETURN: none
+ */
+static inline void pointCopies(unsigned long long * label, int * weight, int * weight1, int i, int &n0, int &n1)
+{
+	int n = (weight == NULL) ? 1 : weight[i];
+	if(weight1 != NULL)
+		n1 = weight1[i];
+	else
+		n1 = (GET_LABEL(label, i) == 1) ? n : 0;
+	n0 = n - n1;
+}
+
+/**
+ * NAME:	allocExpandWorkspace
+ * DESCRIPTION:	allocate the workspace of expanding clusters over count points, with no point marked
+ * PARAMETERS:
+ * 	int count:	the number of points
+ * RETURN:
+ * 	TYPE:	struct expandWorkspace *
+ * 	VALUE:	the workspace
+ */
+struct expandWorkspace * allocExpandWorkspace(int count)
+{
+	struct expandWorkspace * ws;
+	if(NULL == (ws = (struct expandWorkspace *)malloc(sizeof(struct expandWorkspace))))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-
-	for(int i = 0; i < count; i++)
+	ws->count = count;
+	ws->epoch = 0;
+	if(NULL == (ws->mark = (unsigned int *)allocZeroArray(sizeof(unsigned int) * count)))
 	{
-		if(PossionTest(eC[i], lambda[i]) < significance)
-			clusterID[i] = 0;
-		else
-			clusterID[i] = -1;
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
 	}
-
-	int * pointsToDo;
-	if(NULL == (pointsToDo = (int *)malloc(sizeof(int) * count)))
+	if(NULL == (ws->pointsToDo = (int *)allocArray(sizeof(int) * count)))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	int nPToDo = 0;
-	int cID = 0;
+	if(NULL == (ws->members = (int *)allocArray(sizeof(int) * count)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	ws->spare = NULL;
+	ws->nBlocks = 0;
+	ws->blockEpoch = 0;
+	ws->blockMark = NULL;
+	ws->haloMark = NULL;
+	ws->blockSlot = NULL;
+	ws->coreBlocks = NULL;
+	ws->parent = NULL;
+	ws->seedComp = NULL;
+	ws->order = NULL;
+	ws->compStart = NULL;
+	ws->compRank = NULL;
+	ws->compKey = NULL;
+	ws->compTally = NULL;
+	return ws;
+}
 
-	int * inCluster;
+/**
+ * NAME:	startEpochs
+ * DESCRIPTION:	start a clustering on the workspace: cluster cID is given the epoch base + cID, which no point is marked with yet. the marks are only cleared when the epochs would wrap around
+ * PARAMETERS:
+ * 	struct expandWorkspace * ws:	the workspace
+ * RETURN:
+ * 	TYPE:	unsigned int
+ * 	VALUE:	the base of the epochs of the clustering
+ */
+static inline unsigned int startEpochs(struct expandWorkspace * ws)
+{
+	if(ws->epoch > UINT_MAX - (unsigned int)ws->count) {
+		for(int i = 0; i < ws->count; i++) {
+			ws->mark[i] = 0;
+		}
+		ws->epoch = 0;
+	}
+	return ws->epoch;
+}
 
-	if(NULL == (inCluster = (int *)malloc(sizeof(int) * count))) {
+/**
+ * NAME:	newClusterInfo
+ * DESCRIPTION:	get a cluster info, reusing one given back to the workspace if there is any
+ * PARAMETERS:
+ * 	struct expandWorkspace * ws:	the workspace
+ * RETURN:
+ * 	TYPE:	struct clusterInfo *
+ * 	VALUE:	the cluster info
+ */
+static struct clusterInfo * newClusterInfo(struct expandWorkspace * ws)
+{
+	struct clusterInfo * info = ws->spare;
+	if(info != NULL) {
+		ws->spare = info->next;
+		return info;
+	}
+	if(NULL == (info = (struct clusterInfo *)malloc(sizeof(struct clusterInfo))))
+	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	
-	for(int i = 0; i < count; i++) {
-		inCluster[i] = -1;
+	return info;
+}
+
+/**
+ * NAME:	recycleClusterInfo
+ * DESCRIPTION:	give a list of cluster infos back to the workspace, to be reused by the next clustering on it
+ * PARAMETERS:
+ * 	struct expandWorkspace * ws:	the workspace
+ * 	struct clusterInfo * cInfo:	the list of cluster infos
+ * RETURN: none
+ */
+void recycleClusterInfo(struct expandWorkspace * ws, struct clusterInfo * cInfo)
+{
+	struct clusterInfo * next;
+	while(cInfo != NULL) {
+		next = cInfo->next;
+		cInfo->next = ws->spare;
+		ws->spare = cInfo;
+		cInfo = next;
 	}
+}
 
-	double dist2 = radius * radius;
+/**
+ * NAME:	freeExpandWorkspace
+ * DESCRIPTION:	free the workspace and the cluster infos given back to it
+ * PARAMETERS:
+ * 	struct expandWorkspace * ws:	the workspace
+ * RETURN: none
+ */
+void freeExpandWorkspace(struct expandWorkspace * ws)
+{
+	struct clusterInfo * next;
+	while(ws->spare != NULL) {
+		next = ws->spare->next;
+		free(ws->spare);
+		ws->spare = next;
+	}
+	free(ws->mark);
+	free(ws->pointsToDo);
+	free(ws->members);
+	free(ws->blockMark);
+	free(ws->haloMark);
+	free(ws->blockSlot);
+	free(ws->coreBlocks);
+	free(ws->parent);
+	free(ws->seedComp);
+	free(ws->order);
+	free(ws->compStart);
+	free(ws->compRank);
+	free(ws->compKey);
+	free(ws->compTally);
+	free(ws);
+}
 
-	double cX, cY;
-	int colID, rowID;
-	int colMin, colMax, rowMin, rowMax;
+/**
+ * The models of cluster expansion. Each model is a struct holding the parameters of the test and the tallies of the cluster being expanded, with the same set of inline functions overloaded for it:
+ * 	isCore:			whether a point is a core point, before any cluster is expanded
+ * 	expands:		whether a core point starts a cluster and is expanded when reached
+ * 	startCluster:	start the tallies of a cluster at its seed
+ * 	joinCore:		count a core point reached by the cluster, returning whether it is expanded
+ * 	joinNonCore:	count a non-core point reached by the cluster
+ * 	coreCount:		the number of core points of the cluster, compared with minCore
+ * 	clusterLL:		the log likelihood of the cluster
+ * 	fillInfo:		write the tallies of the cluster to its clusterInfo
+ * 	noClusterLL, higherLL:	the maximum log likelihood without any cluster, and whether a cluster's is above the maximum so far
+ * 	marksReached:	whether the points reached by a cluster are marked in the workspace
+ * 	bounds:			whether a maximum log likelihood search may skip the components whose bound is not above the maximum so far, see boundComponents
+ * 	boundCopies:	the type 0 and type 1 points at a location, as the tallies of a cluster count them
+ * 	boundLL:		an upper bound of the log likelihood of any cluster kept within a set of points, given the type 1 points at its expanded core locations and all its type 0 and type 1 points. the log likelihoods are convex in the tallies of a cluster, so the largest one is at a corner of the range the tallies can take
+ */
 
-	int iNb;
-	int iNbEnd;
+//Bernoulli: clusters start from and expand through the locations with cases, and hold both the cases and controls of their locations
+struct berModel {
+	unsigned long long * label;
+	int * weight;
+	int * weight1;
+	int countCas;
+	int countCon;
+	struct neighborCounts * nc;	//only needed by isCore
+	double p;
+	double significance;
+	int nCas;
+	int nCon;
+	int nCore;
+};
+
+static inline bool isCore(struct berModel &m, int i)
+{
+	return BinomialTest(COUNT_AT(m.nc, m.nc->c1, i), COUNT_AT(m.nc, m.nc->c0, i), m.p) < m.significance;
+}
 
-	int coreCount;
+static inline bool expands(struct berModel &m, int i)
+{
+	return GET_LABEL(m.label, i) == 1;
+}
 
-	int nEInCluster;
-	int nBInCluster;
-	struct clusterInfo * curInfo;
-//	printf("ClusterID,Events,expEvents,LL\n");
+static inline void startCluster(struct berModel &m, int i)
+{
+	//the other points at the seed's location are reached with it
+	int n0, n1;
+	pointCopies(m.label, m.weight, m.weight1, i, n0, n1);
+	m.nCore = n1;
+	m.nCas = n1;
+	m.nCon = n0;
+}
 
-	for(int i = 0; i < count; i++)
-	{
-		if(clusterID[i] != 0 || ind[i] == 0)
-			continue;
-		pointsToDo[0] = i;
-		nPToDo = 1;
-		cID ++;
-		clusterID[i] = cID;
-		
-		coreCount = 1;
-
-		inCluster[i] = cID;
-		nEInCluster = 1;
-		nBInCluster = 0;
-
-		while(nPToDo > 0) {
-			nPToDo --;
-			cX = x[pointsToDo[nPToDo]];		
-			cY = y[pointsToDo[nPToDo]];
-
-			colID = (int)((cX - xMin) / radius);
-			rowID = (int)((cY - yMin) / radius);
-
-			colMin = (colID == 0) ? 0 : (colID - 1);
-			colMax = (colID == nBlockX - 1) ? (nBlockX - 1) : (colID + 1);
-			rowMin = (rowID == 0) ? 0 : (rowID - 1);
-			rowMax = (rowID == nBlockY - 1) ? (nBlockY - 1) : (rowID + 1);
-
-			for(int row = rowMin; row <= rowMax; row ++)
-			{
-				for(iNb = index[row * nBlockX + colMin]; iNb < index[row * nBlockX + colMax + 1]; iNb ++)
-				{
-					if(inCluster[iNb] != cID) {
-						if(dist2 >= ((x[iNb] - cX) * (x[iNb] - cX) + (y[iNb] - cY) * (y[iNb] - cY))) {
-							if(clusterID[iNb] == 0) {
-								clusterID[iNb] = cID;
-								if(ind[iNb] == 0) {
-									nBInCluster ++;
-								}
-								else {
-									pointsToDo[nPToDo] = iNb;
-									nPToDo ++;
-									nEInCluster ++;
-									coreCount ++;
-								}
-							}
-							else if(clusterID[iNb] == -1 && nonCorePoints) {
-								clusterID[iNb] = cID;
-								if(ind[iNb] == 0) {
-									nBInCluster ++;
-								}
-								else {
-									nEInCluster ++;
-								}
-							}
+static inline bool joinCore(struct berModel &m, int i)
+{
+	int n0, n1;
+	pointCopies(m.label, m.weight, m.weight1, i, n0, n1);
+	m.nCon += n0;
+	if(GET_LABEL(m.label, i) == 1) {
+		m.nCas += n1;
+		m.nCore += n1;
+		return true;
+	}
+	return false;
+}
 
-							inCluster[iNb] = cID;
-						}
-					}
+static inline void joinNonCore(struct berModel &m, int i)
+{
+	int n0, n1;
+	pointCopies(m.label, m.weight, m.weight1, i, n0, n1);
+	m.nCon += n0;
+	m.nCas += n1;
+}
 
-				}
-			}
-		
-		}
+static inline int coreCount(struct berModel &m)
+{
+	return m.nCore;
+}
 
-		if(coreCount <= minCore)
-		{
-			for(int j = 0; j < count; j++)
-			{
-				if(clusterID[j] == cID)
-					clusterID[j] = -1;
-			}
-			cID --;
-		}
-		else {
-			double expEventInCluster = (double)(nBInCluster) / countB * countE;
-			double LL = nEInCluster * log(nEInCluster/expEventInCluster);
-			if(nEInCluster < countE) {
-				LL += (countE - nEInCluster) * log((countE - nEInCluster) / (countE - expEventInCluster));
-			}
+static inline double clusterLL(struct berModel &m)
+{
+	double countInCl = m.nCas + m.nCon;
+	double LL = 0;
+	if(m.nCas > 0) {
+		LL += m.nCas * log(m.nCas/countInCl);
+	}
+	if(m.nCon > 0) {
+		LL += m.nCon * log(m.nCon/countInCl);
+	}
+	if(m.countCas > m.nCas) {
+		LL += (m.countCas - m.nCas) * log((m.countCas - m.nCas)/(m.countCas + m.countCon - countInCl));
+	}
+	if(m.countCon > m.nCon) {
+		LL += (m.countCon - m.nCon) * log((m.countCon - m.nCon)/(m.countCas + m.countCon - countInCl));
+	}
+	return LL;
+}
 
-			if(cID == 1) {
-				*pCInfo = (struct clusterInfo *) malloc (sizeof (struct clusterInfo));
-				curInfo = *pCInfo;
-			}
-			else {
-				curInfo->next = (struct clusterInfo *) malloc (sizeof (struct clusterInfo));
-				curInfo = curInfo->next; 
-			}
-			curInfo->clusterID = cID;
-			curInfo->count1 = nEInCluster;
-			curInfo->expCount1 = expEventInCluster;
-			curInfo->ll = LL;
-			curInfo->next = NULL; 
+static inline void fillInfo(struct berModel &m, struct clusterInfo * info)
+{
+	info->count1 = m.nCas;
+	info->count0 = m.nCon;
+}
 
-//			printf("%d,%d,%lf,%lf\n", cID, nEInCluster, expEventInCluster, LL);
-		}
-	}
+//a log likelihood is never positive, so 1 stands for no cluster
+static inline double noClusterLL(struct berModel &m)
+{
+	return 1;
+}
 
-	free(inCluster);
+static inline bool higherLL(struct berModel &m, double LL, double resultLL)
+{
+	return resultLL > 0 || resultLL < LL;
+}
 
-	free(pointsToDo);
-	return clusterID; 
+static inline bool marksReached(struct berModel &m)
+{
+	return true;
 }
 
+static inline bool bounds(struct berModel &m)
+{
+	return true;
+}
 
-/**
- * NAME:	doClusterBer
- * DESCRIPTION:	cluster all event points based on a Binomial Test
- * PARAMETERS:
- * 	double * x: 		the array of points' X values
- * 	double * y: 		the array of points' Y values
- * 	int * ind:			the array of points' type indicator (1: case, 0: control)
- * 	int * index:		the index of all event points
- * 	int nBlockX:		the number of index blocks along X dimension
- * 	int nBlockY:		the number of index blocks along Y dimension
- *	double radius:		the search radius, which is also the block size
- *	double xMin:		the minimum X of all points
- *	double yMin:		the minimum Y of all points
- *	int countCas:		the number of case points
- *	int countCon:		the number of control points
- *	int * casC:			the number of case points (within radius) near each case points
- *	int * conC:			the number of control points (within radius) near each case points
- *	double p:			the p of Possion distribution
- *	double significance: 	the significane level to tell a cluste core point
- *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
- *	bool nonCorePoints:	whether a cluster include non-core points
- *	struct clusterInfo ** pCInfo: the resulting output clusterInfo
- * RETURN:
- * 	TYPE:	int *
- * 	VALUE:	the cluster ID of each point
- */
-int * doClusterBer(double * x, double * y, int * ind, int * index, int nBlockX, int nBlockY, double radius, double xMin, double yMin, int countCas, int countCon, int * casC, int * conC, double p, double significance, int minCore, bool nonCorePoints, struct clusterInfo ** pCInfo)
+static inline void boundCopies(struct berModel &m, int i, int &n0, int &n1)
 {
-	int count = index[nBlockX * nBlockY];
+	pointCopies(m.label, m.weight, m.weight1, i, n0, n1);
+}
 
-	int * clusterID;
-	if(NULL == (clusterID = (int *)malloc(sizeof(int) * count)))
-	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
+static inline double boundLL(struct berModel &m, int minCore, long long nCore, long long n0, long long n1)
+{
+	//a kept cluster has more core cases than minCore, and at most all the cases and controls
+	if(nCore <= minCore)
+		return -HUGE_VAL;
+	int lo = (minCore + 1 > 1) ? minCore + 1 : 1;
+	struct berModel t = m;
+	double bound = -HUGE_VAL;
+	double LL;
+	for(int corner = 0; corner < 4; corner++) {
+		t.nCas = (corner & 1) ? (int)n1 : lo;
+		t.nCon = (corner & 2) ? (int)n0 : 0;
+		LL = clusterLL(t);
+		if(LL != LL)
+			return HUGE_VAL;
+		if(LL > bound)
+			bound = LL;
 	}
+	return bound;
+}
 
-	for(int i = 0; i < count; i++)
-	{
-		if(BinomialTest(casC[i], conC[i], p) < significance)
-			clusterID[i] = 0;
-		else
-			clusterID[i] = -1;
+//Poisson: clusters start from and expand through the locations with events. the background of the observed data is its own points, while the events of a replication (NULLMODEL) are drawn among the background points, so they are counted in it, except for the seed
+template <bool NULLMODEL>
+struct poiModel {
+	unsigned long long * label;
+	int * weight;
+	int * weight1;
+	int countB;
+	int countE;
+	struct neighborCounts * nc;	//only needed by isCore
+	double baseLineRatio;
+	double significance;
+	int nE;
+	int nB;
+	int nCore;
+};
+
+template <bool NULLMODEL>
+static inline bool isCore(struct poiModel<NULLMODEL> &m, int i)
+{
+	return PossionTest(COUNT_AT(m.nc, m.nc->c1, i), (double)(COUNT_AT(m.nc, m.nc->c0, i)) * m.countE * m.baseLineRatio / m.countB) < m.significance;
+}
+
+template <bool NULLMODEL>
+static inline bool expands(struct poiModel<NULLMODEL> &m, int i)
+{
+	return GET_LABEL(m.label, i) == 1;
+}
+
+template <bool NULLMODEL>
+static inline void startCluster(struct poiModel<NULLMODEL> &m, int i)
+{
+	int n0, n1;
+	pointCopies(m.label, m.weight, m.weight1, i, n0, n1);
+	m.nCore = n1;
+	m.nE = n1;
+	m.nB = NULLMODEL ? n0 + n1 - 1 : n0;
+}
+
+template <bool NULLMODEL>
+static inline bool joinCore(struct poiModel<NULLMODEL> &m, int i)
+{
+	int n0, n1;
+	pointCopies(m.label, m.weight, m.weight1, i, n0, n1);
+	m.nB += NULLMODEL ? n0 + n1 : n0;
+	if(GET_LABEL(m.label, i) == 1) {
+		m.nE += n1;
+		m.nCore += n1;
+		return true;
 	}
+	return false;
+}
 
-	int * pointsToDo;
-	if(NULL == (pointsToDo = (int *)malloc(sizeof(int) * count)))
-	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
+template <bool NULLMODEL>
+static inline void joinNonCore(struct poiModel<NULLMODEL> &m, int i)
+{
+	int n0, n1;
+	pointCopies(m.label, m.weight, m.weight1, i, n0, n1);
+	m.nB += NULLMODEL ? n0 + n1 : n0;
+	m.nE += n1;
+}
+
+template <bool NULLMODEL>
+static inline int coreCount(struct poiModel<NULLMODEL> &m)
+{
+	return m.nCore;
+}
+
+template <bool NULLMODEL>
+static inline double clusterLL(struct poiModel<NULLMODEL> &m)
+{
+	double expEventInCluster = (double)(m.nB) / m.countB * m.countE;
+	double LL = m.nE * log(m.nE/expEventInCluster);
+	if(m.nE < m.countE) {
+		LL += (m.countE - m.nE) * log((m.countE - m.nE) / (m.countE - expEventInCluster));
 	}
-	int nPToDo = 0;
-	int cID = 0;
+	return LL;
+}
 
-	int * inCluster;
+template <bool NULLMODEL>
+static inline void fillInfo(struct poiModel<NULLMODEL> &m, struct clusterInfo * info)
+{
+	info->count1 = m.nE;
+	info->count0 = m.nB;
+	info->expCount1 = (double)(m.nB) / m.countB * m.countE;
+}
 
-	if(NULL == (inCluster = (int *)malloc(sizeof(int) * count))) {
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
+template <bool NULLMODEL>
+static inline double noClusterLL(struct poiModel<NULLMODEL> &m)
+{
+	return -1;
+}
+
+template <bool NULLMODEL>
+static inline bool higherLL(struct poiModel<NULLMODEL> &m, double LL, double resultLL)
+{
+	return resultLL < LL;
+}
+
+template <bool NULLMODEL>
+static inline bool marksReached(struct poiModel<NULLMODEL> &m)
+{
+	return true;
+}
+
+//the background of the observed data is not bounded from its events, only replications are
+template <bool NULLMODEL>
+static inline bool bounds(struct poiModel<NULLMODEL> &m)
+{
+	return NULLMODEL;
+}
+
+template <bool NULLMODEL>
+static inline void boundCopies(struct poiModel<NULLMODEL> &m, int i, int &n0, int &n1)
+{
+	pointCopies(m.label, m.weight, m.weight1, i, n0, n1);
+}
+
+template <bool NULLMODEL>
+static inline double boundLL(struct poiModel<NULLMODEL> &m, int minCore, long long nCore, long long n0, long long n1)
+{
+	//the events of a replication are background points too, so a cluster of nE events has at least nE - 1 background points besides its seed
+	if(nCore <= minCore)
+		return -HUGE_VAL;
+	int lo = (minCore + 1 > 1) ? minCore + 1 : 1;
+	int hiB = (int)(n0 + n1 - 1);
+	int cornerE[4] = {lo, (int)n1, (int)n1, lo};
+	int cornerB[4] = {lo - 1, (int)n1 - 1, hiB, hiB};
+	struct poiModel<NULLMODEL> t = m;
+	double bound = -HUGE_VAL;
+	double LL;
+	for(int corner = 0; corner < 4; corner++) {
+		if(cornerB[corner] <= 0)
+			return HUGE_VAL;
+		t.nE = cornerE[corner];
+		t.nB = cornerB[corner];
+		LL = clusterLL(t);
+		if(LL != LL)
+			return HUGE_VAL;
+		if(LL > bound)
+			bound = LL;
 	}
+	return bound;
+}
+
+//Poisson against a background raster: the store only holds the events, the local lambda of each event is the background mass within the search radius of it, and the background of a cluster is the mass of the cells within the search radius of its core points
+struct rasterModel {
+	struct pointStore * ps;
+	struct rasterGrid * ra;
+	double radius;
+	int countE;
+	struct neighborCounts * nc;
+	double baseLineRatio;
+	double significance;
+	int * cores;	//the core points of the cluster, whose neighborhoods make its background
+	int nCore;
+	int nE;
+	double mass;
+};
+
+static inline bool isCore(struct rasterModel &m, int i)
+{
+	return PossionTest(COUNT_AT(m.nc, m.nc->c0, i), rasterDiskMass(m.ra, pointX(m.ps, i), pointY(m.ps, i), m.radius) * m.countE * m.baseLineRatio / m.ra->total) < m.significance;
+}
+
+static inline bool expands(struct rasterModel &m, int i)
+{
+	return true;
+}
+
+static inline void startCluster(struct rasterModel &m, int i)
+{
+	m.cores[0] = i;
+	m.nCore = 1;
+	m.nE = 1;
+}
+
+static inline bool joinCore(struct rasterModel &m, int i)
+{
+	m.cores[m.nCore] = i;
+	m.nCore ++;
+	m.nE ++;
+	return true;
+}
+
+static inline void joinNonCore(struct rasterModel &m, int i)
+{
+	m.nE ++;
+}
 
-	for(int i = 0; i < count; i++) {
-		inCluster[i] = -1;
+static inline int coreCount(struct rasterModel &m)
+{
+	return m.nCore;
+}
+
+static inline double clusterLL(struct rasterModel &m)
+{
+	m.mass = rasterClusterMass(m.ra, m.ps, m.cores, m.nCore, m.radius);
+	double expEventInCluster = m.mass / m.ra->total * m.countE;
+	double LL = m.nE * log(m.nE/expEventInCluster);
+	if(m.nE < m.countE) {
+		LL += (m.countE - m.nE) * log((m.countE - m.nE) / (m.countE - expEventInCluster));
 	}
+	return LL;
+}
 
-	double dist2 = radius * radius;
+static inline void fillInfo(struct rasterModel &m, struct clusterInfo * info)
+{
+	info->count1 = m.nE;
+	info->count0 = (int)(m.mass + 0.5);
+	info->expCount1 = m.mass / m.ra->total * m.countE;
+}
 
-	double cX, cY;
-	int colID, rowID;
-	int colMin, colMax, rowMin, rowMax;
+static inline double noClusterLL(struct rasterModel &m)
+{
+	return -1;
+}
 
-	int iNb;
+static inline bool higherLL(struct rasterModel &m, double LL, double resultLL)
+{
+	return resultLL < LL;
+}
 
-	int coreCount;
+static inline bool marksReached(struct rasterModel &m)
+{
+	return true;
+}
 
-	int nCasInCluster;
-	int nConInCluster;
-	struct clusterInfo * curInfo;
-//	printf("ClusterID,nCas,nCon,LL\n");
+//the background of a raster cluster is not a tally of its points, so it is never bounded
+static inline bool bounds(struct rasterModel &m)
+{
+	return false;
+}
 
-	for(int i = 0; i < count; i++)
-	{
-		if(clusterID[i] != 0 || ind[i] == 0)
-			continue;
-		pointsToDo[0] = i;
-		nPToDo = 1;
-		cID ++;
-		clusterID[i] = cID;
-		
-		coreCount = 1;
-
-		inCluster[i] = cID;
-		nCasInCluster = 1;
-		nConInCluster = 0;
-
-		while(nPToDo > 0) {
-			nPToDo --;
-			cX = x[pointsToDo[nPToDo]];		
-			cY = y[pointsToDo[nPToDo]];
-
-			colID = (int)((cX - xMin) / radius);
-			rowID = (int)((cY - yMin) / radius);
-
-			colMin = (colID == 0) ? 0 : (colID - 1);
-			colMax = (colID == nBlockX - 1) ? (nBlockX - 1) : (colID + 1);
-			rowMin = (rowID == 0) ? 0 : (rowID - 1);
-			rowMax = (rowID == nBlockY - 1) ? (nBlockY - 1) : (rowID + 1);
-
-			for(int row = rowMin; row <= rowMax; row ++)
-			{
-				for(iNb = index[row * nBlockX + colMin]; iNb < index[row * nBlockX + colMax + 1]; iNb ++)
-				{
-					if(inCluster[iNb] != cID) {
-						if(dist2 >= ((x[iNb] - cX) * (x[iNb] - cX) + (y[iNb] - cY) * (y[iNb] - cY))) {
-							if(clusterID[iNb] == 0) {
-								clusterID[iNb] = cID;
+static inline void boundCopies(struct rasterModel &m, int i, int &n0, int &n1)
+{
+	n0 = 0;
+	n1 = 1;
+}
 
-								if(ind[iNb] == 0) {
-									nConInCluster ++;
-								}
-								else {
-									pointsToDo[nPToDo] = iNb;
-									nPToDo ++;
-									nCasInCluster ++;
-									coreCount ++;
-								}
-							}
-							else if(clusterID[iNb] == -1 && nonCorePoints) {
-								clusterID[iNb] = cID;
-								if(ind[iNb] == 0) {
-									nConInCluster ++;
-								}
-								else {
-									nCasInCluster ++;
-								}
-							}
+static inline double boundLL(struct rasterModel &m, int minCore, long long nCore, long long n0, long long n1)
+{
+	return HUGE_VAL;
+}
 
-							inCluster[iNb] = cID;
-							
-						}
-					}
-				}
-			}
-		}
+//DBSCAN: every core point is expanded, and a point is known to be in the cluster by its cluster ID alone
+struct dbscanModel {
+	struct neighborCounts * nc;
+	int minPts;
+	int nCore;
+};
 
-		if(coreCount <= minCore)
-		{
-			for(int j = 0; j < (count); j++)
-			{
-				if(clusterID[j] == cID)
-					clusterID[j] = -1;
-			}
-			cID --;
-		}
-		else {
-			double countInCl = nCasInCluster + nConInCluster;
-			double LL = 0;
-			if(nCasInCluster > 0) {
-				LL += nCasInCluster * log(nCasInCluster/countInCl);
-			}
-			if(nConInCluster > 0) {
-				LL += nConInCluster * log(nConInCluster/countInCl);
-			}
-			if(countCas > nCasInCluster) {
-				LL += (countCas - nCasInCluster) * log((countCas - nCasInCluster)/(count-countInCl));
-			}
-			if(countCon > nConInCluster) {
-				LL += (countCon - nConInCluster) * log((countCon - nConInCluster)/(count-countInCl));
-			}
-			if(cID == 1) {
-				*pCInfo = (struct clusterInfo *) malloc (sizeof (struct clusterInfo));
-				curInfo = *pCInfo;
-			}
-			else {
-				curInfo->next = (struct clusterInfo *) malloc (sizeof (struct clusterInfo));
-				curInfo = curInfo->next; 
-			}
-			curInfo->clusterID = cID;
-			curInfo->count1 = nCasInCluster;
-			curInfo->count0 = nConInCluster;
-			curInfo->ll = LL;
-			curInfo->next = NULL; 
-//			printf("%d,%d,%d,%lf\n", cID, nCasInCluster, nConInCluster, LL);
-		}
-	}
+static inline bool isCore(struct dbscanModel &m, int i)
+{
+	return COUNT_AT(m.nc, m.nc->c0, i) >= m.minPts;
+}
 
-	free(pointsToDo);
-	free(inCluster);
+static inline bool expands(struct dbscanModel &m, int i)
+{
+	return true;
+}
+
+static inline void startCluster(struct dbscanModel &m, int i)
+{
+	m.nCore = 1;
+}
 
-	return clusterID; 
+static inline bool joinCore(struct dbscanModel &m, int i)
+{
+	m.nCore ++;
+	return true;
 }
 
+static inline void joinNonCore(struct dbscanModel &m, int i)
+{
+}
+
+static inline int coreCount(struct dbscanModel &m)
+{
+	return m.nCore;
+}
+
+static inline double clusterLL(struct dbscanModel &m)
+{
+	return 0;
+}
+
+static inline void fillInfo(struct dbscanModel &m, struct clusterInfo * info)
+{
+}
+
+static inline double noClusterLL(struct dbscanModel &m)
+{
+	return 0;
+}
+
+static inline bool higherLL(struct dbscanModel &m, double LL, double resultLL)
+{
+	return false;
+}
+
+static inline bool marksReached(struct dbscanModel &m)
+{
+	return false;
+}
+
+static inline bool bounds(struct dbscanModel &m)
+{
+	return false;
+}
+
+static inline void boundCopies(struct dbscanModel &m, int i, int &n0, int &n1)
+{
+	n0 = 0;
+	n1 = 1;
+}
+
+static inline double boundLL(struct dbscanModel &m, int minCore, long long nCore, long long n0, long long n1)
+{
+	return HUGE_VAL;
+}
 
 /**
- * NAME:	doClusterDBSCAN
- * DESCRIPTION:	cluster all event points using DBSCAN algorithm
+ * NAME:	coreIDs
+ * DESCRIPTION:	tell the core points of a model
  * PARAMETERS:
- * 	double * x: 		the array of events' X values
- * 	double * y: 		the array of events' Y values
- * 	int * index:		the index of all event points
- * 	int nBlockX:		the number of index blocks along X dimension
- * 	int nBlockY:		the number of index blocks along Y dimension
- *	double radius:		the search radius, which is also the block size
- *	int minPts:		the minimum points to form a core points
- *	double xMin:		the minimum X of all points
- *	double yMin:		the minimum Y of all points
- *	int * eC:		the number of event points (within radius) near each event points
- *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
- *	bool nonCorePoints:	whether a cluster include non-core points
+ * 	M &model:	the model
+ * 	int count:	the number of points
  * RETURN:
  * 	TYPE:	int *
- * 	VALUE:	an array of length count: the cluster ID of each case and control point
+ * 	VALUE:	0 for core points and -1 for the others
  */
-int * doClusterDBSCAN(double * x, double * y, int * index, int nBlockX, int nBlockY, double radius, int minPts, double xMin, double yMin, int * eC, int minCore, bool nonCorePoints) {
-
-	int count = index[nBlockX * nBlockY];
-
+template <typename M>
+static int * coreIDs(M &model, int count)
+{
 	int * clusterID;
-	if(NULL == (clusterID = (int *)malloc(sizeof(int) * count)))
+	if(NULL == (clusterID = (int *)allocArray(sizeof(int) * count)))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
@@ -473,448 +752,779 @@ int * doClusterDBSCAN(double * x, double * y, int * index, int nBlockX, int nBlo
 
 	for(int i = 0; i < count; i++)
 	{
-		if(eC[i] >= minPts)
+		if(isCore(model, i))
 			clusterID[i] = 0;
 		else
 			clusterID[i] = -1;
 	}
+	return clusterID;
+}
 
-	int * pointsToDo;
-	if(NULL == (pointsToDo = (int *)malloc(sizeof(int) * count)))
-	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
-	}
-	int nPToDo = 0;
-	int cID = 0;
-
-	double dist2 = radius * radius;
-
-	double cX, cY;
-	int colID, rowID;
-	int colMin, colMax, rowMin, rowMax;
+//a component of a maximum log likelihood search and the bound of the log likelihood of its clusters
+struct componentKey {
+	double bound;
+	int comp;
+};
 
-	int iNb;
+/**
+ * NAME:	compareComponentKey
+ * DESCRIPTION:	compare two components for qsort, from the highest bound down, ties are broken by the component so that the order is stable
+ */
+static int compareComponentKey(const void * a, const void * b)
+{
+	const struct componentKey * ka = (const struct componentKey *)a;
+	const struct componentKey * kb = (const struct componentKey *)b;
+	if(ka->bound != kb->bound)
+		return (ka->bound > kb->bound) ? -1 : 1;
+	return ka->comp - kb->comp;
+}
 
-	int coreCount;
+/**
+ * NAME:	findRoot
+ * DESCRIPTION:	find the root of a tree of the union-find forest, halving the path to it
+ */
+static inline int findRoot(int * parent, int a)
+{
+	while(parent[a] != a) {
+		parent[a] = parent[parent[a]];
+		a = parent[a];
+	}
+	return a;
+}
 
-	for(int i = 0; i < count; i++)
+/**
+ * NAME:	allocComponents
+ * DESCRIPTION:	allocate the arrays of the workspace that boundComponents needs for an index of nBlocks blocks, unless they are already there
+ * PARAMETERS:
+ * 	struct expandWorkspace * ws:	the workspace
+ * 	int nBlocks:	the number of blocks of the index
+ * RETURN: none
+ */
+static void allocComponents(struct expandWorkspace * ws, int nBlocks)
+{
+	if(ws->nBlocks == nBlocks)
+		return;
+	free(ws->blockMark);
+	free(ws->haloMark);
+	free(ws->blockSlot);
+	free(ws->coreBlocks);
+	free(ws->parent);
+	free(ws->seedComp);
+	free(ws->order);
+	free(ws->compStart);
+	free(ws->compRank);
+	free(ws->compKey);
+	free(ws->compTally);
+
+	ws->nBlocks = nBlocks;
+	ws->blockEpoch = 0;
+	ws->blockMark = (unsigned int *)calloc(nBlocks, sizeof(unsigned int));
+	ws->haloMark = (unsigned int *)calloc(nBlocks, sizeof(unsigned int));
+	ws->blockSlot = (int *)malloc(sizeof(int) * nBlocks);
+	ws->coreBlocks = (int *)malloc(sizeof(int) * nBlocks);
+	ws->parent = (int *)malloc(sizeof(int) * nBlocks);
+	ws->seedComp = (int *)malloc(sizeof(int) * ws->count);
+	ws->order = (int *)malloc(sizeof(int) * ws->count);
+	ws->compStart = (int *)malloc(sizeof(int) * (nBlocks + 1));
+	ws->compRank = (int *)malloc(sizeof(int) * nBlocks);
+	ws->compKey = (struct componentKey *)malloc(sizeof(struct componentKey) * nBlocks);
+	ws->compTally = (long long *)malloc(sizeof(long long) * 3 * nBlocks);
+	if(ws->blockMark == NULL || ws->haloMark == NULL || ws->blockSlot == NULL || ws->coreBlocks == NULL || ws->parent == NULL || ws->seedComp == NULL || ws->order == NULL || ws->compStart == NULL || ws->compRank == NULL || ws->compKey == NULL || ws->compTally == NULL)
 	{
-		if(clusterID[i] != 0)
-			continue;
-		pointsToDo[0] = i;
-		nPToDo = 1;
-		cID ++;
-		clusterID[i] = cID;
-		
-		coreCount = 1;	
-
-		while(nPToDo > 0) {
-			nPToDo --;
-			cX = x[pointsToDo[nPToDo]];		
-			cY = y[pointsToDo[nPToDo]];
-
-			colID = (int)((cX - xMin) / radius);
-			rowID = (int)((cY - yMin) / radius);
-
-			colMin = (colID == 0) ? 0 : (colID - 1);
-			colMax = (colID == nBlockX - 1) ? (nBlockX - 1) : (colID + 1);
-			rowMin = (rowID == 0) ? 0 : (rowID - 1);
-			rowMax = (rowID == nBlockY - 1) ? (nBlockY - 1) : (rowID + 1);
-
-			for(int row = rowMin; row <= rowMax; row ++)
-			{
-				for(iNb = index[row * nBlockX + colMin]; iNb < index[row * nBlockX + colMax + 1]; iNb ++)
-				{
-					if(clusterID[iNb] < 1)
-					{
-						if(dist2 >= ((x[iNb] - cX) * (x[iNb] - cX) + (y[iNb] - cY) * (y[iNb] - cY)))
-						{
-							if(clusterID[iNb] != -1)
-							{
-								pointsToDo[nPToDo] = iNb;
-								nPToDo ++;
-								coreCount ++;
-								clusterID[iNb] = cID;
-							}
-							else if(nonCorePoints)
-								clusterID[iNb] = cID;
-						}
-					}
-				}
-			}
-		
-		}
-
-		if(coreCount <= minCore)
-		{
-			for(int j = 0; j < count; j++)
-			{
-				if(clusterID[j] == cID)
-					clusterID[j] = -1;
-			}
-			cID --;
-		}
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
 	}
-
-
-	free(pointsToDo);
-	return clusterID;
 }
 
 /**
- * NAME:	berMaximumLL
- * DESCRIPTION:	find the maximum log likelihood of any cluster in a Bernoulli model
+ * NAME:	boundComponents
+ * DESCRIPTION:	group the seeds of a maximum log likelihood search into components that no cluster crosses, and bound the log likelihood of the clusters of each. the blocks holding seeds are joined when they are within two stencil reaches of each other, as two seeds farther apart can not reach the same point, so the clusters of different components never share a point and their log likelihoods do not depend on the order the components are taken in. the bound of a component is taken from the points of the blocks in the stencils of its seeds that a cluster may hold, see boundLL. the seeds are written to ws->order component by component, from the highest bound down, in their own order within a component
  * PARAMETERS:
- * 	double * x: 		the array of points' X values
- * 	double * y: 		the array of points' Y values
- * 	int * ind:			the array of points' type indicator (1: case, 0: control)
- * 	int * index:		the index of all event points
- * 	int nBlockX:		the number of index blocks along X dimension
- * 	int nBlockY:		the number of index blocks along Y dimension
- *	double radius:		the search radius, which is also the block size
- *	double xMin:		the minimum X of all points
- *	double yMin:		the minimum Y of all points
- *	int countCas:		the number of case points
- *	int countCon:		the number of control points
- *	int * casC:			the number of case points (within radius) near each case points
- *	int * conC:			the number of control points (within radius) near each case points
- *	double p:			the p of Possion distribution
- *	double significance: 	the significane level to tell a cluste core point
+ * 	T * x: 			the array of points' X values, in the precision of the point store
+ * 	T * y: 			the array of points' Y values, in the precision of the point store
+ * 	struct gridIndex * g:	the index of all points
+ *	M &model:			the model
+ *	int * clusterID:	0 for core points and -1 for the others (-2 for the points no cluster may reach)
+ *	int * seeds:		the points to start clusters from, in ascending order (NULL: all points)
+ *	int nSeeds:			the number of seeds, or of all points
  *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
- *	bool nonCorePoints:	whether a cluster include non-core points
+ *	struct expandWorkspace * ws:	the workspace of the expansion, whose compStart, compKey and order are written
+ *	template NONCORE:	whether a cluster include non-core points
  * RETURN:
- * 	TYPE:	double 
- * 	VALUE:	the maximum log likelihood of any clusters
+ * 	TYPE:	int
+ * 	VALUE:	the number of components
  */
-double berMaximumLL(double * x, double * y, int * ind, int * index, int nBlockX, int nBlockY, double radius, double xMin, double yMin, int countCas, int countCon, int * casC, int * conC, double p, double significance, int minCore, bool nonCorePoints)
+template <bool NONCORE, typename T, typename M>
+static int boundComponents(T * x, T * y, struct gridIndex * g, M &model, int * clusterID, int * seeds, int nSeeds, int minCore, struct expandWorkspace * ws)
 {
-	int count = index[nBlockX * nBlockY];
+	int nBlockX = g->nBlockX;
+	int nBlockY = g->nBlockY;
+	allocComponents(ws, nBlockX * nBlockY);
+	if(ws->blockEpoch == UINT_MAX) {
+		for(int b = 0; b < ws->nBlocks; b++) {
+			ws->blockMark[b] = 0;
+			ws->haloMark[b] = 0;
+		}
+		ws->blockEpoch = 0;
+	}
+	ws->blockEpoch ++;
+	unsigned int epoch = ws->blockEpoch;
+
+	int * parent = ws->parent;
+	int * found = ws->pointsToDo;	//the seeds in their own order, before the expansion needs it
+	int nCoreBlocks = 0;
+	int nFound = 0;
+	int i, b;
+	for(int k = 0; k < nSeeds; k++)
+	{
+		i = (seeds == NULL) ? k : seeds[k];
+		if(clusterID[i] != 0 || !expands(model, i))
+			continue;
+		b = centerBlock(g, x, y, i);
+		if(ws->blockMark[b] != epoch) {
+			ws->blockMark[b] = epoch;
+			ws->blockSlot[b] = nCoreBlocks;
+			ws->coreBlocks[nCoreBlocks] = b;
+			parent[nCoreBlocks] = nCoreBlocks;
+			nCoreBlocks ++;
+		}
+		found[nFound] = i;
+		ws->seedComp[nFound] = ws->blockSlot[b];
+		nFound ++;
+	}
 
-	double resultLL = 1;
+	//the root of a tree is its first block
+	int reach = 0;
+	for(int s = 0; s < g->nStencil; s++) {
+		reach = (abs(g->stencilCol[s]) > reach) ? abs(g->stencilCol[s]) : reach;
+		reach = (abs(g->stencilRow[s]) > reach) ? abs(g->stencilRow[s]) : reach;
+	}
+	reach *= 2;
+	int col, row, nb, ra, rb;
+	for(int a = 0; a < nCoreBlocks; a++)
+	{
+		col = ws->coreBlocks[a] % nBlockX;
+		row = ws->coreBlocks[a] / nBlockX;
+		for(int r = (row - reach < 0 ? 0 : row - reach); r <= row + reach && r < nBlockY; r++)
+		{
+			for(int q = (col - reach < 0 ? 0 : col - reach); q <= col + reach && q < nBlockX; q++)
+			{
+				nb = r * nBlockX + q;
+				if(ws->blockMark[nb] != epoch)
+					continue;
+				ra = findRoot(parent, a);
+				rb = findRoot(parent, ws->blockSlot[nb]);
+				if(ra < rb)
+					parent[rb] = ra;
+				else if(rb < ra)
+					parent[ra] = rb;
+			}
+		}
+	}
 
-	int * clusterID;
-	if(NULL == (clusterID = (int *)malloc(sizeof(int) * count)))
+	//the components are numbered by their first block, compRank holding the component of each block for now
+	int nComp = 0;
+	int * compOf = ws->compRank;
+	for(int a = 0; a < nCoreBlocks; a++)
 	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
+		ra = findRoot(parent, a);
+		compOf[a] = (ra == a) ? nComp ++ : compOf[ra];
 	}
 
-	for(int i = 0; i < count; i++)
+	long long * tally = ws->compTally;
+	for(int c = 0; c < 3 * nComp; c++)
+		tally[c] = 0;
+	int n0, n1, c;
+	for(int k = 0; k < nFound; k++)
 	{
-		if(BinomialTest(casC[i], conC[i], p) < significance)
-			clusterID[i] = 0;
-		else
-			clusterID[i] = -1;
-//		printf("%d,%d,%d\n", casC[i], conC[i], clusterID[i]);
+		ws->seedComp[k] = compOf[ws->seedComp[k]];
+		boundCopies(model, found[k], n0, n1);
+		tally[3 * ws->seedComp[k]] += n1;
+	}
+	//a block in the stencil of the seeds of one component is beyond two stencil reaches of the seeds of any other
+	for(int a = 0; a < nCoreBlocks; a++)
+	{
+		c = compOf[a];
+		col = ws->coreBlocks[a] % nBlockX;
+		row = ws->coreBlocks[a] / nBlockX;
+		for(int s = 0; s < g->nStencil; s++)
+		{
+			if(-1 == (nb = stencilBlock(g, col, row, s)) || ws->haloMark[nb] == epoch)
+				continue;
+			ws->haloMark[nb] = epoch;
+			for(int j = g->start[nb]; j < g->end[nb]; j++)
+			{
+				if(clusterID[j] != 0 && (!NONCORE || clusterID[j] != -1))
+					continue;
+				boundCopies(model, j, n0, n1);
+				tally[3 * c + 1] += n0;
+				tally[3 * c + 2] += n1;
+			}
+		}
 	}
 
-	int * pointsToDo;
-	if(NULL == (pointsToDo = (int *)malloc(sizeof(int) * count)))
+	for(c = 0; c < nComp; c++)
 	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
+		ws->compKey[c].bound = boundLL(model, minCore, tally[3 * c], tally[3 * c + 1], tally[3 * c + 2]);
+		ws->compKey[c].comp = c;
 	}
+	qsort(ws->compKey, nComp, sizeof(struct componentKey), compareComponentKey);
+	for(int r = 0; r < nComp; r++)
+		ws->compRank[ws->compKey[r].comp] = r;
+
+	//the seeds are grouped by the rank of their component, keeping their order
+	for(int r = 0; r <= nComp; r++)
+		ws->compStart[r] = 0;
+	for(int k = 0; k < nFound; k++)
+		ws->compStart[ws->compRank[ws->seedComp[k]] + 1] ++;
+	for(int r = 0; r < nComp; r++)
+		ws->compStart[r + 1] += ws->compStart[r];
+	int * next = parent;	//the forest is not needed any more
+	for(int r = 0; r < nComp; r++)
+		next[r] = ws->compStart[r];
+	for(int k = 0; k < nFound; k++)
+	{
+		c = ws->compRank[ws->seedComp[k]];
+		ws->order[next[c]] = found[k];
+		next[c] ++;
+	}
+	return nComp;
+}
+
+/**
+ * NAME:	expandClusters
+ * DESCRIPTION:	expand the clusters of a model from its core points. NONCORE and MAXLL are fixed at compile time, so the inner loop has no branch on them
+ * PARAMETERS:
+ * 	T * x: 			the array of points' X values, in the precision of the point store
+ * 	T * y: 			the array of points' Y values, in the precision of the point store
+ * 	struct gridIndex * g:	the index of all points
+ *	D dist2:			the squared search radius in the precision of the point store
+ *	M &model:			the model
+ *	int * clusterID:	0 for core points and -1 for the others (-2 for the points no cluster may reach), overwritten with cluster IDs
+ *	int * seeds:		the points to start clusters from, in ascending order (NULL: all points)
+ *	int nSeeds:			the number of seeds
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	struct expandWorkspace * ws:	the workspace of the expansion
+ *	struct clusterInfo ** pCInfo: the resulting output clusterInfo, unless MAXLL (NULL: none)
+ *	double settleLL:	if MAXLL, the expansion stops as soon as the maximum reaches it (HUGE_VAL: never, -HUGE_VAL: before any cluster)
+ *	template NONCORE:	whether a cluster include non-core points
+ *	template MAXLL:		whether only the maximum log likelihood is wanted
+ * RETURN:
+ * 	TYPE:	double
+ * 	VALUE:	the maximum log likelihood of any clusters if MAXLL, or the first one reaching settleLL
+ */
+template <bool NONCORE, bool MAXLL, typename T, typename D, typename M>
+static double expandClusters(T * x, T * y, struct gridIndex * g, D dist2, M &model, int * clusterID, int * seeds, int nSeeds, int minCore, struct expandWorkspace * ws, struct clusterInfo ** pCInfo, double settleLL)
+{
+	int count = g->count;
+	double resultLL = noClusterLL(model);
+	double LL;
+	bool settled = MAXLL && settleLL == -HUGE_VAL;
+
+	int * pointsToDo = ws->pointsToDo;
 	int nPToDo = 0;
 	int cID = 0;
 
-	int * inCluster;
+	//a cluster dropped for too few core points gives its ID, and so its epoch, to the next one
+	unsigned int * mark = ws->mark;
+	unsigned int base = startEpochs(ws);
+	unsigned int epoch = base;
+	int * members = ws->members;
+	int nMembers;
 
-	if(NULL == (inCluster = (int *)malloc(sizeof(int) * count))) {
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
-	}
+	T cX, cY;
+	int blockID, colID, rowID;
 
-	for(int i = 0; i < count; i++) {
-		inCluster[i] = -1;
+	int iNb;
+	int nbID;
+	int nbRel;
+	int rStart, rEnd;
+	struct blockWalk walk;
+
+	struct clusterInfo * curInfo = NULL;
+
+	//a maximum log likelihood search takes the seeds component by component, from the highest bound down
+	bool bounded = MAXLL && !settled && bounds(model);
+	int nComp = 1;
+	int whole[2] = {0, (seeds == NULL) ? count : nSeeds};
+	int * compStart = whole;
+	int * order = seeds;
+	if(bounded) {
+		nComp = boundComponents<NONCORE>(x, y, g, model, clusterID, seeds, whole[1], minCore, ws);
+		compStart = ws->compStart;
+		order = ws->order;
 	}
 
-	double dist2 = radius * radius;
-
-	double cX, cY;
-	int colID, rowID;
-	int colMin, colMax, rowMin, rowMax;
-
-	int iNb;
+	int i;
+	for(int c = 0; c < nComp && !settled; c++)
+	{
+		//no cluster of this component or the ones after it can be above the maximum
+		if(bounded && (ws->compKey[c].bound == -HUGE_VAL || !higherLL(model, ws->compKey[c].bound, resultLL)))
+			break;
+		for(int k = compStart[c]; k < compStart[c + 1] && !settled; k++)
+		{
+			i = (order == NULL) ? k : order[k];
+			if(clusterID[i] != 0 || !expands(model, i))
+				continue;
+			pointsToDo[0] = i;
+			nPToDo = 1;
+			cID ++;
+			clusterID[i] = cID;
+			members[0] = i;
+			nMembers = 1;
+			startCluster(model, i);
+
+			if(marksReached(model)) {
+				epoch = base + cID;
+				ws->epoch = epoch;
+				mark[i] = epoch;
+			}
 
-	int coreCount;
+			while(nPToDo > 0) {
+				nPToDo --;
+				cX = x[pointsToDo[nPToDo]];
+				cY = y[pointsToDo[nPToDo]];
 
-	int nCasInCluster;
-	int nConInCluster;
+				blockID = centerBlock(g, x, y, pointsToDo[nPToDo]);
+				colID = blockID % g->nBlockX;
+				rowID = blockID / g->nBlockX;
 
-	for(int i = 0; i < count; i++)
-	{
-		if(clusterID[i] != 0 || ind[i] == 0)
-			continue;
-		pointsToDo[0] = i;
-		nPToDo = 1;
-		cID ++;
-		clusterID[i] = cID;
-		
-		coreCount = 1;
-
-		inCluster[i] = cID;
-		nCasInCluster = 1;
-		nConInCluster = 0;
-
-		while(nPToDo > 0) {
-			nPToDo --;
-			cX = x[pointsToDo[nPToDo]];		
-			cY = y[pointsToDo[nPToDo]];
-
-			colID = (int)((cX - xMin) / radius);
-			rowID = (int)((cY - yMin) / radius);
-
-			colMin = (colID == 0) ? 0 : (colID - 1);
-			colMax = (colID == nBlockX - 1) ? (nBlockX - 1) : (colID + 1);
-			rowMin = (rowID == 0) ? 0 : (rowID - 1);
-			rowMax = (rowID == nBlockY - 1) ? (nBlockY - 1) : (rowID + 1);
-
-			for(int row = rowMin; row <= rowMax; row ++)
-			{
-				for(iNb = index[row * nBlockX + colMin]; iNb < index[row * nBlockX + colMax + 1]; iNb ++)
+				for(int s = 0; s < g->nStencil; s ++)
 				{
-					if(inCluster[iNb] != cID) {
-						if(dist2 >= ((x[iNb] - cX) * (x[iNb] - cX) + (y[iNb] - cY) * (y[iNb] - cY))) {
-							if(clusterID[iNb] == 0) {
-								clusterID[iNb] = cID;
+					if(-1 == (nbID = stencilBlock(g, colID, rowID, s)))
+						continue;
+					startWalk(g, s, nbID, BLOCK_UNKNOWN, &walk);
+					while(nextRange(g, &walk, cX, cY, dist2, &rStart, &rEnd, &nbRel))
+					{
+						for(iNb = rStart; iNb < rEnd; iNb ++)
+						{
+							//only unclaimed core points, and non-core points if kept, can join
+							if(clusterID[iNb] != 0 && (!NONCORE || clusterID[iNb] != -1))
+								continue;
+							if(marksReached(model) && mark[iNb] == epoch)
+								continue;
+							if(nbRel != BLOCK_IN && !inDistance(cX, cY, x[iNb], y[iNb], dist2))
+								continue;
 
-								if(ind[iNb] == 0) {
-									nConInCluster ++;
-								}
-								else {
+							if(clusterID[iNb] == 0) {
+								if(joinCore(model, iNb)) {
 									pointsToDo[nPToDo] = iNb;
 									nPToDo ++;
-									nCasInCluster ++;
-									coreCount ++;
 								}
 							}
-							else if(clusterID[iNb] == -1 && nonCorePoints) {
-								clusterID[iNb] = cID;
-								if(ind[iNb] == 0) {
-									nConInCluster ++;
-								}
-								else {
-									nCasInCluster ++;
-								}
+							else {
+								joinNonCore(model, iNb);
 							}
+							clusterID[iNb] = cID;
+							members[nMembers] = iNb;
+							nMembers ++;
 
-							inCluster[iNb] = cID;
-							
+							if(marksReached(model))
+								mark[iNb] = epoch;
 						}
 					}
 				}
 			}
-		}
 
-		if(coreCount <= minCore)
-		{
-			for(int j = 0; j < (count); j++)
+			if(coreCount(model) <= minCore)
 			{
-				if(clusterID[j] == cID)
-					clusterID[j] = -1;
-			}
-			cID --;
-		}
-		else {
-			double countInCl = nCasInCluster + nConInCluster;
-			double LL = 0;
-			if(nCasInCluster > 0) {
-				LL += nCasInCluster * log(nCasInCluster/countInCl);
-			}
-			if(nConInCluster > 0) {
-				LL += nConInCluster * log(nConInCluster/countInCl);
-			}
-			if(countCas > nCasInCluster) {
-				LL += (countCas - nCasInCluster) * log((countCas - nCasInCluster)/(count-countInCl));
+				for(int j = 0; j < nMembers; j++)
+				{
+					clusterID[members[j]] = -1;
+				}
+				cID --;
+				continue;
 			}
-			if(countCon > nConInCluster) {
-				LL += (countCon - nConInCluster) * log((countCon - nConInCluster)/(count-countInCl));
+
+			LL = clusterLL(model);
+			if(MAXLL) {
+				if(higherLL(model, LL, resultLL)) {
+					resultLL = LL;
+					settled = resultLL >= settleLL;
+				}
 			}
-			if(resultLL > 0 || resultLL < LL) {
-				resultLL = LL;
+			else if(pCInfo != NULL) {
+				if(curInfo == NULL) {
+					*pCInfo = newClusterInfo(ws);
+					curInfo = *pCInfo;
+				}
+				else {
+					curInfo->next = newClusterInfo(ws);
+					curInfo = curInfo->next;
+				}
+				curInfo->clusterID = cID;
+				fillInfo(model, curInfo);
+				curInfo->ll = LL;
+				curInfo->next = NULL;
 			}
 		}
 	}
 
-	free(pointsToDo);
-	free(inCluster);
+	return resultLL;
+}
+
+/**
+ * NAME:	expandStore
+ * DESCRIPTION:	expand the clusters of a model in the precision of the point store
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points
+ * 	struct gridIndex * g:	the index of all points
+ *	double radius:		the search radius the index was built for, with blocks of side radius / subdivide
+ *	M &model:			the model
+ *	int * clusterID:	0 for core points and -1 for the others, overwritten with cluster IDs
+ *	int * seeds:		the points to start clusters from, in ascending order (NULL: all points)
+ *	int nSeeds:			the number of seeds
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ *	struct expandWorkspace * ws:	the workspace of the expansion (NULL: one is allocated for the call)
+ *	struct clusterInfo ** pCInfo: the resulting output clusterInfo, unless MAXLL (NULL: none)
+ *	double settleLL:	if MAXLL, the expansion stops as soon as the maximum reaches it (HUGE_VAL: never)
+ *	template MAXLL:		whether only the maximum log likelihood is wanted
+ * RETURN:
+ * 	TYPE:	double
+ * 	VALUE:	the maximum log likelihood of any clusters if MAXLL, or the first one reaching settleLL
+ */
+template <bool MAXLL, typename M>
+static double expandStore(struct pointStore * ps, struct gridIndex * g, double radius, M &model, int * clusterID, int * seeds, int nSeeds, int minCore, bool nonCorePoints, struct expandWorkspace * ws, struct clusterInfo ** pCInfo, double settleLL)
+{
+	struct expandWorkspace * own = NULL;
+	if(ws == NULL)
+		ws = own = allocExpandWorkspace(g->count);
+
+	double resultLL;
+	if(ps->precision == PRECISION_FLOAT) {
+		if(nonCorePoints)
+			resultLL = expandClusters<true, MAXLL>(ps->xf, ps->yf, g, floatDist2(radius), model, clusterID, seeds, nSeeds, minCore, ws, pCInfo, settleLL);
+		else
+			resultLL = expandClusters<false, MAXLL>(ps->xf, ps->yf, g, floatDist2(radius), model, clusterID, seeds, nSeeds, minCore, ws, pCInfo, settleLL);
+	}
+	else if(ps->precision == PRECISION_INT) {
+		if(nonCorePoints)
+			resultLL = expandClusters<true, MAXLL>(ps->xq, ps->yq, g, quantDist2(ps, radius), model, clusterID, seeds, nSeeds, minCore, ws, pCInfo, settleLL);
+		else
+			resultLL = expandClusters<false, MAXLL>(ps->xq, ps->yq, g, quantDist2(ps, radius), model, clusterID, seeds, nSeeds, minCore, ws, pCInfo, settleLL);
+	}
+	else {
+		if(nonCorePoints)
+			resultLL = expandClusters<true, MAXLL>(ps->x, ps->y, g, radius * radius, model, clusterID, seeds, nSeeds, minCore, ws, pCInfo, settleLL);
+		else
+			resultLL = expandClusters<false, MAXLL>(ps->x, ps->y, g, radius * radius, model, clusterID, seeds, nSeeds, minCore, ws, pCInfo, settleLL);
+	}
+
+	if(own != NULL)
+		freeExpandWorkspace(own);
+	return resultLL;
+}
+
+/**
+ * NAME:	doClusterPoi
+ * DESCRIPTION:	cluster all event points based on a Possion Test, in the precision of the point store
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points
+ * 	unsigned long long * label:	points' type labels (1: events, 0: background)
+ * 	struct gridIndex * g:	the index of all points
+ *	double radius:		the search radius the index was built for, with blocks of side radius / subdivide
+ *	int countB:			the number of background points
+ *	int countE:			the number of event points
+ *	struct neighborCounts * nc:	the number of background (c0) and event (c1) points (within radius) near each point
+ *	double baseLineRatio:	the ratio of the null hypothesis to the baseline
+ *	double significance: 	the significane level to tell a cluste core point
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ *	struct clusterInfo ** pCInfo: the resulting output clusterInfo
+ * RETURN:
+ * 	TYPE:	int *
+ * 	VALUE:	the cluster ID of each point
+ */
+int * doClusterPoi(struct pointStore * ps, unsigned long long * label, struct gridIndex * g, double radius, int countB, int countE, struct neighborCounts * nc, double baseLineRatio, double significance, int minCore, bool nonCorePoints, struct clusterInfo ** pCInfo)
+{
+	struct poiModel<false> model = {label, ps->weight, NULL, countB, countE, nc, baseLineRatio, significance};
+	int * clusterID = coreIDs(model, g->count);
+	expandStore<false>(ps, g, radius, model, clusterID, NULL, 0, minCore, nonCorePoints, NULL, pCInfo, HUGE_VAL);
+	return clusterID;
+}
+
+/**
+ * NAME:	doClusterBer
+ * DESCRIPTION:	cluster all case points based on a Binomial Test, in the precision of the point store
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points
+ * 	unsigned long long * label:	points' type labels (1: case, 0: control)
+ * 	struct gridIndex * g:	the index of all points
+ *	double radius:		the search radius the index was built for, with blocks of side radius / subdivide
+ *	int countCas:		the number of case points
+ *	int countCon:		the number of control points
+ *	struct neighborCounts * nc:	the number of control (c0) and case (c1) points (within radius) near each point
+ *	double p:			the p of Binomial distribution
+ *	double significance: 	the significane level to tell a cluste core point
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ *	struct clusterInfo ** pCInfo: the resulting output clusterInfo
+ * RETURN:
+ * 	TYPE:	int *
+ * 	VALUE:	the cluster ID of each point
+ */
+int * doClusterBer(struct pointStore * ps, unsigned long long * label, struct gridIndex * g, double radius, int countCas, int countCon, struct neighborCounts * nc, double p, double significance, int minCore, bool nonCorePoints, struct clusterInfo ** pCInfo)
+{
+	struct berModel model = {label, ps->weight, NULL, countCas, countCon, nc, p, significance};
+	int * clusterID = coreIDs(model, g->count);
+	expandStore<false>(ps, g, radius, model, clusterID, NULL, 0, minCore, nonCorePoints, NULL, pCInfo, HUGE_VAL);
+	return clusterID;
+}
+
+/**
+ * NAME:	doClusterDBSCAN
+ * DESCRIPTION:	cluster all event points using DBSCAN algorithm, in the precision of the point store
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all events
+ * 	struct gridIndex * g:	the index of all events
+ *	double radius:		the search radius the index was built for, with blocks of side radius / subdivide
+ *	int minPts:		the minimum points to form a core points
+ *	struct neighborCounts * nc:	the number of event points (within radius) near each event points (c0)
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ * RETURN:
+ * 	TYPE:	int *
+ * 	VALUE:	the cluster ID of each point
+ */
+int * doClusterDBSCAN(struct pointStore * ps, struct gridIndex * g, double radius, int minPts, struct neighborCounts * nc, int minCore, bool nonCorePoints)
+{
+	struct dbscanModel model = {nc, minPts};
+	int * clusterID = coreIDs(model, g->count);
+	expandStore<false>(ps, g, radius, model, clusterID, NULL, 0, minCore, nonCorePoints, NULL, NULL, HUGE_VAL);
+	return clusterID;
+}
+
+/**
+ * NAME:	berMaximumLL
+ * DESCRIPTION:	find the maximum log likelihood of any cluster in a Bernoulli model, in the precision of the point store
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points
+ * 	unsigned long long * label:	points' type labels (1: case, 0: control)
+ * 	struct gridIndex * g:	the index of all points
+ *	double radius:		the search radius the index was built for, with blocks of side radius / subdivide
+ *	int countCas:		the number of case points
+ *	int countCon:		the number of control points
+ *	struct neighborCounts * nc:	the number of control (c0) and case (c1) points (within radius) near each point
+ *	double p:			the p of Binomial distribution
+ *	double significance: 	the significane level to tell a cluste core point
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ * RETURN:
+ * 	TYPE:	double
+ * 	VALUE:	the maximum log likelihood of any clusters
+ */
+double berMaximumLL(struct pointStore * ps, unsigned long long * label, struct gridIndex * g, double radius, int countCas, int countCon, struct neighborCounts * nc, double p, double significance, int minCore, bool nonCorePoints)
+{
+	struct berModel model = {label, ps->weight, NULL, countCas, countCon, nc, p, significance};
+	int * clusterID = coreIDs(model, g->count);
+	double resultLL = expandStore<true>(ps, g, radius, model, clusterID, NULL, 0, minCore, nonCorePoints, NULL, NULL, HUGE_VAL);
 	free(clusterID);
+	return resultLL;
+}
 
-	return resultLL; 
+/**
+ * NAME:	berMaximumLL_Cores
+ * DESCRIPTION:	find the maximum log likelihood of any cluster in a Bernoulli model, given which points are core points, in the precision of the point store
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points
+ * 	unsigned long long * label:	points' type labels (1: case, 0: control)
+ * 	int * weight1:		the number of cases at each location of a weighted store (NULL: all points at a location are of its label's type)
+ * 	struct gridIndex * g:	the index of all points
+ *	double radius:		the search radius the index was built for, with blocks of side radius / subdivide
+ *	int countCas:		the number of case points
+ *	int countCon:		the number of control points
+ *	int * clusterID:	0 for core points and -1 for the others, overwritten with cluster IDs
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ *	struct expandWorkspace * ws:	the workspace of the expansion, kept over the replications of a simulation (NULL: one is allocated for the call)
+ *	double settleLL:	the expansion stops as soon as the maximum reaches it, as a replication is settled once its maximum is not below any detected cluster (HUGE_VAL: never)
+ * RETURN:
+ * 	TYPE:	double
+ * 	VALUE:	the maximum log likelihood of any clusters, or the first one reaching settleLL
+ */
+double berMaximumLL_Cores(struct pointStore * ps, unsigned long long * label, int * weight1, struct gridIndex * g, double radius, int countCas, int countCon, int * clusterID, int minCore, bool nonCorePoints, struct expandWorkspace * ws, double settleLL)
+{
+	struct berModel model = {label, ps->weight, weight1, countCas, countCon, NULL, 0, 0};
+	return expandStore<true>(ps, g, radius, model, clusterID, NULL, 0, minCore, nonCorePoints, ws, NULL, settleLL);
 }
 
 /**
  * NAME:	poiMaximumLL
- * DESCRIPTION:	find the maximum log likelihood of any cluster in a Possion Model
+ * DESCRIPTION:	find the maximum log likelihood of any cluster in a Possion Model, in the precision of the point store
  * PARAMETERS:
- * 	double * x: 		the array of points' X values
- * 	double * y: 		the array of points' Y values
- * 	int * ind:			the array of points' type indicator (1: events, 0: background)
- * 	int * index:		the index of all event points
- * 	int nBlockX:		the number of index blocks along X dimension
- * 	int nBlockY:		the number of index blocks along Y dimension
- *	double radius:		the search radius, which is also the block size
- *	double xMin:		the minimum X of all points
- *	double yMin:		the minimum Y of all points
+ * 	struct pointStore * ps:	the store of all points
+ * 	unsigned long long * label:	points' type labels (1: events, 0: background)
+ * 	struct gridIndex * g:	the index of all points
+ *	double radius:		the search radius the index was built for, with blocks of side radius / subdivide
  *	int countB:			the number of background points
  *	int countE:			the number of event points
- *	int * eC:			the number of event (1) points (within radius) near each point
- *	double * lambda:	the local lambda of Possion distribution of each event points
+ *	struct neighborCounts * nc:	the number of background (c0) and event (c1) points (within radius) near each point
+ *	double baseLineRatio:	the ratio of the null hypothesis to the baseline
  *	double significance: 	the significane level to tell a cluste core point
  *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
  *	bool nonCorePoints:	whether a cluster include non-core points
  * RETURN:
- * 	TYPE:	double 
+ * 	TYPE:	double
  * 	VALUE:	the maximum log likelihood of any clusters
  */
-double poiMaximumLL(double * x, double * y, int * ind, int * index, int nBlockX, int nBlockY, double radius, double xMin, double yMin, int countB, int countE, int * eC, double * lambda, double significance, int minCore, bool nonCorePoints)
+double poiMaximumLL(struct pointStore * ps, unsigned long long * label, struct gridIndex * g, double radius, int countB, int countE, struct neighborCounts * nc, double baseLineRatio, double significance, int minCore, bool nonCorePoints)
 {
-	double resultLL = -1;
+	struct poiModel<true> model = {label, ps->weight, NULL, countB, countE, nc, baseLineRatio, significance};
+	int * clusterID = coreIDs(model, g->count);
+	double resultLL = poiMaximumLL_Cores(ps, label, NULL, g, radius, countB, countE, clusterID, minCore, nonCorePoints, NULL, HUGE_VAL);
+	free(clusterID);
+	return resultLL;
+}
 
-	int * clusterID;
-	if(NULL == (clusterID = (int *)malloc(sizeof(int) * countB)))
-	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
-	}
-	
-	for(int i = 0; i < countB; i++)
-	{
-		if(PossionTest(eC[i], lambda[i]) < significance) {
-			clusterID[i] = 0;
-		}
-		else {
-			clusterID[i] = -1;
-		}
-	}
+/**
+ * NAME:	poiMaximumLL_Cores
+ * DESCRIPTION:	find the maximum log likelihood of any cluster in a Possion Model, given which points are core points, in the precision of the point store
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points
+ * 	unsigned long long * label:	points' type labels (1: events, 0: background)
+ * 	int * weight1:		the number of events at each location of a weighted store (NULL: all points at a location are of its label's type)
+ * 	struct gridIndex * g:	the index of all points
+ *	double radius:		the search radius the index was built for, with blocks of side radius / subdivide
+ *	int countB:			the number of background points
+ *	int countE:			the number of event points
+ *	int * clusterID:	0 for core points and -1 for the others, overwritten with cluster IDs
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ *	struct expandWorkspace * ws:	the workspace of the expansion, kept over the replications of a simulation (NULL: one is allocated for the call)
+ *	double settleLL:	the expansion stops as soon as the maximum reaches it, as a replication is settled once its maximum is not below any detected cluster (HUGE_VAL: never)
+ * RETURN:
+ * 	TYPE:	double
+ * 	VALUE:	the maximum log likelihood of any clusters, or the first one reaching settleLL
+ */
+double poiMaximumLL_Cores(struct pointStore * ps, unsigned long long * label, int * weight1, struct gridIndex * g, double radius, int countB, int countE, int * clusterID, int minCore, bool nonCorePoints, struct expandWorkspace * ws, double settleLL)
+{
+	return poiMaximumLL_Events(ps, label, weight1, g, radius, countB, countE, clusterID, NULL, 0, minCore, nonCorePoints, ws, settleLL);
+}
+
+/**
+ * NAME:	poiMaximumLL_Events
+ * DESCRIPTION:	find the maximum log likelihood of any cluster in a Possion Model, given which points are core points, starting clusters from the listed events only. only the points within the search radius of a core seed are visited, so the work follows the events rather than all points. minCore is not applied to the replications
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points
+ * 	unsigned long long * label:	points' type labels (1: a location with events, 0: a location without)
+ * 	int * weight1:		the number of events at each location (NULL: all points at a location are events if it is labeled 1)
+ * 	struct gridIndex * g:	the index of all points
+ *	double radius:		the search radius the index was built for, with blocks of side radius / subdivide
+ *	int countB:			the number of background points
+ *	int countE:			the number of event points
+ *	int * clusterID:	0 for core points and -1 for the others, used as the workspace of cluster IDs; only needed for the points within the search radius of an event
+ *	int * seeds:		the locations with events in ascending order (NULL: all points)
+ *	int nSeeds:			the number of seeds
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ *	struct expandWorkspace * ws:	the workspace of the expansion over all points, kept over the replications of a simulation (NULL: one is allocated for the call)
+ *	double settleLL:	the expansion stops as soon as the maximum reaches it, as a replication is settled once its maximum is not below any detected cluster (HUGE_VAL: never)
+ * RETURN:
+ * 	TYPE:	double
+ * 	VALUE:	the maximum log likelihood of any clusters, or the first one reaching settleLL
+ */
+double poiMaximumLL_Events(struct pointStore * ps, unsigned long long * label, int * weight1, struct gridIndex * g, double radius, int countB, int countE, int * clusterID, int * seeds, int nSeeds, int minCore, bool nonCorePoints, struct expandWorkspace * ws, double settleLL)
+{
+	struct poiModel<true> model = {label, ps->weight, weight1, countB, countE, NULL, 0, 0};
+	return expandStore<true>(ps, g, radius, model, clusterID, seeds, nSeeds, -1, nonCorePoints, ws, NULL, settleLL);
+}
 
-	int * pointsToDo;
-	if(NULL == (pointsToDo = (int *)malloc(sizeof(int) * countB)))
+/**
+ * NAME:	doClusterPoiRaster
+ * DESCRIPTION:	cluster all event points based on a Possion Test against a background raster, in the precision of the point store
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of the events
+ * 	struct gridIndex * g:	the index of the events
+ *	struct rasterGrid * ra:	the background raster
+ *	double radius:		the search radius the index was built for, with blocks of side radius / subdivide
+ *	int countE:			the number of event points
+ *	struct neighborCounts * nc:	the number of events (c0, within radius) near each event
+ *	double baseLineRatio:	the ratio of the null hypothesis to the baseline
+ *	double significance: 	the significane level to tell a cluste core point
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ *	struct clusterInfo ** pCInfo: the resulting output clusterInfo
+ *	struct expandWorkspace * ws:	the workspace of the expansion, kept over the replications of a simulation (NULL: one is allocated for the call)
+ * RETURN:
+ * 	TYPE:	int *
+ * 	VALUE:	the cluster ID of each point
+ */
+int * doClusterPoiRaster(struct pointStore * ps, struct gridIndex * g, struct rasterGrid * ra, double radius, int countE, struct neighborCounts * nc, double baseLineRatio, double significance, int minCore, bool nonCorePoints, struct clusterInfo ** pCInfo, struct expandWorkspace * ws)
+{
+	struct rasterModel model = {ps, ra, radius, countE, nc, baseLineRatio, significance};
+	if(NULL == (model.cores = (int *)malloc(sizeof(int) * g->count)))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	int nPToDo = 0;
-	int cID = 0;
+	int * clusterID = coreIDs(model, g->count);
+	expandStore<false>(ps, g, radius, model, clusterID, NULL, 0, minCore, nonCorePoints, ws, pCInfo, HUGE_VAL);
+	free(model.cores);
+	return clusterID;
+}
 
-	int * inCluster;
+/**
+ * NAME:	binomialCoreThreshold
+ * DESCRIPTION:	find the smallest number of cases among n points within the search radius that makes a point a core point under the Binomial Test. the tail probability is accumulated term by term in the same order as BinomialTest, so the threshold gives exactly the same decisions
+ * PARAMETERS:
+ * 	int n:		the number of (case and control) points within the search radius
+ * 	double p:	the p of Binomial distribution
+ *	double significance: 	the significane level to tell a cluste core point
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the smallest number of cases to be a core point, or n + 1 if no number is enough
+ */
+int binomialCoreThreshold(int n, double p, double significance)
+{
+	double q = 1 - p;
+	double logElement = n * log(q);
+	double sum = exp(logElement);
 
-	if(NULL == (inCluster = (int *)malloc(sizeof(int) * countB))) {
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
-	}
-	
-	for(int i = 0; i < countB; i++) {
-		inCluster[i] = -1;
+	//BinomialTest(nCas, n - nCas, p) is 1 - sum of the terms below nCas (and at least the first term)
+	if(1 - sum < significance)
+		return 0;
+	for(int nCas = 1; nCas <= n; nCas++)
+	{
+		if(nCas >= 2)
+		{
+			int i = nCas - 1;
+			logElement = logElement + log(n+1-i) + log(p) - log(i) - log(q);
+			sum += exp(logElement);
+		}
+		if(1 - sum < significance)
+			return nCas;
 	}
+	return n + 1;
+}
 
-	double dist2 = radius * radius;
-
-	double cX, cY;
-	int colID, rowID;
-	int colMin, colMax, rowMin, rowMax;
-
-	int iNb;
-	int iNbEnd;
-
-	int coreCount;
-
-	int nEInCluster;
-	int nBInCluster;
-//	printf("ClusterID,Events,expEvents,LL\n");
+/**
+ * NAME:	poissonCoreThreshold
+ * DESCRIPTION:	find the smallest number of events within the search radius that makes a point a core point under the Possion Test. the tail probability is accumulated term by term in the same order as PossionTest, so the threshold gives exactly the same decisions
+ * PARAMETERS:
+ * 	double lambda:	the local lambda of Possion distribution of the point
+ * 	int maxCount:	the largest possible number of events within the search radius
+ *	double significance: 	the significane level to tell a cluste core point
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the smallest number of events to be a core point, or maxCount + 1 if no number up to maxCount is enough
+ */
+int poissonCoreThreshold(double lambda, int maxCount, double significance)
+{
+	double sum = 1.0;
+	double element = 1;
+	double expLambda = exp(-lambda);
 
-	for(int i = 0; i < countB; i++)
+	//PossionTest(nP, lambda) is 1 - the sum of the terms below nP (and at least the first term)
+	for(int nP = 0; nP <= maxCount; nP++)
 	{
-		if(clusterID[i] != 0 || ind[i] == 0)
-			continue;
-		pointsToDo[0] = i;
-		nPToDo = 1;
-		cID ++;
-		clusterID[i] = cID;
-		
-		coreCount = 1;
-
-		inCluster[i] = cID;
-		nEInCluster = 1;
-		nBInCluster = 0;
-
-		while(nPToDo > 0) {
-			nPToDo --;
-			cX = x[pointsToDo[nPToDo]];		
-			cY = y[pointsToDo[nPToDo]];
-
-			colID = (int)((cX - xMin) / radius);
-			rowID = (int)((cY - yMin) / radius);
-
-			colMin = (colID == 0) ? 0 : (colID - 1);
-			colMax = (colID == nBlockX - 1) ? (nBlockX - 1) : (colID + 1);
-			rowMin = (rowID == 0) ? 0 : (rowID - 1);
-			rowMax = (rowID == nBlockY - 1) ? (nBlockY - 1) : (rowID + 1);
-
-			for(int row = rowMin; row <= rowMax; row ++)
-			{
-				for(iNb = index[row * nBlockX + colMin]; iNb < index[row * nBlockX + colMax + 1]; iNb ++)
-				{
-					if(inCluster[iNb] != cID) {
-						if(dist2 >= ((x[iNb] - cX) * (x[iNb] - cX) + (y[iNb] - cY) * (y[iNb] - cY))) {
-							if(clusterID[iNb] == 0) {
-								clusterID[iNb] = cID;
-								nBInCluster ++;
-								if(ind[iNb] == 1) {
-									pointsToDo[nPToDo] = iNb;
-									nPToDo ++;
-									nEInCluster ++;
-									coreCount ++;
-								}
-							}
-
-							else if(clusterID[iNb] == -1 && nonCorePoints) {
-								clusterID[iNb] = cID;
-								nBInCluster ++;
-								if(ind[iNb] == 1) {
-									nEInCluster ++;
-								}
-							}
-
-							inCluster[iNb] = cID;
-						}
-					}
-
-				}
-			}
+		if(nP >= 2)
+		{
+			element = element * lambda / (nP - 1);
+			sum += element;
 		}
-			
-//		printf("HERE\n");
-
-//		if(coreCount <= minCore)
-//		{
-//			for(int j = 0; j < countB; j++)
-//			{
-//				if(clusterID[j] == cID)
-//					clusterID[j] = -1;
-//			}
-//			cID --;
-//		}
-//		else {
-			double expEventInCluster = (double)(nBInCluster) / countB * countE;
-			double LL = nEInCluster * log(nEInCluster/expEventInCluster);
-			if(nEInCluster < countE) {
-				LL += (countE - nEInCluster) * log((countE - nEInCluster) / (countE - expEventInCluster));
-			}
-			if(resultLL < LL) {
-				resultLL = LL;
-			}
-
-//			printf("%d,%d,%lf,%lf\n", cID, nEInCluster, expEventInCluster, LL);
-//		}
+		if(1 - sum * expLambda < significance)
+			return nP;
 	}
-
-	free(inCluster);
-	free(pointsToDo);
-	free(clusterID);
-
-	return resultLL; 
+	return maxCount + 1;
 }
-
-
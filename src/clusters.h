@@ -1,6 +1,12 @@
 #ifndef CH
 #define CH
 
+struct gridIndex;
+struct pointStore;
+struct neighborCounts;
+struct rasterGrid;
+struct componentKey;
+
 struct clusterInfo {
 	int clusterID;
 	int count0;
@@ -11,13 +17,48 @@ struct clusterInfo {
 	struct clusterInfo * next;
 };
 
+//the workspace of expanding clusters, kept over all replications of a simulation, one for each thread expanding clusters. a point has been reached from the current cluster if its mark is the current epoch, so starting a cluster takes the next epoch instead of clearing the marks of all points
+struct expandWorkspace {
+	int count;
+	unsigned int epoch;
+	unsigned int * mark;
+	int * pointsToDo;
+	int * members;		//the points of the current cluster, to drop a cluster with too few core points
+	struct clusterInfo * spare;	//cluster infos given back to be reused, see recycleClusterInfo
+	//the components of a maximum log likelihood search, see boundComponents, allocated on first use
+	int nBlocks;
+	unsigned int blockEpoch;
+	unsigned int * blockMark;	//the blocks holding seeds of the current search, and those in their stencils
+	unsigned int * haloMark;
+	int * blockSlot;	//the position of a block holding seeds in coreBlocks
+	int * coreBlocks;
+	int * parent;		//the union-find forest of the blocks holding seeds
+	int * seedComp;
+	int * order;		//the seeds grouped by component, from the highest bound down
+	int * compStart;
+	int * compRank;
+	struct componentKey * compKey;	//the components sorted by their bound
+	long long * compTally;	//the core copies, type 0 and type 1 copies of each component
+};
+
+//Workspace
+struct expandWorkspace * allocExpandWorkspace(int count);
+void recycleClusterInfo(struct expandWorkspace * ws, struct clusterInfo * cInfo);
+void freeExpandWorkspace(struct expandWorkspace * ws);
 //Poisson
-int * doClusterPoi(double * x, double * y, int * ind, int * index, int nBlockX, int nBlockY, double radius, double xMin, double yMin, int countB, int countE, int * eC, double * lambda, double significance, int minCore, bool nonCorePoints, struct clusterInfo ** pCInfo);
-double poiMaximumLL(double * x, double * y, int * ind, int * index, int nBlockX, int nBlockY, double radius, double xMin, double yMin, int countB, int countE, int * eC, double * lambda, double significance, int minCore, bool nonCorePoints);
+double PossionTest(int nP, double lambda);
+int * doClusterPoi(struct pointStore * ps, unsigned long long * label, struct gridIndex * g, double radius, int countB, int countE, struct neighborCounts * nc, double baseLineRatio, double significance, int minCore, bool nonCorePoints, struct clusterInfo ** pCInfo);
+double poiMaximumLL(struct pointStore * ps, unsigned long long * label, struct gridIndex * g, double radius, int countB, int countE, struct neighborCounts * nc, double baseLineRatio, double significance, int minCore, bool nonCorePoints);
+double poiMaximumLL_Cores(struct pointStore * ps, unsigned long long * label, int * weight1, struct gridIndex * g, double radius, int countB, int countE, int * clusterID, int minCore, bool nonCorePoints, struct expandWorkspace * ws, double settleLL);
+double poiMaximumLL_Events(struct pointStore * ps, unsigned long long * label, int * weight1, struct gridIndex * g, double radius, int countB, int countE, int * clusterID, int * seeds, int nSeeds, int minCore, bool nonCorePoints, struct expandWorkspace * ws, double settleLL);
+int * doClusterPoiRaster(struct pointStore * ps, struct gridIndex * g, struct rasterGrid * ra, double radius, int countE, struct neighborCounts * nc, double baseLineRatio, double significance, int minCore, bool nonCorePoints, struct clusterInfo ** pCInfo, struct expandWorkspace * ws);
+int poissonCoreThreshold(double lambda, int maxCount, double significance);
 //Bernoulli
-int * doClusterBer(double * x, double * y, int * ind, int * index, int nBlockX, int nBlockY, double radius, double xMin, double yMin, int countCas, int countCon, int * casC, int * conC, double p, double significance, int minCore, bool nonCorePoints, struct clusterInfo ** pCInfo);
-double berMaximumLL(double * x, double * y, int * ind, int * index, int nBlockX, int nBlockY, double radius, double xMin, double yMin, int countCas, int countCon, int * casC, int * conC, double p, double significance, int minCore, bool nonCorePoints);
+int * doClusterBer(struct pointStore * ps, unsigned long long * label, struct gridIndex * g, double radius, int countCas, int countCon, struct neighborCounts * nc, double p, double significance, int minCore, bool nonCorePoints, struct clusterInfo ** pCInfo);
+double berMaximumLL(struct pointStore * ps, unsigned long long * label, struct gridIndex * g, double radius, int countCas, int countCon, struct neighborCounts * nc, double p, double significance, int minCore, bool nonCorePoints);
+double berMaximumLL_Cores(struct pointStore * ps, unsigned long long * label, int * weight1, struct gridIndex * g, double radius, int countCas, int countCon, int * clusterID, int minCore, bool nonCorePoints, struct expandWorkspace * ws, double settleLL);
+int binomialCoreThreshold(int n, double p, double significance);
 //DBSCAN
-int * doClusterDBSCAN(double * x, double * y, int * index, int nBlockX, int nBlockY, double radius, int minPts, double xMin, double yMin, int * eC, int minCore, bool nonCorePoints);
+int * doClusterDBSCAN(struct pointStore * ps, struct gridIndex * g, double radius, int minPts, struct neighborCounts * nc, int minCore, bool nonCorePoints);
 
 #endif
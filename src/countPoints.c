@@ -2,221 +2,934 @@
  * countPoints.c
  * Author: Ting Li <tingli3@illinois.edu>
  * Date: 08/07/2017
- */ 
+ */
 
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <omp.h>
+#include "io.h"
+#include "memory.h"
+#include "points.h"
+#include "countPoints.h"
 
 /**
- * NAME:	countInDistance
- * DESCRIPTION:	get the number of type 2 type of points within a distance of each point
+ * NAME:	countBlock
+ * DESCRIPTION:	count the pairs of points of one block for countHalfStencil: with the later points of the block and with the forward half of its stencil. a matching pair adds to both points, so the counts of other points and blocks are updated atomically
  * PARAMETERS:
- * 	double * x:			points' X values 
- * 	double * y:			points' Y values 
- * 	int * ind:			points' type indicator
- * 	int * index:		the index of type A points
- * 	int nBlockX:		the number of index blocks along X dimension
- * 	int nBlockY:		the number of index blocks along Y dimension
- * 	double distance:	the distance, which is also the size (side length) of each index block
- * 	int * count0:		the output array of the numbers of first type of points within the distance , ordered the same as x and y
- * 	int * count1:		the output array of the numbers of first type of points within the distance , ordered the same as x and y
- */
-void countInDistance(double * x, double * y, int * ind, int * index, int nBlockX, int nBlockY, double distance, int * count0, int * count1)
-{
-	double xi, yi;
-	double dist2 = distance * distance;
-	int colID, rowID;
-	int colMin, colMax, rowMin, rowMax;
-
-	for(rowID = 0; rowID < nBlockY; rowID ++)
-	{
-		for(colID = 0; colID < nBlockX; colID ++)
-		{
-			colMin = (colID == 0) ? 0 : (colID - 1);
-			colMax = (colID == nBlockX - 1) ? (nBlockX - 1) : (colID + 1);
-			rowMin = (rowID == 0) ? 0 : (rowID - 1);
-			rowMax = (rowID == nBlockY - 1) ? (nBlockY - 1) : (rowID + 1);
-			for(int i = index[rowID * nBlockX + colID]; i < index[rowID * nBlockX + colID + 1]; i++) {	
-				xi = x[i];
-				yi = y[i];
-				count0[i] = 0;
-				count1[i] = 0;
-				for(int row = rowMin; row <= rowMax; row ++)
+ * 	T * x, T * y:	points' coordinates, in the precision of the point store
+ * 	unsigned long long * label:	points' bit-packed type labels (NULL: every point is of type 1)
+ * 	int * weight:	points' weights (NULL: every point counts once)
+ * 	struct gridIndex * g:	the index of the points
+ * 	D dist2:	the squared distance in the precision of the point store
+ * 	C * count0:	the output numbers of type 0 points (NULL: not counted)
+ * 	C * count1:	the output numbers of type 1 points
+ * 	int * nType0, int * nType1:	the (weighted) number of points of each type in each block
+ * 	int * add0, int * add1:	the counts added to every point of a block by bulk counting
+ * 	int iB:	the position of the block in the order of the index
+ * RETURN: none
+ */
+template <typename T, typename D, typename C>
+static inline void countBlock(T * x, T * y, unsigned long long * label, int * weight, struct gridIndex * g, D dist2, C * count0, C * count1, int * nType0, int * nType1, int * add0, int * add1, int iB)
+{
+	int nBlockX = g->nBlockX;
+	int blockID = g->blocks[iB];
+	int colID = blockID % nBlockX;
+	int rowID = blockID / nBlockX;
+	int nbID, rel, rStart, rEnd;
+	struct blockWalk walk;
+	int nbs[MAX_STENCIL / 2 + 1];
+	int nbStencil[MAX_STENCIL / 2 + 1];
+	int nNbs = 0;
+	int n0, n1;
+	int wi, wj;
+	bool type1;
+	T xi, yi;
+	C * countI;
+
+	if(g->start[blockID] == g->end[blockID])
+		return;
+
+	//accept or reject whole pairs of blocks first
+	for(int s = g->nStencil / 2; s < g->nStencil; s ++)
+	{
+		if(-1 == (nbID = stencilBlock(g, colID, rowID, s)))
+			continue;
+		switch(stencilToBlock<T>(g, blockID, g, s, nbID, dist2))
+		{
+		case BLOCK_OUT:
+			break;
+		case BLOCK_IN:
+			#pragma omp atomic
+			add0[blockID] += nType0[nbID];
+			#pragma omp atomic
+			add1[blockID] += nType1[nbID];
+			if(nbID != blockID)
+			{
+				#pragma omp atomic
+				add0[nbID] += nType0[blockID];
+				#pragma omp atomic
+				add1[nbID] += nType1[blockID];
+			}
+			break;
+		default:
+			nbs[nNbs] = nbID;
+			nbStencil[nNbs] = s;
+			nNbs ++;
+		}
+	}
+
+	for(int i = g->start[blockID]; i < g->end[blockID] && nNbs > 0; i++)
+	{
+		xi = x[i];
+		yi = y[i];
+		type1 = (label == NULL || GET_LABEL(label, i) == 1);
+		wi = (weight == NULL) ? 1 : weight[i];
+		countI = type1 ? count1 : count0;
+		n0 = 0;
+		n1 = 0;
+		for(int k = 0; k < nNbs; k ++)
+		{
+			nbID = nbs[k];
+			if(nbID == blockID)
+			{
+				//the point itself and the later points of its block
+				if(type1)
+					n1 += wi;
+				else
+					n0 += wi;
+				rel = BLOCK_UNKNOWN;
+			}
+			else
+			{
+				rel = stencilToPoint(g, nbStencil[k], nbID, xi, yi, dist2);
+				if(rel == BLOCK_OUT)
+					continue;
+				if(rel == BLOCK_IN)
+				{
+					n0 += nType0[nbID];
+					n1 += nType1[nbID];
+					if(type1)
+					{
+						#pragma omp atomic
+						add1[nbID] += wi;
+					}
+					else
+					{
+						#pragma omp atomic
+						add0[nbID] += wi;
+					}
+					continue;
+				}
+			}
+			startWalk(g, nbStencil[k], nbID, rel, &walk);
+			while(nextRange(g, &walk, xi, yi, dist2, &rStart, &rEnd, &rel))
+			{
+				if(nbID == blockID && rStart <= i)
+					rStart = i + 1;
+				for(int j = rStart; j < rEnd; j ++)
 				{
-					for(int j = index[row * nBlockX + colMin]; j < index[row * nBlockX + colMax + 1]; j ++)
+					if(rel == BLOCK_IN || inDistance(xi, yi, x[j], y[j], dist2))
 					{
-						if(dist2 >= ((x[j] - xi) * (x[j] - xi) + (y[j] - yi) * (y[j] - yi)))
+						wj = (weight == NULL) ? 1 : weight[j];
+						if(label == NULL || GET_LABEL(label, j) == 1)
+							n1 += wj;
+						else
+							n0 += wj;
+						if(countI != NULL)
 						{
-							if(ind[j] == 0)
-							{
-								count0[i] ++;
-							}
-							else
-							{
-								count1[i] ++;
-							}
+							#pragma omp atomic
+							countI[j] += (C)wi;
 						}
-					}	
+					}
 				}
-			}	
+			}
+		}
+		if(count0 != NULL)
+		{
+			#pragma omp atomic
+			count0[i] += (C)n0;
 		}
+		#pragma omp atomic
+		count1[i] += (C)n1;
 	}
 }
 
-
 /**
- * NAME:	countInDistance_Single
- * DESCRIPTION:	get the number of type A points within a distance of each type A point
+ * NAME:	firstBlockFrom
+ * DESCRIPTION:	find the first block, in the order of the index, whose points start at or after a point. the points are stored block by block in that order
  * PARAMETERS:
- * 	double * xE:		type A points' X values 
- * 	double * yE:		type A points' Y values 
- * 	int * indexE:		the index of type A points
- * 	int nBlockX:		the number of index blocks along X dimension
- * 	int nBlockY:		the number of index blocks along Y dimension
- * 	double distance:	the distance, which is also the size (side length) of each index block
+ * 	struct gridIndex * g:	the index of the points
+ * 	long long p:	the point
  * RETURN:
- * 	TYPE:	int * 
- * 	VALUE:	an array of the numbers of points within the distance, ordered the same as xE and yE
+ * 	TYPE:	int
+ * 	VALUE:	the position of the block in the order of the index, the number of blocks if there is none
+ */
+static int firstBlockFrom(struct gridIndex * g, long long p)
+{
+	int lo = 0;
+	int hi = g->nBlockX * g->nBlockY;
+	int mid;
+	while(lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if(g->start[g->blocks[mid]] < p)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/**
+ * NAME:	countHalfStencil
+ * DESCRIPTION:	count the points of each type within a distance of each point (including itself), each point counting as many times as its weight, visiting every pair of points in neighboring blocks once and adding it to both ends: each block is paired with the later points of itself and with the forward half of its stencil. pairs of blocks whose bounding boxes are entirely within the distance are counted in bulk from the number of points of each type in the blocks, and blocks entirely beyond the distance are skipped, first for whole blocks and then for each point
+ * PARAMETERS:
+ * 	T * x, T * y:	points' coordinates, in the precision of the point store
+ * 	unsigned long long * label:	points' bit-packed type labels (NULL: every point is of type 1)
+ * 	int * weight:	points' weights (NULL: every point counts once)
+ * 	struct gridIndex * g:	the index of the points
+ * 	D dist2:	the squared distance in the precision of the point store
+ * 	C * count0:	the output numbers of type 0 points (NULL: not counted)
+ * 	C * count1:	the output numbers of type 1 points
+ * RETURN: none
  */
-int * countInDistance_Single(double * xE, double * yE, int * indexE, int nBlockX, int nBlockY, double distance)
+template <typename T, typename D, typename C>
+static void countHalfStencil(T * x, T * y, unsigned long long * label, int * weight, struct gridIndex * g, D dist2, C * count0, C * count1)
 {
-	int countE = indexE[nBlockX * nBlockY];
-	int * count;
-	
-	if(NULL == (count = (int *)malloc(sizeof(int) * countE)))
+	int nBlockX = g->nBlockX;
+	int nBlockY = g->nBlockY;
+	int nBlocks = nBlockX * nBlockY;
+
+	//the (weighted) number of points of each type in each block, and the counts added to every point of a block by bulk counting
+	int * nType0;
+	int * nType1;
+	int * add0;
+	int * add1;
+	if(NULL == (nType0 = (int *)malloc(sizeof(int) * nBlocks)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (nType1 = (int *)malloc(sizeof(int) * nBlocks)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (add0 = (int *)calloc(nBlocks, sizeof(int))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (add1 = (int *)calloc(nBlocks, sizeof(int))))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	double x, y;
-	double dis2 = distance * distance;
-	int colID, rowID;
-	int colMin, colMax, rowMin, rowMax;
+
+	for(int b = 0; b < nBlocks; b++)
+	{
+		nType0[b] = 0;
+		nType1[b] = 0;
+		for(int i = g->start[b]; i < g->end[b]; i++)
+		{
+			if(label == NULL || GET_LABEL(label, i) == 1)
+				nType1[b] += (weight == NULL) ? 1 : weight[i];
+			else
+				nType0[b] += (weight == NULL) ? 1 : weight[i];
+		}
+	}
+
+	for(int i = 0; i < g->count; i++)
+	{
+		if(count0 != NULL)
+			count0[i] = 0;
+		count1[i] = 0;
+	}
+
+	if(firstTouchPlacement())
+	{
+		//each thread counts the blocks whose points lie in its share of the arrays, the share whose pages it touched in placeArray, so that it works on the memory of its own node
+		#pragma omp parallel
+		{
+			long long t = omp_get_thread_num();
+			long long nThreads = omp_get_num_threads();
+			int bLast = firstBlockFrom(g, g->count * (t + 1) / nThreads);
+			for(int iB = firstBlockFrom(g, g->count * t / nThreads); iB < bLast; iB ++)
+				countBlock(x, y, label, weight, g, dist2, count0, count1, nType0, nType1, add0, add1, iB);
+		}
+	}
+	else
+	{
+		#pragma omp parallel for schedule(dynamic, 16)
+		for(int iB = 0; iB < nBlocks; iB ++)
+			countBlock(x, y, label, weight, g, dist2, count0, count1, nType0, nType1, add0, add1, iB);
+	}
+
+	for(int b = 0; b < nBlocks; b++)
+	{
+		for(int i = g->start[b]; i < g->end[b]; i++)
+		{
+			if(count0 != NULL)
+				count0[i] += (C)add0[b];
+			count1[i] += (C)add1[b];
+		}
+	}
+
+	free(nType0);
+	free(nType1);
+	free(add0);
+	free(add1);
+}
+
+template <typename T, typename D, typename C>
+static void countDouble(T * xE, T * yE, T * xB, T * yB, struct gridIndex * gE, struct gridIndex * gB, D dis2, C * count)
+{
+	T x, y;
+	int nBlockX = gE->nBlockX;
+	int nBlockY = gE->nBlockY;
+	int blockID, colID, rowID;
+	int nbID;
 	int iC, iP;
-	int pCol, pRow;
-	for(rowID = 0; rowID < nBlockY; rowID ++)
+	int n, nBlock;
+	int rel, rStart, rEnd;
+	struct blockWalk walk;
+	int nbs[MAX_STENCIL];
+	int nbStencil[MAX_STENCIL];
+	int nNbs;
+	for(int iB = 0; iB < nBlockX * nBlockY; iB ++)
 	{
-		for(colID = 0; colID < nBlockX; colID ++)
+		blockID = gE->blocks[iB];
+		if(gE->start[blockID] == gE->end[blockID])
+			continue;
+		colID = blockID % nBlockX;
+		rowID = blockID / nBlockX;
+		//type B blocks entirely within the distance of the type A block count for all its points
+		nBlock = 0;
+		nNbs = 0;
+		for(int s = 0; s < gE->nStencil; s ++)
+		{
+			if(-1 == (nbID = stencilBlock(gE, colID, rowID, s)))
+				continue;
+			switch(stencilToBlock<T>(gE, blockID, gB, s, nbID, dis2))
+			{
+			case BLOCK_OUT:
+				break;
+			case BLOCK_IN:
+				nBlock += gB->end[nbID] - gB->start[nbID];
+				break;
+			default:
+				nbs[nNbs] = nbID;
+				nbStencil[nNbs] = s;
+				nNbs ++;
+			}
+		}
+		for(iC = gE->start[blockID]; iC < gE->end[blockID]; iC++)
 		{
-			colMin = (colID == 0) ? 0 : (colID - 1);
-			colMax = (colID == nBlockX - 1) ? (nBlockX - 1) : (colID + 1);
-			rowMin = (rowID == 0) ? 0 : (rowID - 1);
-			rowMax = (rowID == nBlockY - 1) ? (nBlockY - 1) : (rowID + 1);
-			for(iC = indexE[rowID * nBlockX + colID]; iC < indexE[rowID * nBlockX + colID + 1]; iC++)
+			x = xE[iC];
+			y = yE[iC];
+			n = nBlock;
+			for(int k = 0; k < nNbs; k ++)
 			{
-				x = xE[iC];
-				y = yE[iC];
-				count[iC] = 0;
-				for(int row = rowMin; row <= rowMax; row ++)
+				nbID = nbs[k];
+				switch(stencilToPoint(gB, nbStencil[k], nbID, x, y, dis2))
+				{
+				case BLOCK_OUT:
+					continue;
+				case BLOCK_IN:
+					n += gB->end[nbID] - gB->start[nbID];
+					continue;
+				}
+				startWalk(gB, nbStencil[k], nbID, BLOCK_PART, &walk);
+				while(nextRange(gB, &walk, x, y, dis2, &rStart, &rEnd, &rel))
 				{
-					for(iP = indexE[row * nBlockX + colMin]; iP < indexE[row * nBlockX + colMax + 1]; iP ++)
+					if(rel == BLOCK_IN)
 					{
-						if(dis2 >= ((xE[iP] - x) * (xE[iP] - x) + (yE[iP] - y) * (yE[iP] - y)))
-							count[iC] ++;
+						n += rEnd - rStart;
+						continue;
+					}
+					for(iP = rStart; iP < rEnd; iP ++)
+					{
+						if(inDistance(x, y, xB[iP], yB[iP], dis2))
+							n ++;
 					}
-
 				}
-
 			}
+			count[iC] = (C)n;
 		}
 	}
-	return count;
 }
 
 /**
- * NAME:	countInDistance_Double
- * DESCRIPTION:	get the number of type B points within a distance of each type A point
+ * NAME:	lanesAtLeast
+ * DESCRIPTION:	compare bit-sliced counters of 64 lanes with a threshold
  * PARAMETERS:
- * 	double * xE:		type A points' X values 
- * 	double * yE:		type A points' Y values 
- * 	double * xB:		type B points' X values 
- * 	double * yB:		type B points' Y values 
- * 	int * indexE:		the index of type A points
- * 	int * indexB:		the index of type B points
- * 	int nBlockX:		the number of index blocks along X dimension
- * 	int nBlockY:		the number of index blocks along Y dimension
- * 	double distance:	the distance, which is also the size (side length) of each index block
+ * 	unsigned long long * planes:	the bit planes of the counters, plane b holds bit b of every lane's counter
+ * 	int nPlanes:	the number of bit planes
+ * 	int threshold:	the threshold
  * RETURN:
- * 	TYPE:	int * 
- * 	VALUE:	an array of the numbers of points within the distance
+ * 	TYPE:	unsigned long long
+ * 	VALUE:	a mask with the bits of the lanes whose counter is at least the threshold
  */
-
-int * countInDistance_Double(double * xE, double * yE, double * xB, double * yB, int * indexE, int * indexB, int nBlockX, int nBlockY, double distance)
+static inline unsigned long long lanesAtLeast(unsigned long long * planes, int nPlanes, int threshold)
 {
-	int countE = indexE[nBlockX * nBlockY];
-	int countB = indexB[nBlockX * nBlockY];
+	if(threshold <= 0)
+		return ~0ULL;
+	if((threshold >> nPlanes) != 0)
+		return 0;
 
-	int * count;
-	
-	if(NULL == (count = (int *)malloc(sizeof(int) * countE)))
+	unsigned long long gt = 0;
+	unsigned long long eq = ~0ULL;
+	for(int b = nPlanes - 1; b >= 0; b --)
 	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
+		if((threshold >> b) & 1)
+		{
+			eq &= planes[b];
+		}
+		else
+		{
+			gt |= eq & planes[b];
+			eq &= ~planes[b];
+		}
 	}
-	double x, y;
-	double dis2 = distance * distance;
-	int colID, rowID;
-	int colMin, colMax, rowMin, rowMax;
-	int iC, iP;
-	int pCol, pRow;
-	for(rowID = 0; rowID < nBlockY; rowID ++)
+	return gt | eq;
+}
+
+template <typename T, typename D>
+static void coreLanes(T * x, T * y, unsigned long long * laneLabel, struct gridIndex * g, D dist2, int * coreThr, int nPlanes, unsigned long long * coreMask)
+{
+	T xi, yi;
+	int nBlockX = g->nBlockX;
+	int nBlockY = g->nBlockY;
+	int blockID, colID, rowID;
+	int nbID, rel;
+	int nbs[MAX_STENCIL];
+	int nbStencil[MAX_STENCIL];
+	int nbRel[MAX_STENCIL];
+	int nNbs;
+	int rStart, rEnd;
+	struct blockWalk walk;
+	unsigned long long planes[32];
+	unsigned long long carry, t;
+
+	for(int iB = 0; iB < nBlockX * nBlockY; iB ++)
 	{
-		for(colID = 0; colID < nBlockX; colID ++)
+		blockID = g->blocks[iB];
+		if(g->start[blockID] == g->end[blockID])
+			continue;
+		colID = blockID % nBlockX;
+		rowID = blockID / nBlockX;
+		//blocks entirely beyond the distance of the block are dropped, and those entirely within it need no tests
+		nNbs = 0;
+		for(int s = 0; s < g->nStencil; s ++)
+		{
+			if(-1 == (nbID = stencilBlock(g, colID, rowID, s)))
+				continue;
+			rel = stencilToBlock<T>(g, blockID, g, s, nbID, dist2);
+			if(rel == BLOCK_OUT)
+				continue;
+			nbs[nNbs] = nbID;
+			nbStencil[nNbs] = s;
+			nbRel[nNbs] = rel;
+			nNbs ++;
+		}
+		for(int i = g->start[blockID]; i < g->end[blockID]; i++)
 		{
-			colMin = (colID == 0) ? 0 : (colID - 1);
-			colMax = (colID == nBlockX - 1) ? (nBlockX - 1) : (colID + 1);
-			rowMin = (rowID == 0) ? 0 : (rowID - 1);
-			rowMax = (rowID == nBlockY - 1) ? (nBlockY - 1) : (rowID + 1);
-			for(iC = indexE[rowID * nBlockX + colID]; iC < indexE[rowID * nBlockX + colID + 1]; iC++)
+			//no lane can reach the threshold, skip the neighborhood
+			if((coreThr[i] >> nPlanes) != 0)
 			{
-				x = xE[iC];
-				y = yE[iC];
-				count[iC] = 0;
-				for(int row = rowMin; row <= rowMax; row ++)
+				coreMask[i] = 0;
+				continue;
+			}
+			xi = x[i];
+			yi = y[i];
+			for(int b = 0; b < nPlanes; b ++)
+				planes[b] = 0;
+			for(int k = 0; k < nNbs; k ++)
+			{
+				nbID = nbs[k];
+				startWalk(g, nbStencil[k], nbID, (nbRel[k] == BLOCK_IN) ? BLOCK_IN : BLOCK_UNKNOWN, &walk);
+				while(nextRange(g, &walk, xi, yi, dist2, &rStart, &rEnd, &rel))
 				{
-					for(iP = indexB[row * nBlockX + colMin]; iP < indexB[row * nBlockX + colMax + 1]; iP ++)
+					for(int j = rStart; j < rEnd; j ++)
 					{
-						if(dis2 >= ((xB[iP] - x) * (xB[iP] - x) + (yB[iP] - y) * (yB[iP] - y)))
-							count[iC] ++;
+						if(laneLabel[j] != 0 && (rel == BLOCK_IN || inDistance(xi, yi, x[j], y[j], dist2)))
+						{
+							//ripple-carry add of one bit per lane
+							carry = laneLabel[j];
+							for(int b = 0; carry != 0; b ++)
+							{
+								t = planes[b] & carry;
+								planes[b] ^= carry;
+								carry = t;
+							}
+						}
 					}
+				}
+			}
+			coreMask[i] = lanesAtLeast(planes, nPlanes, coreThr[i]);
+		}
+	}
+}
+
 
+/**
+ * NAME:	scatterEvents
+ * DESCRIPTION:	add the events at each of a list of locations to the counts of every point within a distance of it (including itself), walking the neighborhoods of the events only. the points reached are listed, so the counts can be cleared again without visiting the other points
+ * PARAMETERS:
+ * 	T * x, T * y:	points' coordinates, in the precision of the point store
+ * 	int * events:	the array indexes of the locations with events
+ * 	int nEvents:	the number of locations with events
+ * 	int * weight1:	the number of events at each location (NULL: one)
+ * 	struct gridIndex * g:	the index of the points
+ * 	D dist2:	the squared distance in the precision of the point store
+ * 	int * count1:	the output counts, all 0 before
+ * 	int * touched:	the output points whose count became nonzero
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the number of points listed in touched
+ */
+template <typename T, typename D>
+static int scatterEvents(T * x, T * y, int * events, int nEvents, int * weight1, struct gridIndex * g, D dist2, int * count1, int * touched)
+{
+	int nTouched = 0;
+	int e, n;
+	T xe, ye;
+	int blockID, colID, rowID;
+	int nbID, rel;
+	int rStart, rEnd;
+	struct blockWalk walk;
+
+	for(int k = 0; k < nEvents; k ++)
+	{
+		e = events[k];
+		n = (weight1 == NULL) ? 1 : weight1[e];
+		xe = x[e];
+		ye = y[e];
+		blockID = blockOfPoint(g, e);
+		colID = blockID % g->nBlockX;
+		rowID = blockID / g->nBlockX;
+		for(int s = 0; s < g->nStencil; s ++)
+		{
+			if(-1 == (nbID = stencilBlock(g, colID, rowID, s)))
+				continue;
+			startWalk(g, s, nbID, BLOCK_UNKNOWN, &walk);
+			while(nextRange(g, &walk, xe, ye, dist2, &rStart, &rEnd, &rel))
+			{
+				for(int j = rStart; j < rEnd; j ++)
+				{
+					if(rel == BLOCK_IN || inDistance(xe, ye, x[j], y[j], dist2))
+					{
+						if(count1[j] == 0)
+						{
+							touched[nTouched] = j;
+							nTouched ++;
+						}
+						count1[j] += n;
+					}
 				}
+			}
+		}
+	}
+	return nTouched;
+}
+
+/**
+ * NAME:	countNearEvents
+ * DESCRIPTION:	get the number of each type of points within a distance of a list of points (including itself), walking the neighborhood of each listed point. the counts of the other points are set to 0
+ * PARAMETERS:
+ * 	T * x, T * y:	points' coordinates, in the precision of the point store
+ * 	unsigned long long * label:	points' bit-packed type labels
+ * 	int * weight:	points' weights (NULL: every point counts once)
+ * 	struct gridIndex * g:	the index of the points
+ * 	D dist2:	the squared distance in the precision of the point store
+ * 	int * points:	the listed points
+ * 	int nPoints:	the number of listed points
+ * 	int * count1:	the numbers of type 1 points of the listed points, already counted
+ * 	C * c0:		the output numbers of type 0 points
+ * 	C * c1:		the output numbers of type 1 points
+ * RETURN: none
+ */
+template <typename T, typename D, typename C>
+static void countNearEvents(T * x, T * y, unsigned long long * label, int * weight, struct gridIndex * g, D dist2, int * points, int nPoints, int * count1, C * c0, C * c1)
+{
+	int i, n;
+	T xi, yi;
+	int blockID, colID, rowID;
+	int nbID, rel;
+	int rStart, rEnd;
+	struct blockWalk walk;
+
+	for(i = 0; i < g->count; i ++)
+	{
+		c0[i] = 0;
+		c1[i] = 0;
+	}
 
+	for(int k = 0; k < nPoints; k ++)
+	{
+		i = points[k];
+		xi = x[i];
+		yi = y[i];
+		blockID = blockOfPoint(g, i);
+		colID = blockID % g->nBlockX;
+		rowID = blockID / g->nBlockX;
+		n = 0;
+		for(int s = 0; s < g->nStencil; s ++)
+		{
+			if(-1 == (nbID = stencilBlock(g, colID, rowID, s)))
+				continue;
+			startWalk(g, s, nbID, BLOCK_UNKNOWN, &walk);
+			while(nextRange(g, &walk, xi, yi, dist2, &rStart, &rEnd, &rel))
+			{
+				for(int j = rStart; j < rEnd; j ++)
+				{
+					if(GET_LABEL(label, j) == 0 && (rel == BLOCK_IN || inDistance(xi, yi, x[j], y[j], dist2)))
+						n += (weight == NULL) ? 1 : weight[j];
+				}
 			}
 		}
+		c0[i] = (C)n;
+		c1[i] = (C)count1[i];
+	}
+}
+
+/**
+ * NAME:	countInDistance
+ * DESCRIPTION:	get the number of each type of points within a distance of each point
+ * PARAMETERS:
+ * 	struct pointStore * ps:		the store of all points, the counts are done in its precision
+ * 	unsigned long long * label:	points' type labels
+ * 	struct gridIndex * g:		the index of all points
+ * 	double distance:			the distance, which is the search radius the index was built for
+ * 	struct neighborCounts * nc:	the output numbers of points with label 0 (c0) and label 1 (c1) within the distance, ordered the same as the points
+ */
+void countInDistance(struct pointStore * ps, unsigned long long * label, struct gridIndex * g, double distance, struct neighborCounts * nc)
+{
+	if(nc->width == 2)
+	{
+		unsigned short * c0 = (unsigned short *)nc->c0;
+		unsigned short * c1 = (unsigned short *)nc->c1;
+		if(ps->precision == PRECISION_FLOAT)
+			countHalfStencil(ps->xf, ps->yf, label, ps->weight, g, floatDist2(distance), c0, c1);
+		else if(ps->precision == PRECISION_INT)
+			countHalfStencil(ps->xq, ps->yq, label, ps->weight, g, quantDist2(ps, distance), c0, c1);
+		else
+			countHalfStencil(ps->x, ps->y, label, ps->weight, g, distance * distance, c0, c1);
+	}
+	else
+	{
+		int * c0 = (int *)nc->c0;
+		int * c1 = (int *)nc->c1;
+		if(ps->precision == PRECISION_FLOAT)
+			countHalfStencil(ps->xf, ps->yf, label, ps->weight, g, floatDist2(distance), c0, c1);
+		else if(ps->precision == PRECISION_INT)
+			countHalfStencil(ps->xq, ps->yq, label, ps->weight, g, quantDist2(ps, distance), c0, c1);
+		else
+			countHalfStencil(ps->x, ps->y, label, ps->weight, g, distance * distance, c0, c1);
+	}
+}
+
+
+/**
+ * NAME:	countInDistance_Single
+ * DESCRIPTION:	get the number of type A points within a distance of each type A point
+ * PARAMETERS:
+ * 	struct pointStore * psE:	the store of type A points, the counts are done in its precision
+ * 	struct gridIndex * gE:		the index of type A points
+ * 	double distance:			the distance, which is the search radius the index was built for
+ * 	struct neighborCounts * nc:	the output numbers of points within the distance (c0), ordered the same as the points
+ */
+void countInDistance_Single(struct pointStore * psE, struct gridIndex * gE, double distance, struct neighborCounts * nc)
+{
+	countInDistance_Weights(psE, psE->weight, gE, distance, nc);
+}
+
+/**
+ * NAME:	countInDistance_Weights
+ * DESCRIPTION:	get the total weight of the points within a distance of each point, under weights other than the ones of the store (e.g. the simulated cases at each location)
+ * PARAMETERS:
+ * 	struct pointStore * ps:		the store of all points, the counts are done in its precision
+ * 	int * weight:				points' weights (NULL: every point counts once)
+ * 	struct gridIndex * g:		the index of all points
+ * 	double distance:			the distance, which is the search radius the index was built for
+ * 	struct neighborCounts * nc:	the output total weights within the distance (c0), ordered the same as the points
+ */
+void countInDistance_Weights(struct pointStore * ps, int * weight, struct gridIndex * g, double distance, struct neighborCounts * nc)
+{
+	if(nc->width == 2)
+	{
+		unsigned short * c0 = (unsigned short *)nc->c0;
+		if(ps->precision == PRECISION_FLOAT)
+			countHalfStencil(ps->xf, ps->yf, NULL, weight, g, floatDist2(distance), (unsigned short *)NULL, c0);
+		else if(ps->precision == PRECISION_INT)
+			countHalfStencil(ps->xq, ps->yq, NULL, weight, g, quantDist2(ps, distance), (unsigned short *)NULL, c0);
+		else
+			countHalfStencil(ps->x, ps->y, NULL, weight, g, distance * distance, (unsigned short *)NULL, c0);
+	}
+	else
+	{
+		int * c0 = (int *)nc->c0;
+		if(ps->precision == PRECISION_FLOAT)
+			countHalfStencil(ps->xf, ps->yf, NULL, weight, g, floatDist2(distance), (int *)NULL, c0);
+		else if(ps->precision == PRECISION_INT)
+			countHalfStencil(ps->xq, ps->yq, NULL, weight, g, quantDist2(ps, distance), (int *)NULL, c0);
+		else
+			countHalfStencil(ps->x, ps->y, NULL, weight, g, distance * distance, (int *)NULL, c0);
+	}
+}
+
+/**
+ * NAME:	countInDistance_Double
+ * DESCRIPTION:	get the number of type B points within a distance of each type A point. both stores must have the same precision and origin, and both indexes the same blocks
+ * PARAMETERS:
+ * 	struct pointStore * psE:	the store of type A points
+ * 	struct pointStore * psB:	the store of type B points
+ * 	struct gridIndex * gE:		the index of type A points
+ * 	struct gridIndex * gB:		the index of type B points
+ * 	double distance:			the distance, which is the search radius the index was built for
+ * 	struct neighborCounts * nc:	the output numbers of type B points within the distance (c0), ordered the same as type A points
+ */
+void countInDistance_Double(struct pointStore * psE, struct pointStore * psB, struct gridIndex * gE, struct gridIndex * gB, double distance, struct neighborCounts * nc)
+{
+	if(nc->width == 2)
+	{
+		unsigned short * c0 = (unsigned short *)nc->c0;
+		if(psE->precision == PRECISION_FLOAT)
+			countDouble(psE->xf, psE->yf, psB->xf, psB->yf, gE, gB, floatDist2(distance), c0);
+		else if(psE->precision == PRECISION_INT)
+			countDouble(psE->xq, psE->yq, psB->xq, psB->yq, gE, gB, quantDist2(psE, distance), c0);
+		else
+			countDouble(psE->x, psE->y, psB->x, psB->y, gE, gB, distance * distance, c0);
+	}
+	else
+	{
+		int * c0 = (int *)nc->c0;
+		if(psE->precision == PRECISION_FLOAT)
+			countDouble(psE->xf, psE->yf, psB->xf, psB->yf, gE, gB, floatDist2(distance), c0);
+		else if(psE->precision == PRECISION_INT)
+			countDouble(psE->xq, psE->yq, psB->xq, psB->yq, gE, gB, quantDist2(psE, distance), c0);
+		else
+			countDouble(psE->x, psE->y, psB->x, psB->y, gE, gB, distance * distance, c0);
 	}
-	return count;
 }
 
-void countInDistance_EventsInPop(double * xB, double * yB, int * ind, int * indexB, int nBlockX, int nBlockY, double distance, int * countPointsE) {
+/**
+ * NAME:	countInDistance_EventsInPop
+ * DESCRIPTION:	get the number of event (label 1) points within a distance of each point of a population
+ * PARAMETERS:
+ * 	struct pointStore * psB:	the store of all points, the counts are done in its precision
+ * 	unsigned long long * label:	points' type labels (1: events)
+ * 	struct gridIndex * gB:		the index of all points
+ * 	double distance:			the distance, which is the search radius the index was built for
+ * 	struct neighborCounts * nc:	the output numbers of events within the distance (c1), ordered the same as the points
+ */
+void countInDistance_EventsInPop(struct pointStore * psB, unsigned long long * label, struct gridIndex * gB, double distance, struct neighborCounts * nc) {
+	if(nc->width == 2)
+	{
+		unsigned short * c1 = (unsigned short *)nc->c1;
+		if(psB->precision == PRECISION_FLOAT)
+			countHalfStencil(psB->xf, psB->yf, label, psB->weight, gB, floatDist2(distance), (unsigned short *)NULL, c1);
+		else if(psB->precision == PRECISION_INT)
+			countHalfStencil(psB->xq, psB->yq, label, psB->weight, gB, quantDist2(psB, distance), (unsigned short *)NULL, c1);
+		else
+			countHalfStencil(psB->x, psB->y, label, psB->weight, gB, distance * distance, (unsigned short *)NULL, c1);
+	}
+	else
+	{
+		int * c1 = (int *)nc->c1;
+		if(psB->precision == PRECISION_FLOAT)
+			countHalfStencil(psB->xf, psB->yf, label, psB->weight, gB, floatDist2(distance), (int *)NULL, c1);
+		else if(psB->precision == PRECISION_INT)
+			countHalfStencil(psB->xq, psB->yq, label, psB->weight, gB, quantDist2(psB, distance), (int *)NULL, c1);
+		else
+			countHalfStencil(psB->x, psB->y, label, psB->weight, gB, distance * distance, (int *)NULL, c1);
+	}
+}
+
+/**
+ * NAME:	countInDistance_Lanes
+ * DESCRIPTION:	for 64 labelings of the same points at once, find the points having at least a threshold number of label 1 points within a distance. bit k of a point's label word is its label in labeling (lane) k, and the counts of all lanes are kept as bit-sliced counters, so each neighborhood is walked once for all lanes
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points, the counts are done in its precision
+ * 	unsigned long long * laneLabel:	the label words of the points, one bit per lane
+ * 	struct gridIndex * g:	the index of all points
+ * 	double distance:	the distance, which is the search radius the index was built for
+ * 	int * coreThr:		the threshold of each point
+ * 	int maxCount:		an upper bound of any count, e.g. the largest number of points in the search stencil of a block
+ * 	unsigned long long * coreMask:	the output lanes in which each point reaches its threshold, ordered the same as the points
+ */
+void countInDistance_Lanes(struct pointStore * ps, unsigned long long * laneLabel, struct gridIndex * g, double distance, int * coreThr, int maxCount, unsigned long long * coreMask)
+{
+	int nPlanes = 1;
+	while(nPlanes < 31 && (maxCount >> nPlanes) != 0)
+		nPlanes ++;
+
+	if(ps->precision == PRECISION_FLOAT)
+		coreLanes(ps->xf, ps->yf, laneLabel, g, floatDist2(distance), coreThr, nPlanes, coreMask);
+	else if(ps->precision == PRECISION_INT)
+		coreLanes(ps->xq, ps->yq, laneLabel, g, quantDist2(ps, distance), coreThr, nPlanes, coreMask);
+	else
+		coreLanes(ps->x, ps->y, laneLabel, g, distance * distance, coreThr, nPlanes, coreMask);
+}
+
+/**
+ * NAME:	countInDistance_Events
+ * DESCRIPTION:	add the events at a list of locations to the number of events within a distance of every point, walking the neighborhoods of the events only, so the work does not grow with the number of points far from any event
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points, the counts are done in its precision
+ * 	int * events:		the array indexes of the locations with events
+ * 	int nEvents:		the number of locations with events
+ * 	int * weight1:		the number of events at each location (NULL: one)
+ * 	struct gridIndex * g:	the index of all points
+ * 	double distance:	the distance, which is the search radius the index was built for
+ * 	int * count1:		the output numbers of events within the distance of each point, all 0 before
+ * 	int * touched:		the output points whose count became nonzero
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the number of points listed in touched
+ */
+int countInDistance_Events(struct pointStore * ps, int * events, int nEvents, int * weight1, struct gridIndex * g, double distance, int * count1, int * touched)
+{
+	if(ps->precision == PRECISION_FLOAT)
+		return scatterEvents(ps->xf, ps->yf, events, nEvents, weight1, g, floatDist2(distance), count1, touched);
+	if(ps->precision == PRECISION_INT)
+		return scatterEvents(ps->xq, ps->yq, events, nEvents, weight1, g, quantDist2(ps, distance), count1, touched);
+	return scatterEvents(ps->x, ps->y, events, nEvents, weight1, g, distance * distance, count1, touched);
+}
+
+/**
+ * NAME:	countInDistance_NearEvents
+ * DESCRIPTION:	get the number of each type of points within a distance of each point near an event (label 1), the same as countInDistance for them. the other points have no events within the distance and are never reached from one, their counts are set to 0. the events are spread to their neighbors first, then only the points reached count their type 0 neighbors; if most points are reached, all of them are counted by countInDistance instead
+ * PARAMETERS:
+ * 	struct pointStore * ps:		the store of all points, the counts are done in its precision
+ * 	unsigned long long * label:	points' type labels (1: events)
+ * 	struct gridIndex * g:		the index of all points
+ * 	double distance:			the distance, which is the search radius the index was built for
+ * 	struct neighborCounts * nc:	the output numbers of points with label 0 (c0) and label 1 (c1) within the distance, ordered the same as the points
+ */
+void countInDistance_NearEvents(struct pointStore * ps, unsigned long long * label, struct gridIndex * g, double distance, struct neighborCounts * nc)
+{
+	int count = g->count;
+	int * events;
+	int * count1;
+	int * touched;
+	if(NULL == (events = (int *)malloc(sizeof(int) * count)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (count1 = (int *)calloc(count, sizeof(int))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (touched = (int *)malloc(sizeof(int) * count)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	int nEvents = 0;
+	for(int i = 0; i < count; i++)
+	{
+		if(GET_LABEL(label, i) == 1)
+		{
+			events[nEvents] = i;
+			nEvents ++;
+		}
+	}
+	int nTouched = countInDistance_Events(ps, events, nEvents, ps->weight, g, distance, count1, touched);
+
+	//a point walks its whole stencil here, about twice its share of the half stencil pass
+	if(nTouched * 2 > count)
+		countInDistance(ps, label, g, distance, nc);
+	else if(nc->width == 2)
+	{
+		unsigned short * c0 = (unsigned short *)nc->c0;
+		unsigned short * c1 = (unsigned short *)nc->c1;
+		if(ps->precision == PRECISION_FLOAT)
+			countNearEvents(ps->xf, ps->yf, label, ps->weight, g, floatDist2(distance), touched, nTouched, count1, c0, c1);
+		else if(ps->precision == PRECISION_INT)
+			countNearEvents(ps->xq, ps->yq, label, ps->weight, g, quantDist2(ps, distance), touched, nTouched, count1, c0, c1);
+		else
+			countNearEvents(ps->x, ps->y, label, ps->weight, g, distance * distance, touched, nTouched, count1, c0, c1);
+	}
+	else
+	{
+		int * c0 = (int *)nc->c0;
+		int * c1 = (int *)nc->c1;
+		if(ps->precision == PRECISION_FLOAT)
+			countNearEvents(ps->xf, ps->yf, label, ps->weight, g, floatDist2(distance), touched, nTouched, count1, c0, c1);
+		else if(ps->precision == PRECISION_INT)
+			countNearEvents(ps->xq, ps->yq, label, ps->weight, g, quantDist2(ps, distance), touched, nTouched, count1, c0, c1);
+		else
+			countNearEvents(ps->x, ps->y, label, ps->weight, g, distance * distance, touched, nTouched, count1, c0, c1);
+	}
 
-	double xi, yi;
+	free(events);
+	free(count1);
+	free(touched);
+}
+/**
+ * NAME:	validatePrecision
+ * DESCRIPTION:	compare the neighbor test of every pair of points in neighboring index blocks under the reduced precision of a point store with the test in double precision, and report the pairs near the distance boundary whose classification differs. the store must keep its double coordinates
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points
+ * 	struct gridIndex * g:	the index of all points
+ * 	double distance:	the distance, which is the search radius the index was built for
+ * 	int maxReport:		the maximum number of differing pairs to print
+ * RETURN:
+ * 	TYPE:	long long
+ * 	VALUE:	the number of pairs whose classification differs from double precision
+ */
+long long validatePrecision(struct pointStore * ps, struct gridIndex * g, double distance, int maxReport)
+{
 	double dist2 = distance * distance;
-	int colID, rowID;
-	int colMin, colMax, rowMin, rowMax;
-
-	for(rowID = 0; rowID < nBlockY; rowID ++) {
-		for(colID = 0; colID < nBlockX; colID ++) {
-			colMin = (colID == 0) ? 0 : (colID - 1);
-			colMax = (colID == nBlockX - 1) ? (nBlockX - 1) : (colID + 1);
-			rowMin = (rowID == 0) ? 0 : (rowID - 1);
-			rowMax = (rowID == nBlockY - 1) ? (nBlockY - 1) : (rowID + 1);
-
-			for(int i = indexB[rowID * nBlockX + colID]; i < indexB[rowID * nBlockX + colID + 1]; i++) {
-				xi = xB[i];
-				yi = yB[i];
-				countPointsE[i] = 0;
-	
-				for(int row = rowMin; row <= rowMax; row ++) {
-					for(int j = indexB[row * nBlockX + colMin]; j < indexB[row * nBlockX + colMax + 1]; j ++) {
-						if(ind[j] == 1 && dist2 >= ((xB[j] - xi) * (xB[j] - xi) + (yB[j] - yi) * (yB[j] - yi))) {
-							countPointsE[i] ++;
+	float dist2F = floatDist2(distance);
+	long long dist2Q = (ps->precision == PRECISION_INT) ? quantDist2(ps, distance) : 0;
+	long long nDiffer = 0;
+	bool exact, reduced;
+	int nBlockX = g->nBlockX;
+	int nBlockY = g->nBlockY;
+	int blockID, colID, rowID;
+	int nbID;
+
+	if(ps->precision == PRECISION_DOUBLE || ps->x == NULL)
+		return 0;
+
+	for(int iB = 0; iB < nBlockX * nBlockY; iB ++)
+	{
+		blockID = g->blocks[iB];
+		colID = blockID % nBlockX;
+		rowID = blockID / nBlockX;
+		for(int i = g->start[blockID]; i < g->end[blockID]; i++)
+		{
+			for(int s = 0; s < g->nStencil; s ++)
+			{
+				if(-1 == (nbID = stencilBlock(g, colID, rowID, s)))
+					continue;
+				for(int j = g->start[nbID]; j < g->end[nbID]; j ++)
+				{
+					//each pair is visited from both ends, only report it once
+					if(j <= i)
+						continue;
+					exact = inDistance(ps->x[i], ps->y[i], ps->x[j], ps->y[j], dist2);
+					if(ps->precision == PRECISION_FLOAT)
+						reduced = inDistance(ps->xf[i], ps->yf[i], ps->xf[j], ps->yf[j], dist2F);
+					else
+						reduced = inDistance(ps->xq[i], ps->yq[i], ps->xq[j], ps->yq[j], dist2Q);
+					if(exact != reduced)
+					{
+						if(nDiffer < maxReport)
+						{
+							printf("Precision mismatch: (%lf, %lf) - (%lf, %lf)\tdouble: %s\treduced: %s\n", ps->x[i], ps->y[i], ps->x[j], ps->y[j], exact ? "in" : "out", reduced ? "in" : "out");
 						}
+						nDiffer ++;
 					}
 				}
 			}
 		}
 	}
-
+	return nDiffer;
 }
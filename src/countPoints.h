@@ -1,9 +1,18 @@
 #ifndef CPH
 #define CPH
 
-void countInDistance(double * x, double * y, int * ind, int * index, int nBlockX, int nBlockY, double distance, int * count0, int * count1);
-int * countInDistance_Single(double * xE, double * yE, int * indexE, int nBlockX, int nBlockY, double distance);
-int * countInDistance_Double(double * xE, double * yE, double * xB, double * yB, int * indexE, int * indexB, int nBlockX, int nBlockY, double distance);
-void countInDistance_EventsInPop(double * xB, double * yB, int * ind, int * indexB, int nBlockX, int nBlockY, double distance, int * countPointsE);
+struct pointStore;
+struct neighborCounts;
+struct gridIndex;
+
+void countInDistance(struct pointStore * ps, unsigned long long * label, struct gridIndex * g, double distance, struct neighborCounts * nc);
+void countInDistance_Single(struct pointStore * psE, struct gridIndex * gE, double distance, struct neighborCounts * nc);
+void countInDistance_Weights(struct pointStore * ps, int * weight, struct gridIndex * g, double distance, struct neighborCounts * nc);
+void countInDistance_Double(struct pointStore * psE, struct pointStore * psB, struct gridIndex * gE, struct gridIndex * gB, double distance, struct neighborCounts * nc);
+void countInDistance_EventsInPop(struct pointStore * psB, unsigned long long * label, struct gridIndex * gB, double distance, struct neighborCounts * nc);
+void countInDistance_Lanes(struct pointStore * ps, unsigned long long * laneLabel, struct gridIndex * g, double distance, int * coreThr, int maxCount, unsigned long long * coreMask);
+int countInDistance_Events(struct pointStore * ps, int * events, int nEvents, int * weight1, struct gridIndex * g, double distance, int * count1, int * touched);
+void countInDistance_NearEvents(struct pointStore * ps, unsigned long long * label, struct gridIndex * g, double distance, struct neighborCounts * nc);
+long long validatePrecision(struct pointStore * ps, struct gridIndex * g, double distance, int maxReport);
 
 #endif
@@ -7,6 +7,52 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <unistd.h>
+#include "io.h"
+#include "memory.h"
+
+/**
+ * NAME:	readPoint
+ * DESCRIPTION:	read the next point (X, Y) of an input file, with its weight if the line has a third column. lines that do not start with two numbers (e.g. a header) are skipped
+ * PARAMETERS:
+ * 	FILE * file: the input file
+ * 	double * x: the X value of the point
+ * 	double * y: the Y value of the point
+ * 	int * weight: the weight of the point, the number of points at its location (1 if the line has no weight)
+ * RETURN:
+ * 	TYPE:	bool
+ * 	VALUE:	false at the end of the file
+ */
+bool readPoint(FILE * file, double * x, double * y, int * weight)
+{
+	int n, c;
+	double w;
+
+	while(EOF != (n = fscanf(file, "%lf,%lf", x, y)))
+	{
+		*weight = 1;
+		c = fgetc(file);
+		if(n == 2 && c == ',' && fscanf(file, "%lf", &w) == 1)
+		{
+			//only whole numbers of points keep the counts and the tests exact
+			if(w < 1 || w > INT_MAX || w != floor(w))
+			{
+				printf("ERROR: Invalid point weight %lf, a weight must be a positive whole number\n", w);
+				exit(1);
+			}
+			*weight = (int)w;
+			c = fgetc(file);
+		}
+		while(c != '\n' && c != EOF)
+			c = fgetc(file);
+		if(n == 2)
+			return true;
+	}
+	return false;
+}
 
 /**
  * NAME:	getCount
@@ -22,13 +68,32 @@
  * 	VALUE:	the number of points in the file
  */
 int getCount(FILE * file, double &xMin, double &xMax, double &yMin, double &yMax)
+{
+	int weight;
+	return getCount(file, xMin, xMax, yMin, yMax, weight);
+}
+
+/**
+ * NAME:	getCount
+ * DESCRIPTION:	get the number of lines (locations) and the total weight (points) in a input file; update the bounding box of all points accordingly
+ * PARAMETERS:
+ * 	int &weight: the total weight of all lines, equal to the number of lines if the file has no weights
+ * 	(the other parameters are the same as above)
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the number of lines in the file
+ */
+int getCount(FILE * file, double &xMin, double &xMax, double &yMin, double &yMax, int &weight)
 {
 	int count = 0;
 	double x, y;
+	int w;
+	long long sum = 0;
 	rewind(file);
 	
-	while(fscanf(file, "%lf,%lf\n", &x, &y) != EOF) {
+	while(readPoint(file, &x, &y, &w)) {
 		count ++;
+		sum += w;
 		if(x < xMin)
 			xMin = x;
 		if(x > xMax)
@@ -39,6 +104,12 @@ int getCount(FILE * file, double &xMin, double &xMax, double &yMin, double &yMax
 			yMax = y;
 	}
 
+	if(sum > INT_MAX)
+	{
+		printf("ERROR: The total weight of the points exceeds %d\n", INT_MAX);
+		exit(1);
+	}
+	weight = (int)sum;
 	return count;
 	
 }
@@ -56,221 +127,980 @@ void readPoints(FILE * file, double * x, double * y)
 {
 	rewind(file);
 	int count = 0;
+	int w;
 
-	while(fscanf(file, "%lf,%lf\n", x + count, y + count) != EOF) {
+	while(readPoint(file, x + count, y + count, &w)) {
 		count ++;
 	}
 }
 
 /**
- * NAME:	indexPoints
- * DESCRIPTION:	index all points based on the block they falls in. the points will be re-ordered based on their blocksIDs accendingly. a seperate index table is created to store the ending array index (in the re-ordered array x and y) of points in each block.
+ * NAME:	readPoints
+ * DESCRIPTION:	read all points (X, Y) in a file with their weights
  * PARAMETERS:
- * 	double * &x: 		array points' X values, will be changed to a new array of ordered points
- * 	double * &y: 		array points' Y values, will be changed to a new array of ordered points
- * 	int count:			the total number of points
- * 	double xMin:		the minimum X of all points, used to calculate the blockID of each point
- * 	double yMin:		the minimum Y of all points, used to calculate the blockID of each point
- * 	int nBlockX:		the number of index blocks along X dimension
- * 	int nBlockY:		the number of index blocks along Y dimension
- * 	double blockSize:	the size (side length) of each index block
+ * 	int * weight: the array to store points' weights
+ * 	(the other parameters are the same as above)
+ * RETURN: none
+ */
+void readPoints(FILE * file, double * x, double * y, int * weight)
+{
+	rewind(file);
+	int count = 0;
+
+	while(readPoint(file, x + count, y + count, weight + count)) {
+		count ++;
+	}
+}
+
+struct locationKey {
+	double x;
+	double y;
+	int id;
+};
+
+/**
+ * NAME:	compareLocation
+ * DESCRIPTION:	compare two locations for qsort, by X, then Y, then the ID so that the first point of a location comes first
+ */
+static int compareLocation(const void * a, const void * b)
+{
+	const struct locationKey * ka = (const struct locationKey *)a;
+	const struct locationKey * kb = (const struct locationKey *)b;
+	if(ka->x != kb->x)
+		return (ka->x < kb->x) ? -1 : 1;
+	if(ka->y != kb->y)
+		return (ka->y < kb->y) ? -1 : 1;
+	return ka->id - kb->id;
+}
+
+/**
+ * NAME:	openTempFile
+ * DESCRIPTION:	create a temporary file in a directory and unlink it at once, so it is removed when closed or when the program ends. tmpfile would always use /tmp, which is often in memory
+ * PARAMETERS:
+ * 	const char * dir:	the directory (NULL: $TMPDIR, or /tmp if it is not set)
  * RETURN:
- * 	TYPE:	int *
- * 	VALUE:	an array with a length equal to (the total number of index blocks + 1), storing the starting and ending array index of points in each block
+ * 	TYPE:	FILE *
+ * 	VALUE:	the file open for reading and writing, or NULL if it can't be created
  */
-int * indexPoints(double * &x, double * &y, int count, double xMin, double yMin, int nBlockX, int nBlockY, double blockSize)
+FILE * openTempFile(const char * dir)
 {
-	int * index;
-	int * pointsInB;
+	char * path;
+	FILE * file;
+	int fd;
 
-	double * newX;
-	double * newY;
-	
-	if(NULL == (index = (int *)malloc(sizeof(int) * (nBlockY * nBlockX + 1))))
+	if(dir == NULL)
+		dir = getenv("TMPDIR");
+	if(dir == NULL || dir[0] == '\0')
+		dir = "/tmp";
+	if(NULL == (path = (char *)malloc(strlen(dir) + 20)))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	if(NULL == (pointsInB = (int *)malloc(sizeof(int) * nBlockY * nBlockX)))
+	sprintf(path, "%s/ESCIB_XXXXXX", dir);
+	if(-1 == (fd = mkstemp(path)))
 	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
+		free(path);
+		return NULL;
 	}
+	unlink(path);
+	free(path);
+	if(NULL == (file = fdopen(fd, "w+b")))
+		close(fd);
+	return file;
+}
 
-	if(NULL == (newX = (double *)malloc(sizeof(double) * count)))
+/**
+ * NAME:	collapseDuplicates
+ * DESCRIPTION:	merge the points at exactly the same location into one point whose weight is the sum of their weights. each location is kept where its first point is, and the points are compacted at the front of the arrays
+ * PARAMETERS:
+ * 	double * x: 		points' X values
+ * 	double * y: 		points' Y values
+ * 	int * weight:		points' weights
+ * 	int count:			the number of points
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the number of distinct locations
+ */
+int collapseDuplicates(double * x, double * y, int * weight, int count)
+{
+	struct locationKey * keys;
+	if(NULL == (keys = (struct locationKey *)malloc(sizeof(struct locationKey) * count)))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	if(NULL == (newY = (double *)malloc(sizeof(double) * count)))
+	for(int i = 0; i < count; i++)
 	{
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
+		keys[i].x = x[i];
+		keys[i].y = y[i];
+		keys[i].id = i;
 	}
+	qsort(keys, count, sizeof(struct locationKey), compareLocation);
 
-	//Read all points the 1st time to get the number of points in each block
-	
-	for(int i = 0; i < nBlockY * nBlockX; i++)
+	//the later points of a location give their weight to the first one and are left with none
+	int first = 0;
+	for(int k = 1; k < count; k++)
 	{
-		pointsInB[i] = 0;
+		if(keys[k].x == keys[first].x && keys[k].y == keys[first].y)
+		{
+			weight[keys[first].id] += weight[keys[k].id];
+			weight[keys[k].id] = 0;
+		}
+		else
+			first = k;
 	}
+	free(keys);
 
-	int rowID, colID;
-	int blockID;
+	int n = 0;
 	for(int i = 0; i < count; i++)
 	{
-		colID = (int)((x[i] - xMin) / blockSize);
-		rowID = (int)((y[i] - yMin) / blockSize);
-		blockID = colID + rowID * nBlockX;
+		if(weight[i] == 0)
+			continue;
+		x[n] = x[i];
+		y[n] = y[i];
+		weight[n] = weight[i];
+		n ++;
+	}
+	return n;
+}
+
+struct blockKey {
+	unsigned long long key;
+	int id;
+};
 
-		pointsInB[blockID] ++;
+/**
+ * NAME:	compareBlockKey
+ * DESCRIPTION:	compare two curve keys for qsort, ties are broken by the ID so that the order is stable
+ */
+static int compareBlockKey(const void * a, const void * b)
+{
+	const struct blockKey * ka = (const struct blockKey *)a;
+	const struct blockKey * kb = (const struct blockKey *)b;
+	if(ka->key != kb->key)
+		return (ka->key < kb->key) ? -1 : 1;
+	return ka->id - kb->id;
+}
+
+/**
+ * NAME:	curveKey
+ * DESCRIPTION:	get the position of a cell along a space-filling curve covering a (2^bits * 2^bits) lattice. for both curves the key of a cell on a fine lattice, shifted right by 2 bits per level, is the key of its containing cell on a coarser lattice, so cells and the points in them can be ordered consistently
+ * PARAMETERS:
+ * 	unsigned int col:	the column of the cell
+ * 	unsigned int row:	the row of the cell
+ * 	int bits:			the number of bits of each coordinate
+ * 	int order:			ORDER_MORTON or ORDER_HILBERT
+ * RETURN:
+ * 	TYPE:	unsigned long long
+ * 	VALUE:	the position of the cell along the curve
+ */
+static unsigned long long curveKey(unsigned int col, unsigned int row, int bits, int order)
+{
+	unsigned long long key = 0;
+
+	if(order == ORDER_MORTON)
+	{
+		for(int b = 0; b < bits; b++)
+		{
+			key |= (unsigned long long)((col >> b) & 1) << (2 * b);
+			key |= (unsigned long long)((row >> b) & 1) << (2 * b + 1);
+		}
+		return key;
 	}
 
-	index[0] = 0;
-	for(int i = 1; i < nBlockY * nBlockX + 1; i++)
+	unsigned long long n = 1ULL << bits;
+	unsigned long long cx = col, cy = row, t;
+	unsigned long long rx, ry;
+	for(unsigned long long s = n / 2; s > 0; s /= 2)
 	{
-		index[i] = index[i - 1] + pointsInB[i - 1];
+		rx = (cx & s) > 0;
+		ry = (cy & s) > 0;
+		key += s * s * ((3 * rx) ^ ry);
+		//rotate the quadrant so that the curve stays continuous
+		if(ry == 0)
+		{
+			if(rx == 1)
+			{
+				cx = n - 1 - cx;
+				cy = n - 1 - cy;
+			}
+			t = cx;
+			cx = cy;
+			cy = t;
+		}
 	}
+	return key;
+}
 
-	//Read all points the 2nd time to fill these points in the new array
+/**
+ * NAME:	pointCurveKey
+ * DESCRIPTION:	get the curve key of a point on a lattice 2^subBits times finer than the index blocks, so that sorting the points of a block by their keys puts them along the curve
+ * PARAMETERS:
+ * 	double x:			the X value of the point
+ * 	double y:			the Y value of the point
+ * 	double xMin:		the minimum X of all points
+ * 	double yMin:		the minimum Y of all points
+ * 	double blockSize:	the side length of a block
+ * 	int colID:			the column of the block of the point
+ * 	int rowID:			the row of the block of the point
+ * 	int bits:			the number of bits of the block columns and rows
+ * 	int subBits:		the number of bits of the lattice within a block
+ * 	int curve:			ORDER_MORTON or ORDER_HILBERT
+ * RETURN:
+ * 	TYPE:	unsigned long long
+ * 	VALUE:	the position of the point along the curve
+ */
+static unsigned long long pointCurveKey(double x, double y, double xMin, double yMin, double blockSize, int colID, int rowID, int bits, int subBits, int curve)
+{
+	double subSize = blockSize / (1 << subBits);
+	unsigned int subMax = (1U << subBits) - 1;
+	unsigned int subX, subY;
+	double fx = (x - xMin - colID * blockSize) / subSize;
+	double fy = (y - yMin - rowID * blockSize) / subSize;
+	subX = (fx <= 0) ? 0 : ((fx >= subMax) ? subMax : (unsigned int)fx);
+	subY = (fy <= 0) ? 0 : ((fy >= subMax) ? subMax : (unsigned int)fy);
+	return curveKey(((unsigned int)colID << subBits) | subX, ((unsigned int)rowID << subBits) | subY, bits + subBits, curve);
+}
 
-	//From this time, pointsInB is used to store the index of next-to-fill points in each block
-	pointsInB[0] = 0;
-	for(int i = 1; i < nBlockY * nBlockX; i++)
+/**
+ * NAME:	buildStencil
+ * DESCRIPTION:	list the offsets of the blocks that may hold points within the search radius of a point in a block. with blocks of side radius / k, points of blocks whose gap is (gx, gy) blocks are farther apart than the radius when gx * gx + gy * gy >= k * k, and every pair of points of blocks whose far sides are (fx, fy) blocks apart is within the radius when fx * fx + fy * fy <= k * k
+ * PARAMETERS:
+ * 	struct gridIndex * g:	the index, with subdivide set
+ * RETURN: none
+ */
+static void buildStencil(struct gridIndex * g)
+{
+	int k = g->subdivide;
+	int gx, gy, n;
+
+	if(NULL == (g->stencilCol = (int *)malloc(sizeof(int) * (2 * k + 1) * (2 * k + 1))))
 	{
-		pointsInB[i] = index[i];
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
 	}
-
-	for(int i = 0; i < count; i++)
+	if(NULL == (g->stencilRow = (int *)malloc(sizeof(int) * (2 * k + 1) * (2 * k + 1))))
 	{
-		colID = (int)((x[i] - xMin) / blockSize);
-		rowID = (int)((y[i] - yMin) / blockSize);
-		blockID = colID + rowID * nBlockX;
-		newX[pointsInB[blockID]] = x[i];
-		newY[pointsInB[blockID]] = y[i];
-		pointsInB[blockID] ++;
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (g->stencilIn = (bool *)malloc(sizeof(bool) * (2 * k + 1) * (2 * k + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
 	}
-	
-
-	free(pointsInB);
-	free(x);
-	free(y);
 
+	n = 0;
+	for(int row = -k; row <= k; row ++)
+	{
+		for(int col = -k; col <= k; col ++)
+		{
+			gx = (col < 0 ? -col : col) - 1;
+			gy = (row < 0 ? -row : row) - 1;
+			gx = (gx < 0) ? 0 : gx;
+			gy = (gy < 0) ? 0 : gy;
+			if(gx * gx + gy * gy >= k * k)
+				continue;
+			gx = (col < 0 ? -col : col) + 1;
+			gy = (row < 0 ? -row : row) + 1;
+			g->stencilCol[n] = col;
+			g->stencilRow[n] = row;
+			g->stencilIn[n] = (gx * gx + gy * gy <= k * k);
+			n ++;
+		}
+	}
+	g->nStencil = n;
+}
 
-	x = newX;
-	y = newY;
+/**
+ * NAME:	newQuadNodes
+ * DESCRIPTION:	add nodes to the quadtrees of an index, growing the node arrays as needed
+ * PARAMETERS:
+ * 	struct gridIndex * g:	the index
+ * 	int n:			the number of nodes to add
+ * 	int * pCap:		the capacity of the node arrays, updated when they grow
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the index of the first new node
+ */
+static int newQuadNodes(struct gridIndex * g, int n, int * pCap)
+{
+	if(g->nQuad + n > *pCap)
+	{
+		*pCap = (*pCap == 0) ? 256 : (*pCap * 2);
+		if(NULL == (g->quadStart = (int *)realloc(g->quadStart, sizeof(int) * *pCap)))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		if(NULL == (g->quadEnd = (int *)realloc(g->quadEnd, sizeof(int) * *pCap)))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		if(NULL == (g->quadChild = (int *)realloc(g->quadChild, sizeof(int) * *pCap)))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+	}
+	g->nQuad += n;
+	return g->nQuad - n;
+}
 
+/**
+ * NAME:	splitQuad
+ * DESCRIPTION:	split a quadtree node into its four quadrants, and those in turn, until they hold at most QUAD_LEAF_POINTS points or reach the finest lattice. the points of the node must be sorted by their curve keys, so the quadrant of level + 1 is the next 2 bits of the keys below the block
+ * PARAMETERS:
+ * 	struct gridIndex * g:	the index
+ * 	int * pCap:		the capacity of the node arrays
+ * 	struct blockKey * keys:	the sorted curve keys of the points
+ * 	int node:		the node to split
+ * 	int level:		the level of the node, 0 for the block itself
+ * 	int subBits:	the number of levels of the lattice within a block
+ * RETURN: none
+ */
+static void splitQuad(struct gridIndex * g, int * pCap, struct blockKey * keys, int node, int level, int subBits)
+{
+	int start = g->quadStart[node];
+	int end = g->quadEnd[node];
+	if(end - start <= QUAD_LEAF_POINTS || level >= subBits)
+		return;
 
-	return index;
+	int shift = 2 * (subBits - level - 1);
+	int child = newQuadNodes(g, 4, pCap);
+	int i = start;
+	g->quadChild[node] = child;
+	for(int c = 0; c < 4; c++)
+	{
+		g->quadStart[child + c] = i;
+		while(i < end && (int)((keys[i].key >> shift) & 3) == c)
+			i ++;
+		g->quadEnd[child + c] = i;
+		g->quadChild[child + c] = -1;
+	}
+	for(int c = 0; c < 4; c++)
+		splitQuad(g, pCap, keys, child + c, level + 1, subBits);
 }
 
 /**
- * NAME:	indexPoints
- * DESCRIPTION:	index all points based on the block they falls in. the points will be re-ordered based on their blocksIDs accendingly. a seperate index table is created to store the ending array index (in the re-ordered array x, y and indicator) of points in each block.
+ * NAME:	buildIndex
+ * DESCRIPTION:	assign all points to index blocks and work out where each block and each point will be stored. blocks are stored in row-major order, or along a Morton or Hilbert curve; in the latter case the points in each block are also sorted along the same curve on a finer lattice. with the row-major order the points in each block keep their input order, except in blocks of more than QUAD_MIN_POINTS points, which are sorted along the Morton curve to give them a local quadtree
  * PARAMETERS:
- * 	double * &x: 		array points' X values, will be changed to a new array of ordered points
- * 	double * &y: 		array points' Y values, will be changed to a new array of ordered points
- * 	int * &ind: 		array points' indicator values, will be changed to a new array of ordered points
+ * 	double * x: 		array points' X values
+ * 	double * y: 		array points' Y values
  * 	int count:			the total number of points
- * 	double xMin:		the minimum X of all points, used to calculate the blockID of each point
- * 	double yMin:		the minimum Y of all points, used to calculate the blockID of each point
- * 	int nBlockX:		the number of index blocks along X dimension
- * 	int nBlockY:		the number of index blocks along Y dimension
- * 	double blockSize:	the size (side length) of each index block
+ * 	double xMin:		the minimum X of all points
+ * 	double yMin:		the minimum Y of all points
+ * 	double xMax:		the maximum X of all points
+ * 	double yMax:		the maximum Y of all points
+ * 	double radius:		the search radius
+ * 	int subdivide:		the number of index blocks per search radius, each block has a side length of radius / subdivide
+ * 	int order:			ORDER_ROW, ORDER_MORTON or ORDER_HILBERT
+ * 	int ** pPerm:		output, the original array index of the point to be stored at each position
  * RETURN:
- * 	TYPE:	int *
- * 	VALUE:	an array with a length equal to (the total number of index blocks + 1), storing the starting and ending array index of points in each block
+ * 	TYPE:	struct gridIndex *
+ * 	VALUE:	the index of all points
  */
-int * indexPoints(double * &x, double * &y, int * &ind, int count, double xMin, double yMin, int nBlockX, int nBlockY, double blockSize)
+static struct gridIndex * buildIndex(double * x, double * y, int count, double xMin, double yMin, double xMax, double yMax, double radius, int subdivide, int order, int ** pPerm)
 {
-	int * index;
+	double blockSize = radius / subdivide;
+	struct gridIndex * g;
 	int * pointsInB;
+	int * blockOfP;
+	int * perm;
 
-	double * newX;
-	double * newY;
-	int * newInd;
-	
-	if(NULL == (index = (int *)malloc(sizeof(int) * (nBlockY * nBlockX + 1))))
+	if(NULL == (g = (struct gridIndex *)malloc(sizeof(struct gridIndex))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	g->count = count;
+	g->nBlockX = (int)((xMax - xMin) / blockSize) + 1;
+	g->nBlockY = (int)((yMax - yMin) / blockSize) + 1;
+	g->blockSize = blockSize;
+	g->subdivide = subdivide;
+	g->xMin = xMin;
+	g->yMin = yMin;
+	g->order = order;
+	g->bxMin = NULL;
+	g->byMin = NULL;
+	g->bxMax = NULL;
+	g->byMax = NULL;
+	g->nQuad = 0;
+	g->quadStart = NULL;
+	g->quadEnd = NULL;
+	g->quadChild = NULL;
+	g->qxMin = NULL;
+	g->qyMin = NULL;
+	g->qxMax = NULL;
+	g->qyMax = NULL;
+	buildStencil(g);
+
+	int nBlockX = g->nBlockX;
+	int nBlockY = g->nBlockY;
+	int nBlocks = nBlockX * nBlockY;
+
+	if(NULL == (g->blocks = (int *)malloc(sizeof(int) * nBlocks)))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	if(NULL == (pointsInB = (int *)malloc(sizeof(int) * nBlockY * nBlockX)))
+	if(NULL == (g->start = (int *)malloc(sizeof(int) * nBlocks)))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-
-	if(NULL == (newX = (double *)malloc(sizeof(double) * count)))
+	if(NULL == (g->end = (int *)malloc(sizeof(int) * nBlocks)))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	if(NULL == (newY = (double *)malloc(sizeof(double) * count)))
+	if(NULL == (g->quadRoot = (int *)malloc(sizeof(int) * nBlocks)))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	if(NULL == (newInd = (int *)malloc(sizeof(int) * count)))
+	if(NULL == (pointsInB = (int *)malloc(sizeof(int) * nBlocks)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (blockOfP = (int *)malloc(sizeof(int) * count)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (perm = (int *)malloc(sizeof(int) * count)))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
 
 	//Read all points the 1st time to get the number of points in each block
-	
-	for(int i = 0; i < nBlockY * nBlockX; i++)
+
+	for(int i = 0; i < nBlocks; i++)
 	{
 		pointsInB[i] = 0;
 	}
 
 	int rowID, colID;
-	int blockID;
 	for(int i = 0; i < count; i++)
 	{
 		colID = (int)((x[i] - xMin) / blockSize);
 		rowID = (int)((y[i] - yMin) / blockSize);
-		blockID = colID + rowID * nBlockX;
+		blockOfP[i] = colID + rowID * nBlockX;
 
-		pointsInB[blockID] ++;
+		pointsInB[blockOfP[i]] ++;
 	}
 
-	index[0] = 0;
-	for(int i = 1; i < nBlockY * nBlockX + 1; i++)
+	//Order the blocks
+
+	int bits = 0;
+	while((1 << bits) < nBlockX || (1 << bits) < nBlockY)
+		bits ++;
+
+	if(order == ORDER_ROW)
+	{
+		for(int i = 0; i < nBlocks; i++)
+			g->blocks[i] = i;
+	}
+	else
+	{
+		struct blockKey * keys;
+		if(NULL == (keys = (struct blockKey *)malloc(sizeof(struct blockKey) * nBlocks)))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		for(int i = 0; i < nBlocks; i++)
+		{
+			keys[i].key = curveKey(i % nBlockX, i / nBlockX, bits, order);
+			keys[i].id = i;
+		}
+		qsort(keys, nBlocks, sizeof(struct blockKey), compareBlockKey);
+		for(int i = 0; i < nBlocks; i++)
+			g->blocks[i] = keys[i].id;
+		free(keys);
+	}
+
+	int nextP = 0;
+	for(int i = 0; i < nBlocks; i++)
 	{
-		index[i] = index[i - 1] + pointsInB[i - 1];
+		g->start[g->blocks[i]] = nextP;
+		nextP += pointsInB[g->blocks[i]];
+		g->end[g->blocks[i]] = nextP;
 	}
 
-	//Read all points the 2nd time to fill these points in the new array
+	//Read all points the 2nd time to fill these points in the new order
 
 	//From this time, pointsInB is used to store the index of next-to-fill points in each block
-	pointsInB[0] = 0;
-	for(int i = 1; i < nBlockY * nBlockX; i++)
+	for(int i = 0; i < nBlocks; i++)
 	{
-		pointsInB[i] = index[i];
+		pointsInB[i] = g->start[i];
 	}
 
 	for(int i = 0; i < count; i++)
 	{
-		colID = (int)((x[i] - xMin) / blockSize);
-		rowID = (int)((y[i] - yMin) / blockSize);
-		blockID = colID + rowID * nBlockX;
-		newX[pointsInB[blockID]] = x[i];
-		newY[pointsInB[blockID]] = y[i];
-		newInd[pointsInB[blockID]] = ind[i];
-		pointsInB[blockID] ++;
+		perm[pointsInB[blockOfP[i]]] = i;
+		pointsInB[blockOfP[i]] ++;
+	}
+
+	//Sort the points in each block along the curve on a lattice 2^subBits times finer than the blocks. with the row-major order only the blocks that get a quadtree are sorted, along the Morton curve
+
+	int quadCap = 0;
+	bool sortAny = (order != ORDER_ROW);
+	for(int b = 0; b < nBlocks; b++)
+	{
+		g->quadRoot[b] = -1;
+		if(g->end[b] - g->start[b] > QUAD_MIN_POINTS)
+			sortAny = true;
+	}
+
+	if(sortAny)
+	{
+		int subBits = (bits > 16) ? (32 - bits) : 16;
+		int curve = (order == ORDER_ROW) ? ORDER_MORTON : order;
+		struct blockKey * keys;
+
+		if(NULL == (keys = (struct blockKey *)malloc(sizeof(struct blockKey) * count)))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+
+		for(int b = 0; b < nBlocks; b++)
+		{
+			if(order == ORDER_ROW && g->end[b] - g->start[b] <= QUAD_MIN_POINTS)
+				continue;
+			colID = b % nBlockX;
+			rowID = b / nBlockX;
+			for(int i = g->start[b]; i < g->end[b]; i++)
+			{
+				keys[i].key = pointCurveKey(x[perm[i]], y[perm[i]], xMin, yMin, blockSize, colID, rowID, bits, subBits, curve);
+				keys[i].id = perm[i];
+			}
+			qsort(keys + g->start[b], g->end[b] - g->start[b], sizeof(struct blockKey), compareBlockKey);
+			for(int i = g->start[b]; i < g->end[b]; i++)
+				perm[i] = keys[i].id;
+
+			//the points of every quadrant of the block, at any level, are now contiguous
+			if(g->end[b] - g->start[b] > QUAD_MIN_POINTS)
+			{
+				g->quadRoot[b] = newQuadNodes(g, 1, &quadCap);
+				g->quadStart[g->quadRoot[b]] = g->start[b];
+				g->quadEnd[g->quadRoot[b]] = g->end[b];
+				g->quadChild[g->quadRoot[b]] = -1;
+				splitQuad(g, &quadCap, keys, g->quadRoot[b], 0, subBits);
+			}
+		}
+		free(keys);
 	}
-	
 
 	free(pointsInB);
-	free(x);
-	free(y);
-	free(ind);
+	free(blockOfP);
+
+	*pPerm = perm;
+	return g;
+}
+
+/**
+ * NAME:	permute
+ * DESCRIPTION:	re-order an array by a permutation, the old array is freed and replaced with the new one
+ * PARAMETERS:
+ * 	T * &a:		the array to re-order
+ * 	int * perm:	the old array index of the element to be stored at each position
+ * 	int count:	the length of the array
+ * RETURN: none
+ */
+template <typename T>
+static void permute(T * &a, int * perm, int count)
+{
+	T * newA;
+	if(NULL == (newA = (T *)allocArray(sizeof(T) * count)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int i = 0; i < count; i++)
+	{
+		newA[i] = a[perm[i]];
+	}
+	free(a);
+	a = newA;
+}
+
+/**
+ * NAME:	indexPoints
+ * DESCRIPTION:	index all points based on the block they falls in. the points will be re-ordered based on their blocks, in row-major order or along a space-filling curve. a seperate index table is created to store the starting and ending array index (in the re-ordered array x and y) of points in each block.
+ * PARAMETERS:
+ * 	double * &x: 		array points' X values, will be changed to a new array of ordered points
+ * 	double * &y: 		array points' Y values, will be changed to a new array of ordered points
+ * 	int count:			the total number of points
+ * 	double xMin:		the minimum X of all points, used to calculate the blockID of each point
+ * 	double yMin:		the minimum Y of all points, used to calculate the blockID of each point
+ * 	double xMax:		the maximum X of all points, used to calculate the number of blocks
+ * 	double yMax:		the maximum Y of all points, used to calculate the number of blocks
+ * 	double radius:		the search radius
+ * 	int subdivide:		the number of index blocks per search radius
+ * 	int order:			ORDER_ROW, ORDER_MORTON or ORDER_HILBERT
+ * RETURN:
+ * 	TYPE:	struct gridIndex *
+ * 	VALUE:	the index, storing the number of blocks and the starting and ending array index of points in each block
+ */
+struct gridIndex * indexPoints(double * &x, double * &y, int count, double xMin, double yMin, double xMax, double yMax, double radius, int subdivide, int order)
+{
+	int * perm;
+	struct gridIndex * g = buildIndex(x, y, count, xMin, yMin, xMax, yMax, radius, subdivide, order, &perm);
+
+	permute(x, perm, count);
+	permute(y, perm, count);
+
+	free(perm);
+	return g;
+}
+
+/**
+ * NAME:	indexPoints
+ * DESCRIPTION:	index all points based on the block they falls in. the points will be re-ordered based on their blocks, in row-major order or along a space-filling curve. a seperate index table is created to store the starting and ending array index (in the re-ordered array x, y and indicator) of points in each block.
+ * PARAMETERS:
+ * 	double * &x: 		array points' X values, will be changed to a new array of ordered points
+ * 	double * &y: 		array points' Y values, will be changed to a new array of ordered points
+ * 	int * &ind: 		array points' indicator values, will be changed to a new array of ordered points
+ * 	(the other parameters are the same as above)
+ * RETURN:
+ * 	TYPE:	struct gridIndex *
+ * 	VALUE:	the index, storing the number of blocks and the starting and ending array index of points in each block
+ */
+struct gridIndex * indexPoints(double * &x, double * &y, int * &ind, int count, double xMin, double yMin, double xMax, double yMax, double radius, int subdivide, int order)
+{
+	int * weight = NULL;
+	return indexPoints(x, y, ind, weight, count, xMin, yMin, xMax, yMax, radius, subdivide, order);
+}
+
+/**
+ * NAME:	indexPoints
+ * DESCRIPTION:	index all points based on the block they falls in, re-ordering their indicators and weights along with them
+ * PARAMETERS:
+ * 	int * &ind: 		array points' indicator values, will be changed to a new array of ordered points (NULL: the points have no types)
+ * 	int * &weight: 		array points' weights, will be changed to a new array of ordered points (NULL: the points have no weights)
+ * 	(the other parameters are the same as above)
+ * RETURN:
+ * 	TYPE:	struct gridIndex *
+ * 	VALUE:	the index, storing the number of blocks and the starting and ending array index of points in each block
+ */
+struct gridIndex * indexPoints(double * &x, double * &y, int * &ind, int * &weight, int count, double xMin, double yMin, double xMax, double yMax, double radius, int subdivide, int order)
+{
+	int * perm;
+	struct gridIndex * g = buildIndex(x, y, count, xMin, yMin, xMax, yMax, radius, subdivide, order, &perm);
+
+	permute(x, perm, count);
+	permute(y, perm, count);
+	if(ind != NULL)
+		permute(ind, perm, count);
+	if(weight != NULL)
+		permute(weight, perm, count);
+
+	free(perm);
+	return g;
+}
+
+/**
+ * NAME:	storageKey
+ * DESCRIPTION:	get the position a point takes in the storage order of indexPoints over all points, without indexing them: points are stored by the key of their block, then by their key within the block, then in input order. lets points that are processed part by part be taken in the same order as by one index of them all
+ * PARAMETERS:
+ * 	double x:			the X value of the point
+ * 	double y:			the Y value of the point
+ * 	int blockCount:		the number of points in the block of the point
+ * 	unsigned long long * blockKey:	output, the key of the block
+ * 	unsigned long long * pointKey:	output, the key of the point within the block
+ * 	(the other parameters are the same as indexPoints)
+ * RETURN: none
+ */
+void storageKey(double x, double y, double xMin, double yMin, double xMax, double yMax, double radius, int subdivide, int order, int blockCount, unsigned long long * blockKey, unsigned long long * pointKey)
+{
+	double blockSize = radius / subdivide;
+	int nBlockX = (int)((xMax - xMin) / blockSize) + 1;
+	int nBlockY = (int)((yMax - yMin) / blockSize) + 1;
+	int colID = (int)((x - xMin) / blockSize);
+	int rowID = (int)((y - yMin) / blockSize);
 
+	int bits = 0;
+	while((1 << bits) < nBlockX || (1 << bits) < nBlockY)
+		bits ++;
+	int subBits = (bits > 16) ? (32 - bits) : 16;
 
-	x = newX;
-	y = newY;
-	ind = newInd;
+	if(order == ORDER_ROW)
+		*blockKey = (unsigned long long)rowID * nBlockX + colID;
+	else
+		*blockKey = curveKey(colID, rowID, bits, order);
 
-	return index;
+	if(order == ORDER_ROW && blockCount <= QUAD_MIN_POINTS)
+		*pointKey = 0;
+	else
+		*pointKey = pointCurveKey(x, y, xMin, yMin, blockSize, colID, rowID, bits, subBits, (order == ORDER_ROW) ? ORDER_MORTON : order);
+}
+
+/**
+ * NAME:	blockOfPoint
+ * DESCRIPTION:	find the block a stored point falls in from its array index, so that the block is always the one the point was indexed in, whatever precision its coordinates are kept in
+ * PARAMETERS:
+ * 	struct gridIndex * g:	the index of all points
+ * 	int i:					the array index of the point
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the (row-major) ID of the block
+ */
+int blockOfPoint(struct gridIndex * g, int i)
+{
+	//find the last block in storage order that starts at or before i
+	int lo = 0;
+	int hi = g->nBlockX * g->nBlockY - 1;
+	int mid;
+	while(lo < hi)
+	{
+		mid = (lo + hi + 1) / 2;
+		if(g->start[g->blocks[mid]] <= i)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return g->blocks[lo];
+}
+
+/**
+ * NAME:	blockWeight
+ * DESCRIPTION:	get the total weight of the points in a block
+ * PARAMETERS:
+ * 	struct gridIndex * g:	the index of all points
+ * 	int * weight:			points' weights (NULL: every point counts once)
+ * 	int blockID:			the (row-major) ID of the block
+ * RETURN:
+ * 	TYPE:	long long
+ * 	VALUE:	the total weight
+ */
+static long long blockWeight(struct gridIndex * g, int * weight, int blockID)
+{
+	if(weight == NULL)
+		return g->end[blockID] - g->start[blockID];
+	long long sum = 0;
+	for(int i = g->start[blockID]; i < g->end[blockID]; i++)
+		sum += weight[i];
+	return sum;
+}
+
+/**
+ * NAME:	maxStencilCount
+ * DESCRIPTION:	get the largest number of points in the (2 * subdivide + 1) * (2 * subdivide + 1) blocks around any block, which covers the search stencil and so bounds the number of points within the search radius of any point
+ * PARAMETERS:
+ * 	struct gridIndex * g:	the index of all points
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the largest number of points in any search stencil
+ */
+int maxStencilCount(struct gridIndex * g)
+{
+	return maxStencilCount(g, NULL);
+}
+
+/**
+ * NAME:	maxStencilCount
+ * DESCRIPTION:	get the largest total weight of the points in the (2 * subdivide + 1) * (2 * subdivide + 1) blocks around any block, which bounds the weighted count within the search radius of any point
+ * PARAMETERS:
+ * 	struct gridIndex * g:	the index of all points
+ * 	int * weight:			points' weights (NULL: every point counts once)
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the largest total weight in any search stencil
+ */
+int maxStencilCount(struct gridIndex * g, int * weight)
+{
+	int nBlockX = g->nBlockX;
+	int nBlockY = g->nBlockY;
+	int k = g->subdivide;
+	long long sum;
+	long long maxSum = 0;
+	long long * colSum;
+	int blockID;
+
+	//the number of points in the 2 * k + 1 blocks of each column around the current row
+	if(NULL == (colSum = (long long *)calloc(nBlockX, sizeof(long long))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int row = 0; row < k && row < nBlockY; row ++)
+	{
+		for(int col = 0; col < nBlockX; col ++)
+		{
+			blockID = row * nBlockX + col;
+			colSum[col] += blockWeight(g, weight, blockID);
+		}
+	}
+
+	for(int rowID = 0; rowID < nBlockY; rowID ++)
+	{
+		for(int col = 0; col < nBlockX; col ++)
+		{
+			if(rowID + k < nBlockY)
+			{
+				blockID = (rowID + k) * nBlockX + col;
+				colSum[col] += blockWeight(g, weight, blockID);
+			}
+			if(rowID - k - 1 >= 0)
+			{
+				blockID = (rowID - k - 1) * nBlockX + col;
+				colSum[col] -= blockWeight(g, weight, blockID);
+			}
+		}
+		sum = 0;
+		for(int col = 0; col < k && col < nBlockX; col ++)
+			sum += colSum[col];
+		for(int colID = 0; colID < nBlockX; colID ++)
+		{
+			if(colID + k < nBlockX)
+				sum += colSum[colID + k];
+			if(colID - k - 1 >= 0)
+				sum -= colSum[colID - k - 1];
+			if(sum > maxSum)
+				maxSum = sum;
+		}
+	}
+	free(colSum);
+	return (maxSum > INT_MAX) ? INT_MAX : (int)maxSum;
+}
+
+/**
+ * NAME:	freeGridIndex
+ * DESCRIPTION:	free an index
+ * PARAMETERS:
+ * 	struct gridIndex * g: the index to free
+ * RETURN: none
+ */
+void freeGridIndex(struct gridIndex * g)
+{
+	if(g == NULL)
+		return;
+	free(g->blocks);
+	free(g->start);
+	free(g->end);
+	free(g->bxMin);
+	free(g->byMin);
+	free(g->bxMax);
+	free(g->byMax);
+	free(g->stencilCol);
+	free(g->stencilRow);
+	free(g->stencilIn);
+	free(g->quadRoot);
+	free(g->quadStart);
+	free(g->quadEnd);
+	free(g->quadChild);
+	free(g->qxMin);
+	free(g->qyMin);
+	free(g->qxMax);
+	free(g->qyMax);
+	free(g);
+}
+
+/**
+ * NAME:	parseOrder
+ * DESCRIPTION:	convert the name of a block order to its code
+ * PARAMETERS:
+ * 	const char * name: "row", "morton" or "hilbert"
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	ORDER_ROW, ORDER_MORTON, ORDER_HILBERT, or -1 if the name is unknown
+ */
+int parseOrder(const char * name)
+{
+	if(strcmp(name, "row") == 0)
+		return ORDER_ROW;
+	if(strcmp(name, "morton") == 0)
+		return ORDER_MORTON;
+	if(strcmp(name, "hilbert") == 0)
+		return ORDER_HILBERT;
+	return -1;
+}
+
+/**
+ * NAME:	pickSubdivide
+ * DESCRIPTION:	choose the number of index blocks per search radius from the density of the points. the density is the number of points in the radius-sized block of an average point, so dense clusters count for the points in them, and blocks are made small enough to hold about SUBDIVIDE_TARGET such points, but the grid is kept to a few blocks per point
+ * PARAMETERS:
+ * 	double * x: 		array points' X values
+ * 	double * y: 		array points' Y values
+ * 	(the other parameters are the same as indexPoints)
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the number of blocks per search radius, 1 to MAX_SUBDIVIDE
+ */
+int pickSubdivide(double * x, double * y, int count, double xMin, double yMin, double xMax, double yMax, double radius)
+{
+	int nBlockX = (int)((xMax - xMin) / radius) + 1;
+	int nBlockY = (int)((yMax - yMin) / radius) + 1;
+	int * pointsInB;
+	double density = 0;
+
+	if(count == 0)
+		return 1;
+	if(NULL == (pointsInB = (int *)calloc((size_t)nBlockX * nBlockY, sizeof(int))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int i = 0; i < count; i++)
+	{
+		pointsInB[(int)((y[i] - yMin) / radius) * nBlockX + (int)((x[i] - xMin) / radius)] ++;
+	}
+	for(int i = 0; i < nBlockX * nBlockY; i++)
+	{
+		density += (double)pointsInB[i] * pointsInB[i];
+	}
+	free(pointsInB);
+
+	return subdivideForDensity(density / count, count, xMin, yMin, xMax, yMax, radius);
+}
+
+/**
+ * NAME:	subdivideForDensity
+ * DESCRIPTION:	choose the number of index blocks per search radius for pickSubdivide, once the density is known
+ * PARAMETERS:
+ * 	double density:		the number of points in the radius-sized block of an average point
+ * 	(the other parameters are the same as pickSubdivide)
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the number of blocks per search radius, 1 to MAX_SUBDIVIDE
+ */
+int subdivideForDensity(double density, int count, double xMin, double yMin, double xMax, double yMax, double radius)
+{
+	int k;
+
+	for(k = 1; k < MAX_SUBDIVIDE; k ++)
+	{
+		if(density / ((k + 1) * (k + 1)) < SUBDIVIDE_TARGET)
+			break;
+		if((double)((int)((xMax - xMin) * (k + 1) / radius) + 1) * ((int)((yMax - yMin) * (k + 1) / radius) + 1) > 4.0 * count)
+			break;
+	}
+	return k;
+}
+
+/**
+ * NAME:	parseSubdivide
+ * DESCRIPTION:	convert the value of -subdivide
+ * PARAMETERS:
+ * 	const char * name: "auto" or a number of blocks per search radius
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	0 for auto, 1 to MAX_SUBDIVIDE, or -1 if the value is invalid
+ */
+int parseSubdivide(const char * name)
+{
+	if(strcmp(name, "auto") == 0)
+		return 0;
+	int k = atoi(name);
+	if(k < 1 || k > MAX_SUBDIVIDE)
+		return -1;
+	return k;
 }
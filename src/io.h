@@ -1,9 +1,309 @@
 #ifndef IOH
 #define IOH
 
+#define ORDER_ROW 0
+#define ORDER_MORTON 1
+#define ORDER_HILBERT 2
+
+//the largest number of index blocks per search radius, and the most blocks in the search stencil
+#define MAX_SUBDIVIDE 8
+#define MAX_STENCIL ((2 * MAX_SUBDIVIDE + 1) * (2 * MAX_SUBDIVIDE + 1))
+//the number of points in a block that -subdivide auto aims for
+#define SUBDIVIDE_TARGET 16
+//blocks of more points than QUAD_MIN_POINTS get a local quadtree, which is split down to QUAD_LEAF_POINTS points per node
+#define QUAD_MIN_POINTS 256
+#define QUAD_LEAF_POINTS 32
+//the deepest stack of nodes a walk through a quadtree of at most 16 levels can need
+#define QUAD_STACK 64
+
+struct gridIndex {
+	int count;
+	int nBlockX;
+	int nBlockY;
+	double blockSize;	//the search radius divided by subdivide
+	int subdivide;
+	double xMin;
+	double yMin;
+	int order;
+	int * blocks;
+	int * start;
+	int * end;
+	//the tight bounding box of the points in each block, in the units of the point store (NULL until boundBlocks is called)
+	double * bxMin;
+	double * byMin;
+	double * bxMax;
+	double * byMax;
+	//the offsets of the blocks that may hold points within the search radius of a block, in row-major order, so the block itself is in the middle and the blocks after it are the forward half. blocks marked inside are entirely within the radius of any point of the block
+	int nStencil;
+	int * stencilCol;
+	int * stencilRow;
+	bool * stencilIn;
+	//a local quadtree over each block of more than QUAD_MIN_POINTS points (quadRoot is -1 for the other blocks). each node holds a contiguous range of points, and a split node has four consecutive children starting at quadChild (-1 for leaves). the node bounds are set by boundBlocks
+	int * quadRoot;
+	int nQuad;
+	int * quadStart;
+	int * quadEnd;
+	int * quadChild;
+	double * qxMin;
+	double * qyMin;
+	double * qxMax;
+	double * qyMax;
+};
+
+//a walk through the points of a block near a query point, in ranges of points that are all or partly within the distance
+struct blockWalk {
+	int block;		//a block without a quadtree, walked as one range (-1 if none or done)
+	int stencil;	//the position of the block in the stencil
+	int rel;		//the relation of that block to the query point, if already known
+	int n;
+	int node[QUAD_STACK];
+};
+
+//how the points of an index block lie relative to a query point or block: none, some or all within the distance
+#define BLOCK_OUT 0
+#define BLOCK_PART 1
+#define BLOCK_IN 2
+//not tested yet
+#define BLOCK_UNKNOWN -1
+//blocks on the edge of the stencil with fewer points than this are cheaper to scan than to test
+#define BOUNDS_MIN_POINTS 4
+
+/**
+ * NAME:	boxToPoint
+ * DESCRIPTION:	test a bounding box against a point. the nearest and farthest box coordinates are subtracted as inDistance subtracts point coordinates, and rounding is monotone, so BLOCK_OUT and BLOCK_IN agree with inDistance for every point in the box
+ * PARAMETERS:
+ * 	T xMin, T yMin, T xMax, T yMax:	the box
+ * 	T x, T y:	the point
+ * 	D dist2:	the squared distance
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	BLOCK_OUT, BLOCK_PART or BLOCK_IN
+ */
+template <typename T, typename D>
+static inline int boxToPoint(T xMin, T yMin, T xMax, T yMax, T x, T y, D dist2)
+{
+	D dx, dy;
+
+	//the nearest point of the box
+	dx = (x < xMin) ? ((D)xMin - (D)x) : ((x > xMax) ? ((D)x - (D)xMax) : (D)0);
+	dy = (y < yMin) ? ((D)yMin - (D)y) : ((y > yMax) ? ((D)y - (D)yMax) : (D)0);
+	if(dist2 < dx * dx + dy * dy)
+		return BLOCK_OUT;
+
+	//the farthest corner of the box
+	dx = ((D)x - (D)xMin > (D)xMax - (D)x) ? ((D)x - (D)xMin) : ((D)xMax - (D)x);
+	dy = ((D)y - (D)yMin > (D)yMax - (D)y) ? ((D)y - (D)yMin) : ((D)yMax - (D)y);
+	if(dist2 >= dx * dx + dy * dy)
+		return BLOCK_IN;
+	return BLOCK_PART;
+}
+
+/**
+ * NAME:	blockToPoint
+ * DESCRIPTION:	test the bounding box of an index block against a point with boxToPoint
+ * PARAMETERS:
+ * 	struct gridIndex * g:	the index, with block bounds in the units of T
+ * 	int b:		the block ID
+ * 	T x, T y:	the point
+ * 	D dist2:	the squared distance
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	BLOCK_OUT, BLOCK_PART or BLOCK_IN (BLOCK_PART if the index has no bounds)
+ */
+template <typename T, typename D>
+static inline int blockToPoint(struct gridIndex * g, int b, T x, T y, D dist2)
+{
+	if(g->start[b] == g->end[b])
+		return BLOCK_OUT;
+	if(g->bxMin == NULL)
+		return BLOCK_PART;
+	return boxToPoint((T)g->bxMin[b], (T)g->byMin[b], (T)g->bxMax[b], (T)g->byMax[b], x, y, dist2);
+}
+
+/**
+ * NAME:	blockToBlock
+ * DESCRIPTION:	test the bounding boxes of two index blocks against each other, in the same way as blockToPoint
+ * PARAMETERS:
+ * 	struct gridIndex * gA:	the index of the first block, with block bounds in the units of T
+ * 	int a:		the first block ID
+ * 	struct gridIndex * gB:	the index of the second block, sharing the blocks and units of gA
+ * 	int b:		the second block ID
+ * 	D dist2:	the squared distance
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	BLOCK_OUT if no pair of points is within the distance, BLOCK_IN if every pair is, else BLOCK_PART
+ */
+template <typename T, typename D>
+static inline int blockToBlock(struct gridIndex * gA, int a, struct gridIndex * gB, int b, D dist2)
+{
+	if(gA->start[a] == gA->end[a] || gB->start[b] == gB->end[b])
+		return BLOCK_OUT;
+	if(gA->bxMin == NULL || gB->bxMin == NULL)
+		return BLOCK_PART;
+
+	D axMin = (D)(T)gA->bxMin[a];
+	D ayMin = (D)(T)gA->byMin[a];
+	D axMax = (D)(T)gA->bxMax[a];
+	D ayMax = (D)(T)gA->byMax[a];
+	D bxMin = (D)(T)gB->bxMin[b];
+	D byMin = (D)(T)gB->byMin[b];
+	D bxMax = (D)(T)gB->bxMax[b];
+	D byMax = (D)(T)gB->byMax[b];
+	D dx, dy;
+
+	//the gap between the boxes
+	dx = (bxMin > axMax) ? (bxMin - axMax) : ((axMin > bxMax) ? (axMin - bxMax) : (D)0);
+	dy = (byMin > ayMax) ? (byMin - ayMax) : ((ayMin > byMax) ? (ayMin - byMax) : (D)0);
+	if(dist2 < dx * dx + dy * dy)
+		return BLOCK_OUT;
+
+	//the farthest pair of corners
+	dx = (bxMax - axMin > axMax - bxMin) ? (bxMax - axMin) : (axMax - bxMin);
+	dy = (byMax - ayMin > ayMax - byMin) ? (byMax - ayMin) : (ayMax - byMin);
+	if(dist2 >= dx * dx + dy * dy)
+		return BLOCK_IN;
+	return BLOCK_PART;
+}
+
+/**
+ * NAME:	stencilBlock
+ * DESCRIPTION:	find the block at an offset of the search stencil from a block
+ * PARAMETERS:
+ * 	struct gridIndex * g:	the index
+ * 	int colID, int rowID:	the column and row of the block
+ * 	int s:		the position in the stencil
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the (row-major) ID of the block at the offset, or -1 if it is outside the grid
+ */
+static inline int stencilBlock(struct gridIndex * g, int colID, int rowID, int s)
+{
+	int col = colID + g->stencilCol[s];
+	int row = rowID + g->stencilRow[s];
+	if(col < 0 || col >= g->nBlockX || row < 0 || row >= g->nBlockY)
+		return -1;
+	return row * g->nBlockX + col;
+}
+
+/**
+ * NAME:	stencilToPoint
+ * DESCRIPTION:	blockToPoint for the block at position s of the stencil, leaving small blocks on the edge of the stencil to be scanned
+ */
+template <typename T, typename D>
+static inline int stencilToPoint(struct gridIndex * g, int s, int b, T x, T y, D dist2)
+{
+	if(!g->stencilIn[s] && g->end[b] - g->start[b] < BOUNDS_MIN_POINTS)
+		return (g->start[b] == g->end[b]) ? BLOCK_OUT : BLOCK_PART;
+	return blockToPoint(g, b, x, y, dist2);
+}
+
+/**
+ * NAME:	stencilToBlock
+ * DESCRIPTION:	blockToBlock for a block and the block at position s of its stencil, leaving pairs of small blocks on the edge of the stencil to be scanned
+ */
+template <typename T, typename D>
+static inline int stencilToBlock(struct gridIndex * gA, int a, struct gridIndex * gB, int s, int b, D dist2)
+{
+	if(!gA->stencilIn[s] && (long long)(gA->end[a] - gA->start[a]) * (gB->end[b] - gB->start[b]) < BOUNDS_MIN_POINTS)
+		return (gA->start[a] == gA->end[a] || gB->start[b] == gB->end[b]) ? BLOCK_OUT : BLOCK_PART;
+	return blockToBlock<T>(gA, a, gB, b, dist2);
+}
+
+/**
+ * NAME:	startWalk
+ * DESCRIPTION:	start a walk through the block at position s of the stencil
+ * PARAMETERS:
+ * 	struct gridIndex * g:	the index
+ * 	int s:		the position in the stencil
+ * 	int b:		the block ID
+ * 	int rel:	the relation of the block to the query point if the caller has tested it, else BLOCK_UNKNOWN
+ * 	struct blockWalk * w:	the walk
+ * RETURN: none
+ */
+static inline void startWalk(struct gridIndex * g, int s, int b, int rel, struct blockWalk * w)
+{
+	w->stencil = s;
+	w->rel = rel;
+	//a block known to be within the distance needs no walk through its quadtree
+	if(g->quadRoot[b] < 0 || rel == BLOCK_IN)
+	{
+		w->block = b;
+		w->n = 0;
+	}
+	else
+	{
+		w->block = -1;
+		w->node[0] = g->quadRoot[b];
+		w->n = 1;
+	}
+}
+
+/**
+ * NAME:	nextRange
+ * DESCRIPTION:	get the next range of points of a walk that may be within the distance of a point. a block without a quadtree is one range; in a quadtree, nodes beyond the distance are pruned, and nodes entirely within it or leaves are given as ranges
+ * PARAMETERS:
+ * 	struct gridIndex * g:	the index, with block bounds in the units of T
+ * 	struct blockWalk * w:	the walk
+ * 	T x, T y:	the point
+ * 	D dist2:	the squared distance
+ * 	int * start, int * end:	output, the range of points
+ * 	int * rel:	output, BLOCK_IN if every point of the range is within the distance, else BLOCK_PART
+ * RETURN:
+ * 	TYPE:	bool
+ * 	VALUE:	false when the walk is done
+ */
+template <typename T, typename D>
+static inline bool nextRange(struct gridIndex * g, struct blockWalk * w, T x, T y, D dist2, int * start, int * end, int * rel)
+{
+	int node;
+
+	if(w->block >= 0)
+	{
+		*rel = (w->rel != BLOCK_UNKNOWN) ? w->rel : stencilToPoint(g, w->stencil, w->block, x, y, dist2);
+		*start = g->start[w->block];
+		*end = g->end[w->block];
+		w->block = -1;
+		return (*rel != BLOCK_OUT);
+	}
+
+	while(w->n > 0)
+	{
+		node = w->node[-- w->n];
+		if(g->quadStart[node] == g->quadEnd[node])
+			continue;
+		*rel = (g->qxMin == NULL) ? BLOCK_PART : boxToPoint((T)g->qxMin[node], (T)g->qyMin[node], (T)g->qxMax[node], (T)g->qyMax[node], x, y, dist2);
+		if(*rel == BLOCK_OUT)
+			continue;
+		if(*rel == BLOCK_IN || g->quadChild[node] < 0)
+		{
+			*start = g->quadStart[node];
+			*end = g->quadEnd[node];
+			return true;
+		}
+		for(int c = 3; c >= 0; c --)
+			w->node[w->n ++] = g->quadChild[node] + c;
+	}
+	return false;
+}
+
+bool readPoint(FILE * file, double * x, double * y, int * weight);
 int getCount(FILE * file, double &xMin, double &xMax, double &yMin, double &yMax);
+int getCount(FILE * file, double &xMin, double &xMax, double &yMin, double &yMax, int &weight);
 void readPoints(FILE * file, double * x, double * y);
-int * indexPoints(double * &x, double * &y, int count, double xMin, double yMin, int nBlockX, int nBlockY, double blockSize);
-int * indexPoints(double * &x, double * &y, int * &ind, int count, double xMin, double yMin, int nBlockX, int nBlockY, double blockSize);
+void readPoints(FILE * file, double * x, double * y, int * weight);
+FILE * openTempFile(const char * dir);
+int collapseDuplicates(double * x, double * y, int * weight, int count);
+struct gridIndex * indexPoints(double * &x, double * &y, int count, double xMin, double yMin, double xMax, double yMax, double radius, int subdivide, int order);
+struct gridIndex * indexPoints(double * &x, double * &y, int * &ind, int count, double xMin, double yMin, double xMax, double yMax, double radius, int subdivide, int order);
+struct gridIndex * indexPoints(double * &x, double * &y, int * &ind, int * &weight, int count, double xMin, double yMin, double xMax, double yMax, double radius, int subdivide, int order);
+int pickSubdivide(double * x, double * y, int count, double xMin, double yMin, double xMax, double yMax, double radius);
+int subdivideForDensity(double density, int count, double xMin, double yMin, double xMax, double yMax, double radius);
+void storageKey(double x, double y, double xMin, double yMin, double xMax, double yMax, double radius, int subdivide, int order, int blockCount, unsigned long long * blockKey, unsigned long long * pointKey);
+int blockOfPoint(struct gridIndex * g, int i);
+int maxStencilCount(struct gridIndex * g);
+int maxStencilCount(struct gridIndex * g, int * weight);
+void freeGridIndex(struct gridIndex * g);
+int parseOrder(const char * name);
+int parseSubdivide(const char * name);
 
 #endif
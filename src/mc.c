@@ -1,53 +1,484 @@
 #include <stdlib.h>
 #include <stdio.h>
-#include <random>
+#include <math.h>
+#include <string.h>
+#include "io.h"
+#include "points.h"
 #include "clusters.h"
 #include "countPoints.h"
+#include "rng.h"
+#include "options.h"
+#include "mcio.h"
+#include "raster.h"
+#include "memory.h"
+
+//the number of replications simulated together, one bit of a label word each
+#define MC_LANES 64
 
-using namespace std;
 /**
  * NAME:	simBerCase
- * DESCRIPTION:	simulate cases for Monte Carlo Simulation based on Bernoulli Model
+ * DESCRIPTION:	simulate cases for Monte Carlo Simulation based on Bernoulli Model, for a batch of replications at once. the cases of replication r are drawn from the random stream (seed, r) with Floyd's sampling, so every replication is reproducible on its own whatever batch or thread simulates it
  * PARAMETERS:
- * 	int * ind:			the array of points' type indicator (1: case, 0: control), will be randomly shuffled in the simulation
+ * 	unsigned long long * laneLabel:	points' label words (bit k is 1: case, 0: control in replication first + k), will be randomly shuffled in the simulation
  *	int countCas:		the number of case points
  *	int count:			the number of all points
+ *	int * population:	the array indexes of the points the cases are drawn over, in storage order (NULL: all points)
+ *	int nPopulation:	the number of points the cases are drawn over
+ *	unsigned long long seed:	the seed of the simulation
+ *	int first:			the first replication of the batch
+ *	int nLanes:			the number of replications in the batch
  */
-void simBerCase(int * ind, int countCas, int count) {
+void simBerCase(unsigned long long * laneLabel, int countCas, int count, int * population, int nPopulation, unsigned long long seed, int first, int nLanes) {
+
+	struct rngStream s;
+	unsigned long long bit;
+	int casID;
 
-	static std::random_device rd;
-	static std::mt19937 rng(rd());
-	static std::uniform_int_distribution<int> uni(0, count - 1);	
+	//one pass clears all the replications of the batch
+	for(int i = 0; i < count; i++) {
+		laneLabel[i] = 0;
+	}
 
+	for(int lane = 0; lane < nLanes; lane++) {
+		bit = 1ULL << lane;
+		initRngStream(&s, seed, first + lane);
+		//Floyd: the j-th draw picks from [0, j], taking j itself if the pick is already a case
+		for(int j = nPopulation - countCas; j < nPopulation; j++) {
+			casID = rngBounded(&s, j + 1);
+			if(population != NULL)
+				casID = population[casID];
+			if(laneLabel[casID] & bit)
+				casID = (population == NULL) ? j : population[j];
+			laneLabel[casID] |= bit;
+		}
+	}
+
+	return;
+}
+
+/**
+ * NAME:	laneView
+ * DESCRIPTION:	extract the labels and core points of one replication of a batch
+ * PARAMETERS:
+ * 	unsigned long long * laneLabel:	points' label words of the batch
+ * 	unsigned long long * coreMask:	points' core masks of the batch
+ * 	int lane:			the replication in the batch
+ *	int count:			the number of all points
+ * 	unsigned long long * excluded:	the points left out of the simulation (NULL: none)
+ * 	unsigned long long * label:	the output bit-packed labels of the replication
+ * 	int * clusterID:	the output cluster IDs of the replication (0: core points, -1: others, -2: points left out)
+ */
+static void laneView(unsigned long long * laneLabel, unsigned long long * coreMask, int lane, int count, unsigned long long * excluded, unsigned long long * label, int * clusterID) {
+
+	for(int i = 0; i < LABEL_WORDS(count); i++) {
+		label[i] = 0;
+	}
 	for(int i = 0; i < count; i++) {
-		ind[i] = 0;
+		if((laneLabel[i] >> lane) & 1) {
+			SET_LABEL(label, i);
+		}
+		clusterID[i] = ((coreMask[i] >> lane) & 1) ? 0 : -1;
+		if(excluded != NULL && GET_LABEL(excluded, i) == 1) {
+			clusterID[i] = -2;
+		}
+	}
+}
+
+/**
+ * NAME:	allocLaneWorkspace
+ * DESCRIPTION:	allocate the per-point workspace of batched replications
+ * PARAMETERS:
+ *	int count:			the number of all points
+ * 	unsigned long long * &laneLabel:	the label words of the batch
+ * 	unsigned long long * &coreMask:		the core masks of the batch
+ * 	unsigned long long * &label:		the bit-packed labels of one replication
+ * 	int * &clusterID:	the cluster IDs of one replication
+ */
+static void allocLaneWorkspace(int count, unsigned long long * &laneLabel, unsigned long long * &coreMask, unsigned long long * &label, int * &clusterID) {
+
+	if(NULL == (laneLabel = (unsigned long long *)allocArray(sizeof(unsigned long long) * count))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (coreMask = (unsigned long long *)allocArray(sizeof(unsigned long long) * count))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (clusterID = (int *)allocArray(sizeof(int) * count))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
 	}
+	label = allocLabels(count);
+}
+
+/**
+ * NAME:	copyLocation
+ * DESCRIPTION:	find the location of a point numbered one location after another
+ * PARAMETERS:
+ * 	int * copyStart:	the number of the first point of each location
+ *	int count:			the number of locations
+ *	int casID:			the number of the point
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the location
+ */
+static inline int copyLocation(int * copyStart, int count, int casID) {
+
+	//the last location whose first point is at or before the point
+	int lo = 0;
+	int hi = count - 1;
+	int mid;
+	while(lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if(copyStart[mid] <= casID)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
 
+/**
+ * NAME:	simWeightedCase
+ * DESCRIPTION:	simulate cases for one replication of a Monte Carlo Simulation among weighted locations. the points of all locations are numbered one location after another and countCas of them are drawn from the random stream (seed, replication) with Floyd's sampling, the same draws simBerCase makes for the replication, then each location gets the number of its points drawn
+ * PARAMETERS:
+ * 	int * caseCount:	the output number of cases at each location
+ * 	int * copyStart:	the number of the first point of each location, copyStart[count] is the number of all points
+ *	int countCas:		the number of case points
+ *	int count:			the number of locations
+ *	unsigned long long seed:	the seed of the simulation
+ *	int replication:	the replication
+ * 	unsigned long long * taken:	the workspace of the drawn points, one bit per point
+ */
+static void simWeightedCase(int * caseCount, int * copyStart, int countCas, int count, unsigned long long seed, int replication, unsigned long long * taken) {
+
+	struct rngStream s;
+	int total = copyStart[count];
 	int casID;
 
-	for(int i = 0; i < countCas; i++) {
-		casID = uni(rng);
-		while(ind[casID] == 1)
-			casID = uni(rng);
-		ind[casID] = 1;
+	for(int i = 0; i < LABEL_WORDS(total); i++) {
+		taken[i] = 0;
+	}
+	for(int i = 0; i < count; i++) {
+		caseCount[i] = 0;
 	}
 
-	return;
+	initRngStream(&s, seed, replication);
+	for(int j = total - countCas; j < total; j++) {
+		casID = rngBounded(&s, j + 1);
+		if(GET_LABEL(taken, casID))
+			casID = j;
+		SET_LABEL(taken, casID);
+
+		caseCount[copyLocation(copyStart, count, casID)] ++;
+	}
+}
+
+/**
+ * NAME:	weightedView
+ * DESCRIPTION:	find the labels and core points of one replication among weighted locations: a location is labeled 1 if it holds any case, and is a core point if the cases within the search radius reach its threshold
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all locations
+ * 	struct gridIndex * g:	the index of all locations
+ *	double radius:		the search radius
+ * 	int * caseCount:	the number of cases at each location
+ * 	int * coreThr:		the threshold of each location
+ * 	struct neighborCounts * nc:	the workspace of the numbers of cases within the search radius
+ * 	unsigned long long * excluded:	the locations left out of the simulation (NULL: none)
+ * 	unsigned long long * label:	the output bit-packed labels of the replication
+ * 	int * clusterID:	the output cluster IDs of the replication (0: core points, -1: others, -2: locations left out)
+ */
+static void weightedView(struct pointStore * ps, struct gridIndex * g, double radius, int * caseCount, int * coreThr, struct neighborCounts * nc, unsigned long long * excluded, unsigned long long * label, int * clusterID) {
+
+	countInDistance_Weights(ps, caseCount, g, radius, nc);
+
+	int count = g->count;
+	for(int i = 0; i < LABEL_WORDS(count); i++) {
+		label[i] = 0;
+	}
+	for(int i = 0; i < count; i++) {
+		if(caseCount[i] > 0) {
+			SET_LABEL(label, i);
+		}
+		clusterID[i] = (COUNT_AT(nc, nc->c0, i) >= coreThr[i]) ? 0 : -1;
+		if(excluded != NULL && GET_LABEL(excluded, i) == 1) {
+			clusterID[i] = -2;
+		}
+	}
+}
+
+/**
+ * NAME:	allocCopyStart
+ * DESCRIPTION:	number the points of all locations one location after another, the locations left out of the simulation holding none
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all locations
+ * 	unsigned long long * excluded:	the locations left out of the simulation (NULL: none)
+ * RETURN:
+ * 	TYPE:	int *
+ * 	VALUE:	the number of the first point of each location, the last of count + 1 being the number of all points
+ */
+static int * allocCopyStart(struct pointStore * ps, unsigned long long * excluded) {
+
+	int count = ps->count;
+	int * copyStart;
+	if(NULL == (copyStart = (int *)malloc(sizeof(int) * (count + 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	copyStart[0] = 0;
+	for(int i = 0; i < count; i++) {
+		copyStart[i + 1] = copyStart[i] + ((excluded != NULL && GET_LABEL(excluded, i) == 1) ? 0 : ps->weight[i]);
+	}
+	return copyStart;
+}
+
+/**
+ * NAME:	allocWeightedWorkspace
+ * DESCRIPTION:	allocate the workspace of replications among weighted locations, nothing is allocated if the locations have no weights
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all locations
+ * 	unsigned long long * excluded:	the locations left out of the simulation (NULL: none)
+ *	int maxCount:		an upper bound of the number of points within the search radius
+ * 	int * &caseCount:	the number of cases at each location
+ * 	int * &copyStart:	the number of the first point of each location
+ * 	unsigned long long * &taken:	the drawn points
+ * 	struct neighborCounts * &nc:	the numbers of cases within the search radius
+ */
+static void allocWeightedWorkspace(struct pointStore * ps, unsigned long long * excluded, int maxCount, int * &caseCount, int * &copyStart, unsigned long long * &taken, struct neighborCounts * &nc) {
+
+	caseCount = NULL;
+	copyStart = NULL;
+	taken = NULL;
+	nc = NULL;
+	if(ps->weight == NULL)
+		return;
+
+	int count = ps->count;
+	if(NULL == (caseCount = (int *)malloc(sizeof(int) * count))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	copyStart = allocCopyStart(ps, excluded);
+	taken = allocLabels(copyStart[count]);
+	nc = allocNeighborCounts(count, maxCount, false);
+}
+
+/**
+ * NAME:	mixKey
+ * DESCRIPTION:	mix a 64-bit value into a well distributed hash (the splitmix64 finalizer)
+ * PARAMETERS:
+ * 	unsigned long long v:	the value
+ * RETURN:
+ * 	TYPE:	unsigned long long
+ * 	VALUE:	the hash
+ */
+static unsigned long long mixKey(unsigned long long v) {
+
+	v ^= v >> 30;
+	v *= 0xBF58476D1CE4E5B9ULL;
+	v ^= v >> 27;
+	v *= 0x94D049BB133111EBULL;
+	v ^= v >> 31;
+	return v;
+}
+
+/**
+ * NAME:	addKey
+ * DESCRIPTION:	fold a double into a key
+ * PARAMETERS:
+ * 	unsigned long long key:	the key
+ * 	double v:				the value
+ * RETURN:
+ * 	TYPE:	unsigned long long
+ * 	VALUE:	the new key
+ */
+static unsigned long long addKey(unsigned long long key, double v) {
+
+	unsigned long long bits;
+	memcpy(&bits, &v, sizeof(bits));
+	return mixKey(key ^ bits);
+}
+
+/**
+ * NAME:	pointsKey
+ * DESCRIPTION:	hash the points the labels of a null distribution are drawn over. the points are hashed independently of their order, so the key only depends on the set of locations and not on the input files or on which of them are the observed cases
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of the points
+ * 	unsigned long long * excluded:	the points left out of the simulation (NULL: none)
+ * RETURN:
+ * 	TYPE:	unsigned long long
+ * 	VALUE:	the hash
+ */
+static unsigned long long pointsKey(struct pointStore * ps, unsigned long long * excluded) {
+
+	//a sum of per-point hashes does not depend on the order of the points
+	unsigned long long points = 0;
+	unsigned long long h;
+	int n = 0;
+	for(int i = 0; i < ps->count; i++) {
+		if(excluded != NULL && GET_LABEL(excluded, i) == 1)
+			continue;
+		n ++;
+		h = addKey(addKey(0, pointX(ps, i)), pointY(ps, i));
+		if(ps->weight != NULL) {
+			h = mixKey(h ^ (unsigned long long)ps->weight[i]);
+		}
+		points += h;
+	}
+	return mixKey(points ^ (unsigned long long)n);
+}
+
+/**
+ * NAME:	rasterKey
+ * DESCRIPTION:	hash the background raster the events of a null distribution are drawn from
+ * PARAMETERS:
+ * 	struct rasterGrid * ra:	the raster
+ * RETURN:
+ * 	TYPE:	unsigned long long
+ * 	VALUE:	the hash
+ */
+static unsigned long long rasterKey(struct rasterGrid * ra) {
+
+	unsigned long long key = mixKey((unsigned long long)ra->nCols << 32 ^ (unsigned long long)ra->nRows);
+	key = addKey(key, ra->xMin);
+	key = addKey(key, ra->yMin);
+	key = addKey(key, ra->cellSize);
+	for(long long i = 0; i < (long long)(ra->nRows + 1) * (ra->nCols + 1); i++) {
+		key = addKey(key, ra->sat[i]);
+	}
+	return key;
+}
+
+/**
+ * NAME:	nullKey
+ * DESCRIPTION:	the key of a null distribution: the hash of the points (or the raster) the labels are drawn over and every parameter the maximum log likelihood of a replication depends on
+ * PARAMETERS:
+ * 	unsigned long long points:	the hash of the points or the raster, see pointsKey and rasterKey
+ * 	int model:				MODEL_BERNOULLI or MODEL_POISSON
+ * 	int countCases:			the number of cases (events) of each replication
+ *	double radius:			the search radius
+ *	double p:				the p of the Bernoulli model, or the baseline ratio of the Poisson model
+ *	double significance: 	the significane level to tell a cluste core point
+ *	int minCore:			the minimum number of core points in each cluster
+ *	bool nonCorePoints:		whether a cluster include non-core points
+ *	struct options * opts:	the precision the neighbors are counted in
+ * RETURN:
+ * 	TYPE:	unsigned long long
+ * 	VALUE:	the key
+ */
+static unsigned long long nullKey(unsigned long long points, int model, int countCases, double radius, double p, double significance, int minCore, bool nonCorePoints, struct options * opts) {
+
+	unsigned long long key = mixKey(points ^ (unsigned long long)model);
+	key = mixKey(key ^ (unsigned long long)countCases);
+	key = addKey(key, radius);
+	key = addKey(key, p);
+	key = addKey(key, significance);
+	key = mixKey(key ^ (unsigned long long)minCore);
+	key = mixKey(key ^ (unsigned long long)nonCorePoints);
+	key = mixKey(key ^ (unsigned long long)opts->precision);
+	key = addKey(key, opts->resolution);
+	return key;
+}
+
+/**
+ * NAME:	startSimulation
+ * DESCRIPTION:	start the progress of a Monte Carlo simulation of all replications or of the range given by the options, resuming it from the checkpoint or taking the replications of the null cache if there is one
+ * PARAMETERS:
+ *	struct clusterInfo * cInfo:		the info of detected clusters
+ *	int nSim:				the number of simulation to be conducted
+ *	struct options * opts:	the seed, the range, the checkpoint and the null cache of the simulation
+ *	unsigned long long key:	the key of the null distribution, which the checkpoint and the null cache must match
+ * RETURN:
+ * 	TYPE:	struct mcState *
+ * 	VALUE:	the progress of the simulation
+ */
+static struct mcState * startSimulation(struct clusterInfo * cInfo, int nSim, struct options * opts, unsigned long long key) {
+
+	int end = (opts->simEnd < 0) ? nSim : opts->simEnd;
+	struct mcState * st = newMcState(cInfo, opts->simFirst, end, opts->seed);
+	if(opts->checkpoint != NULL && loadCheckpoint(opts->checkpoint, key, st)) {
+		printf("Resuming from checkpoint %s: %d replications done, seed %llu\n", opts->checkpoint, st->nDone, st->seed);
+	}
+	if(opts->nullCache != NULL && loadNullCache(opts->nullCache, key, st)) {
+		printf("Null cache %s: %d replications cached, seed %llu\n", opts->nullCache, st->nDone, st->seed);
+	}
+	return st;
+}
+
+/**
+ * NAME:	settleLL
+ * DESCRIPTION:	the log likelihood at which the search of a replication can stop: a replication reaching the largest log likelihood of the detected clusters is above all of them whatever its maximum is. the null cache keeps the exact maximum, so it never stops early then
+ * PARAMETERS:
+ * 	struct mcState * st:	the progress of the simulation
+ *	struct options * opts:	the null cache of the simulation
+ * RETURN:
+ * 	TYPE:	double
+ * 	VALUE:	the log likelihood settling a replication, HUGE_VAL for never and -HUGE_VAL if no cluster was detected
+ */
+static double settleLL(struct mcState * st, struct options * opts) {
+
+	if(opts->nullCache != NULL)
+		return HUGE_VAL;
+	double settle = -HUGE_VAL;
+	for(int j = 0; j < st->nClusters; j++) {
+		if(st->cLL[j] > settle)
+			settle = st->cLL[j];
+	}
+	return settle;
+}
+
+/**
+ * NAME:	checkpointSimulation
+ * DESCRIPTION:	write the checkpoint or the null cache of a simulation if enough replications were done since the last one, or if the simulation is finished
+ * PARAMETERS:
+ * 	struct mcState * st:	the progress of the simulation
+ *	struct options * opts:	the checkpoint or the null cache of the simulation
+ *	unsigned long long key:	the key of the null distribution
+ *	int &nSaved:			the number of replications in the last checkpoint
+ * RETURN: none
+ */
+static void checkpointSimulation(struct mcState * st, struct options * opts, unsigned long long key, int &nSaved) {
+
+	if(opts->checkpoint == NULL && opts->nullCache == NULL)
+		return;
+	if(st->nDone - nSaved >= opts->checkpointEvery || st->first + st->nDone == st->nSim) {
+		if(opts->checkpoint != NULL) {
+			saveCheckpoint(opts->checkpoint, key, st);
+		}
+		else {
+			saveNullCache(opts->nullCache, key, st);
+		}
+		nSaved = st->nDone;
+	}
+}
+
+/**
+ * NAME:	finishSimulation
+ * DESCRIPTION:	write the p-values of a simulation, and its shard file if it only simulates a range of the replications
+ * PARAMETERS:
+ * 	struct mcState * st:	the progress of the simulation, freed here
+ *	int model:				MODEL_BERNOULLI or MODEL_POISSON
+ *	int nSim:				the number of simulation to be conducted
+ *	struct options * opts:	the shard file of the simulation
+ *	struct clusterInfo * cInfo:		the info of detected clusters, resulting p-values (NAN for a range of the replications) will be written to it
+ * RETURN: none
+ */
+static void finishSimulation(struct mcState * st, int model, int nSim, struct options * opts, struct clusterInfo * cInfo) {
+
+	if(opts->shard != NULL) {
+		saveShard(opts->shard, st, model, nSim, cInfo);
+	}
+	setPValues(st, nSim, cInfo);
+	freeMcState(st);
 }
 
 /**
  * NAME:	monteCarloBer
- * DESCRIPTION:	calculate the P-Value of each cluster in a Bernoulli model
- * PARAMETERS:
- * 	double * x: 			the array of points' X values
- * 	double * y: 			the array of points' Y values
- * 	int * ind:				the array of points' type indicator (1: case, 0: control), will be randomly shuffled in the simulation
- * 	int * index:			the index of all event points
- * 	int nBlockX:			the number of index blocks along X dimension
- * 	int nBlockY:			the number of index blocks along Y dimension
- *	double radius:			the search radius, which is also the block size
- *	double xMin:			the minimum X of all points
- *	double yMin:			the minimum Y of all points
+ * DESCRIPTION:	calculate the P-Value of each cluster in a Bernoulli model. replications are simulated in batches of 64: the core points of all replications of a batch are found in one pass over the neighborhoods, then clusters are expanded for each replication
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points
+ * 	struct gridIndex * g:	the index of all points
+ *	double radius:			the search radius the index was built for, with blocks of side radius / subdivide
  *	int countCas:			the number of case points
  *	int countCon:			the number of control points
  *	double p:				the p of Possion distribution
@@ -55,171 +486,501 @@ void simBerCase(int * ind, int countCas, int count) {
  *	int minCore:			the minimum number of core points in each cluster (each cluste should have more core points than minCore)
  *	bool nonCorePoints:		whether a cluster include non-core points
  *	int nSim:				the number of simulation to be conducted
+ *	struct options * opts:	the seed, the range, the checkpoint, the shard file and the null cache of the simulation
  *	struct clusterInfo * cInfo:		the info of detected clusters, resulting p-values will be written to it
  */
 
-void monteCarloBer(double * x, double * y, int * ind, int * index, int nBlockX, int nBlockY, double radius, double xMin, double yMin, int countCas, int countCon, double p, double significance, int minCore, bool nonCorePoints, int nSim, struct clusterInfo * cInfo) {
+void monteCarloBer(struct pointStore * ps, struct gridIndex * g, double radius, int countCas, int countCon, double p, double significance, int minCore, bool nonCorePoints, int nSim, struct options * opts, struct clusterInfo * cInfo) {
 
-	int nClusters = 0;
-	int count = countCas + countCon;
-	struct clusterInfo * curInfo = cInfo;
-	while (curInfo!=NULL) {
-		nClusters ++;
-		curInfo = curInfo->next;
-	}
-
-	int llAbove[nClusters];
-	double cLL[nClusters];
+	int count = g->count;
+	unsigned long long key = nullKey(pointsKey(ps, NULL), MODEL_BERNOULLI, countCas, radius, p, significance, minCore, nonCorePoints, opts);
+	struct mcState * st = startSimulation(cInfo, nSim, opts, key);
 
-	curInfo = cInfo;
-	for(int i = 0; i < nClusters; i++) {
-		llAbove[i] = 0;
-		cLL[i] = curInfo->ll;
-		curInfo = curInfo->next;
-	}
-		
-	int * countPointsCas;
-	int * countPointsCon;
+	//the number of points near each point does not depend on the labels, neither does the number of cases a point needs to be a core point
+	int maxCount = maxStencilCount(g, ps->weight);
+	struct neighborCounts * nc = allocNeighborCounts(count, maxCount, false);
+	countInDistance_Single(ps, g, radius, nc);
 
-	if(NULL == (countPointsCas = (int *)malloc(sizeof(int) * count)))
+	int * coreThr;
+	int * thrOfCount;
+	if(NULL == (coreThr = (int *)malloc(sizeof(int) * count)))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	if(NULL == (countPointsCon = (int *)malloc(sizeof(int) * count)))
+	if(NULL == (thrOfCount = (int *)malloc(sizeof(int) * (maxCount + 1))))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
+	for(int i = 0; i <= maxCount; i++) {
+		thrOfCount[i] = -1;
+	}
+	int n;
+	for(int i = 0; i < count; i++) {
+		n = COUNT_AT(nc, nc->c0, i);
+		if(thrOfCount[n] < 0) {
+			thrOfCount[n] = binomialCoreThreshold(n, p, significance);
+		}
+		coreThr[i] = thrOfCount[n];
+	}
+	free(thrOfCount);
+	freeNeighborCounts(nc);
+
+	unsigned long long * laneLabel;
+	unsigned long long * coreMask;
+	unsigned long long * label;
+	int * clusterID;
+	allocLaneWorkspace(count, laneLabel, coreMask, label, clusterID);
+
+	int * caseCount;
+	int * copyStart;
+	unsigned long long * taken;
+	struct neighborCounts * ncCase;
+	allocWeightedWorkspace(ps, NULL, maxCount, caseCount, copyStart, taken, ncCase);
+	struct expandWorkspace * ws = allocExpandWorkspace(count);
+	//a replication is above every cluster once it reaches the largest of them
+	double settle = settleLL(st, opts);
+
+	double simMaxLL;
+	int nLanes;
+	int nSaved = st->nDone;
 
-	double simMaxLL;	
+	for(int first = st->first + st->nDone; first < st->nSim; first += MC_LANES) {
+		nLanes = (st->nSim - first < MC_LANES) ? (st->nSim - first) : MC_LANES;
 
-	for(int i = 0; i < nSim; i++) {
-		//SimulateCases
-		simBerCase(ind, countCas, count);
-	
-		//CalcCount
-		countInDistance(x, y, ind, index, nBlockX, nBlockY, radius, countPointsCon, countPointsCas);
+		if(ps->weight == NULL) {
+			//SimulateCases
+			simBerCase(laneLabel, countCas, count, NULL, count, st->seed, first, nLanes);
 
-		//GetMaxLL
-		simMaxLL = berMaximumLL(x, y, ind, index, nBlockX, nBlockY, radius, xMin, yMin, countCas, countCon, countPointsCas, countPointsCon, p, significance, minCore, nonCorePoints);
+			//FindCores
+			countInDistance_Lanes(ps, laneLabel, g, radius, coreThr, maxCount, coreMask);
+		}
 
-		printf("Simulation: %d\tLL: %lf\n", i, simMaxLL);
-		//CompareLL
-		if(simMaxLL<0) {
-			for(int j = 0; j < nClusters; j++) {
-				if(cLL[j] <= simMaxLL) {
-					llAbove[j] ++;
-				}
+		for(int lane = 0; lane < nLanes; lane++) {
+			if(ps->weight == NULL) {
+				laneView(laneLabel, coreMask, lane, count, NULL, label, clusterID);
 			}
+			else {
+				//a weighted location can hold both cases and controls, which the label bits of a batch can not tell, so its replications are done one at a time
+				simWeightedCase(caseCount, copyStart, countCas, count, st->seed, first + lane, taken);
+				weightedView(ps, g, radius, caseCount, coreThr, ncCase, NULL, label, clusterID);
+			}
+			//GetMaxLL
+			simMaxLL = berMaximumLL_Cores(ps, label, caseCount, g, radius, countCas, countCon, clusterID, minCore, nonCorePoints, ws, settle);
+
+			printf("Simulation: %d\tLL: %lf\n", first + lane, simMaxLL);
+			//CompareLL, a replication without any cluster (LL 1) is below all clusters
+			addSimulation(st, (simMaxLL < 0) ? simMaxLL : -HUGE_VAL);
 		}
+
+		checkpointSimulation(st, opts, key, nSaved);
 	}
 
-	free(countPointsCas);
-	free(countPointsCon);
+	free(coreThr);
+	free(laneLabel);
+	free(coreMask);
+	free(label);
+	free(clusterID);
+	free(caseCount);
+	free(copyStart);
+	free(taken);
+	freeNeighborCounts(ncCase);
+	freeExpandWorkspace(ws);
+
+	finishSimulation(st, MODEL_BERNOULLI, nSim, opts, cInfo);
+
+}
+
+/**
+ * NAME:	compareLocation
+ * DESCRIPTION:	compare two array indexes for qsort
+ */
+static int compareLocation(const void * a, const void * b) {
+
+	return *(const int *)a - *(const int *)b;
+}
 
-	curInfo = cInfo;
-	for(int i = 0; i < nClusters; i++) {
-		curInfo->pValue = (double)(1+llAbove[i]) / (1+nSim);
-		curInfo = curInfo->next;
+/**
+ * NAME:	simEventCase
+ * DESCRIPTION:	simulate the events of one replication as a list of the locations holding them, with the same draws simBerCase and simWeightedCase make for the replication. only the drawn points are visited, so the work does not grow with the number of points
+ * PARAMETERS:
+ * 	int * events:		the output locations with events, in ascending order
+ * 	int * caseCount:	the output number of events at each location, 0 before for every location
+ * 	int * copyStart:	the number of the first point of each location, copyStart[count] is the number of all points (NULL: one point at every location of the population)
+ * 	int * population:	the array indexes of the points the events are drawn over, in storage order (NULL: all points)
+ *	int countCas:		the number of events
+ *	int count:			the number of locations, or the number of points in the population without copyStart
+ *	unsigned long long seed:	the seed of the simulation
+ *	int replication:	the replication
+ * 	unsigned long long * taken:	the workspace of the drawn points, one bit per point, 0 before and after
+ * 	int * drawn:		the workspace of the drawn points, countCas of them
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the number of locations with events
+ */
+static int simEventCase(int * events, int * caseCount, int * copyStart, int * population, int countCas, int count, unsigned long long seed, int replication, unsigned long long * taken, int * drawn) {
+
+	struct rngStream s;
+	int total = (copyStart == NULL) ? count : copyStart[count];
+	int casID, loc;
+	int nEvents = 0;
+
+	initRngStream(&s, seed, replication);
+	for(int j = total - countCas; j < total; j++) {
+		casID = rngBounded(&s, j + 1);
+		if(GET_LABEL(taken, casID))
+			casID = j;
+		SET_LABEL(taken, casID);
+		drawn[j - (total - countCas)] = casID;
+
+		if(copyStart != NULL)
+			loc = copyLocation(copyStart, count, casID);
+		else
+			loc = (population == NULL) ? casID : population[casID];
+		if(caseCount[loc] == 0) {
+			events[nEvents] = loc;
+			nEvents ++;
+		}
+		caseCount[loc] ++;
 	}
 
+	for(int k = 0; k < countCas; k++) {
+		CLEAR_LABEL(taken, drawn[k]);
+	}
+	//clusters are started from the events in storage order, the same as from all points
+	qsort(events, nEvents, sizeof(int), compareLocation);
+	return nEvents;
 }
 
 /**
- * NAME:	monteCarloPoi
- * DESCRIPTION:	calculate the P-Value of each cluster in a Poisson model
- * PARAMETERS:
- * 	double * xB: 			the array of background points' X values
- * 	double * yB: 			the array of background points' Y values
- * 	int * indexB:			the index of all background points
- * 	int nBlockX:			the number of index blocks along X dimension
- * 	int nBlockY:			the number of index blocks along Y dimension
- *	double radius:			the search radius, which is also the block size
- *	double xMin:			the minimum X of all points
- *	double yMin:			the minimum Y of all points
+ * NAME:	simulatePoiEvents
+ * DESCRIPTION:	simulate the replications of a Poisson model one at a time from their events: the events are spread to the points within the search radius of them, the points reached are tested against their thresholds and the clusters are expanded from the events, so a replication only visits the neighborhoods of its events. the maximum log likelihoods are the same as in the batched simulation
+ * PARAMETERS:
+ * 	struct pointStore * psB:	the store of all background points, and of the observed events if they are labeled 1
+ * 	struct gridIndex * gB:	the index of all points of the store
+ *	int * population:		the array indexes of the background points (NULL: all points)
+ *	int nPopulation:		the number of background points
+ *	double radius:			the search radius the index was built for, with blocks of side radius / subdivide
  *	int countE:				the number of event points
  *	int countB:				the number of background points
- *	double baseLineRatio:	the ratio null hypothesis to complete randomness baseline 1 means the same as baseline, 2 means twice the baseline
- *	double significance: 	the significane level to tell a cluste core point
+ *	int * coreThr:			the number of events each point needs to be a core point
  *	int minCore:			the minimum number of core points in each cluster (each cluste should have more core points than minCore)
  *	bool nonCorePoints:		whether a cluster include non-core points
- *	int nSim:				the number of simulation to be conducted
- *	struct clusterInfo * cInfo:		the info of detected clusters, resulting p-values will be written to it
+ * 	struct mcState * st:	the progress of the simulation
+ *	struct options * opts:	the checkpoint and the null cache of the simulation
+ *	unsigned long long key:	the key of the null distribution
+ * RETURN: none
  */
-
-void monteCarloPoi(double * xB, double * yB, int * indexB, int nBlockX, int nBlockY, double radius, double xMin, double yMin, int countE, int countB, double baseLineRatio, double significance, int minCore, bool nonCorePoints, int nSim, struct clusterInfo * cInfo) {
-
-	int nClusters = 0;
-	struct clusterInfo * curInfo = cInfo;
-	while (curInfo!=NULL) {
-		nClusters ++;
-		curInfo = curInfo->next;
+static void simulatePoiEvents(struct pointStore * psB, struct gridIndex * gB, int * population, int nPopulation, double radius, int countE, int countB, int * coreThr, int minCore, bool nonCorePoints, struct mcState * st, struct options * opts, unsigned long long key) {
+
+	int count = gB->count;
+	int * copyStart = NULL;
+	int total = nPopulation;
+	if(psB->weight != NULL) {
+		copyStart = allocCopyStart(psB, psB->label);
+		total = copyStart[count];
 	}
 
-	int llAbove[nClusters];
-	double cLL[nClusters];
-
-	curInfo = cInfo;
-	for(int i = 0; i < nClusters; i++) {
-		llAbove[i] = 0;
-		cLL[i] = curInfo->ll;
-		curInfo = curInfo->next;
+	int * drawn;
+	int * events;
+	int * caseCount;
+	int * count1;
+	int * touched;
+	int * clusterID;
+	if(NULL == (drawn = (int *)malloc(sizeof(int) * countE))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
 	}
-
-	int * ind;
-	if(NULL == (ind = (int *)malloc(sizeof(int) * countB))) {
+	if(NULL == (events = (int *)malloc(sizeof(int) * countE))) {
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	int * countPointsB = countInDistance_Single(xB, yB, indexB, nBlockX, nBlockY, radius);
-	int * countPointsE;
-	if(NULL == (countPointsE = (int *)malloc(sizeof(int) * countB))) {
+	if(NULL == (caseCount = (int *)calloc(count, sizeof(int)))) {
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-
-	double * lambda;
-	if(NULL == (lambda = (double *)malloc(sizeof(double) * countB))) {
+	if(NULL == (count1 = (int *)calloc(count, sizeof(int)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (touched = (int *)malloc(sizeof(int) * count))) {
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	for(int i = 0; i < countB; i++) {
-		lambda[i] = (double)(countPointsB[i]) * countE * baseLineRatio / countB;
+	if(NULL == (clusterID = (int *)allocArray(sizeof(int) * count))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
 	}
+	struct expandWorkspace * ws = allocExpandWorkspace(count);
+	double settle = settleLL(st, opts);
+	unsigned long long * label = allocLabels(count);
+	unsigned long long * taken = allocLabels(total);
 
+	int nEvents, nTouched, j;
 	double simMaxLL;
+	int nSaved = st->nDone;
 
-	for(int i = 0; i < nSim; i++) {
+	for(int r = st->first + st->nDone; r < st->nSim; r++) {
 		//Simulate case
-		simBerCase(ind, countE, countB);
-
-		//CountEvent
-		countInDistance_EventsInPop(xB, yB, ind, indexB, nBlockX, nBlockY, radius, countPointsE);	
-//		for(int j = 0; j < countB; j++) {
-//			printf("%d,%lf\n", countPointsE[j], lambda[j]);
-//		}
+		nEvents = simEventCase(events, caseCount, copyStart, population, countE, (copyStart == NULL) ? nPopulation : count, st->seed, r, taken, drawn);
+
+		//FindCores, only the points reached from an event can be in a cluster
+		nTouched = countInDistance_Events(psB, events, nEvents, caseCount, gB, radius, count1, touched);
+		for(int k = 0; k < nTouched; k++) {
+			j = touched[k];
+			clusterID[j] = (count1[j] >= coreThr[j]) ? 0 : -1;
+			if(psB->label != NULL && GET_LABEL(psB->label, j) == 1)
+				clusterID[j] = -2;
+		}
+		for(int k = 0; k < nEvents; k++) {
+			SET_LABEL(label, events[k]);
+		}
 
 		//GetTopLikelihood
-		simMaxLL = poiMaximumLL(xB, yB, ind, indexB, nBlockX, nBlockY, radius, xMin, yMin, countB, countE, countPointsE, lambda, significance, minCore, nonCorePoints);
+		simMaxLL = poiMaximumLL_Events(psB, label, caseCount, gB, radius, countB, countE, clusterID, events, nEvents, minCore, nonCorePoints, ws, settle);
 
 		//Compare and update
-		printf("Simulation: %d\tLL: %lf\n", i, simMaxLL);
-		for(int j = 0; j < nClusters; j++) {
-			if(cLL[j] <= simMaxLL) {
-				llAbove[j] ++;
+		printf("Simulation: %d\tLL: %lf\n", r, simMaxLL);
+		addSimulation(st, simMaxLL);
+		checkpointSimulation(st, opts, key, nSaved);
+
+		for(int k = 0; k < nTouched; k++) {
+			count1[touched[k]] = 0;
+		}
+		for(int k = 0; k < nEvents; k++) {
+			caseCount[events[k]] = 0;
+			CLEAR_LABEL(label, events[k]);
+		}
+	}
+
+	free(copyStart);
+	free(drawn);
+	free(events);
+	free(caseCount);
+	free(count1);
+	free(touched);
+	free(clusterID);
+	freeExpandWorkspace(ws);
+	free(label);
+	free(taken);
+}
+
+/**
+ * NAME:	monteCarloPoi
+ * DESCRIPTION:	calculate the P-Value of each cluster in a Poisson model. replications are simulated in batches of 64: the core points of all replications of a batch are found in one pass over the neighborhoods, then clusters are expanded for each replication. the store may be the one of the observed data, whose events (labeled 1) are left out: the events of the replications are drawn over the background points and the observed events are never counted or reached
+ * PARAMETERS:
+ * 	struct pointStore * psB:	the store of all background points, and of the observed events if they are labeled 1
+ * 	struct gridIndex * gB:	the index of all points of the store
+ *	double radius:			the search radius the index was built for, with blocks of side radius / subdivide
+ *	int countE:				the number of event points
+ *	int countB:				the number of background points
+ *	double baseLineRatio:	the ratio null hypothesis to complete randomness baseline 1 means the same as baseline, 2 means twice the baseline
+ *	double significance: 	the significane level to tell a cluste core point
+ *	int minCore:			the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:		whether a cluster include non-core points
+ *	int nSim:				the number of simulation to be conducted
+ *	struct options * opts:	the seed, the range, the checkpoint, the shard file and the null cache of the simulation
+ *	struct clusterInfo * cInfo:		the info of detected clusters, resulting p-values will be written to it
+ */
+
+void monteCarloPoi(struct pointStore * psB, struct gridIndex * gB, double radius, int countE, int countB, double baseLineRatio, double significance, int minCore, bool nonCorePoints, int nSim, struct options * opts, struct clusterInfo * cInfo) {
+
+	unsigned long long key = nullKey(pointsKey(psB, psB->label), MODEL_POISSON, countE, radius, baseLineRatio, significance, minCore, nonCorePoints, opts);
+	struct mcState * st = startSimulation(cInfo, nSim, opts, key);
+
+	//the events are drawn over the background points only
+	int count = gB->count;
+	int * population = NULL;
+	int nPopulation = count;
+	if(psB->label != NULL) {
+		if(NULL == (population = (int *)malloc(sizeof(int) * count))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		nPopulation = 0;
+		for(int i = 0; i < count; i++) {
+			if(GET_LABEL(psB->label, i) == 0) {
+				population[nPopulation] = i;
+				nPopulation ++;
+			}
+		}
+	}
+
+	//the local lambda of each point does not depend on the labels, neither does the number of events it needs to be a core point
+	int maxCount = maxStencilCount(gB, psB->weight);
+	struct neighborCounts * nc = allocNeighborCounts(count, maxCount, psB->label != NULL);
+	if(psB->label != NULL)
+		countInDistance(psB, psB->label, gB, radius, nc);
+	else
+		countInDistance_Single(psB, gB, radius, nc);
+
+	int * coreThr;
+	if(NULL == (coreThr = (int *)malloc(sizeof(int) * count))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int i = 0; i < count; i++) {
+		coreThr[i] = poissonCoreThreshold((double)(COUNT_AT(nc, nc->c0, i)) * countE * baseLineRatio / countB, maxCount, significance);
+	}
+	freeNeighborCounts(nc);
+
+	//a batch walks the neighborhoods of all points, one replication at a time only those of its events
+	if((long long)countE * ((psB->weight == NULL) ? MC_LANES : 2) < nPopulation) {
+		simulatePoiEvents(psB, gB, population, nPopulation, radius, countE, countB, coreThr, minCore, nonCorePoints, st, opts, key);
+		free(coreThr);
+		free(population);
+		finishSimulation(st, MODEL_POISSON, nSim, opts, cInfo);
+		return;
+	}
+
+	unsigned long long * laneLabel;
+	unsigned long long * coreMask;
+	unsigned long long * label;
+	int * clusterID;
+	allocLaneWorkspace(count, laneLabel, coreMask, label, clusterID);
+
+	int * caseCount;
+	int * copyStart;
+	unsigned long long * taken;
+	struct neighborCounts * ncCase;
+	allocWeightedWorkspace(psB, psB->label, maxCount, caseCount, copyStart, taken, ncCase);
+	struct expandWorkspace * ws = allocExpandWorkspace(count);
+	//a replication is above every cluster once it reaches the largest of them
+	double settle = settleLL(st, opts);
+
+	double simMaxLL;
+	int nLanes;
+	int nSaved = st->nDone;
+
+	for(int first = st->first + st->nDone; first < st->nSim; first += MC_LANES) {
+		nLanes = (st->nSim - first < MC_LANES) ? (st->nSim - first) : MC_LANES;
+
+		if(psB->weight == NULL) {
+			//Simulate case
+			simBerCase(laneLabel, countE, count, population, nPopulation, st->seed, first, nLanes);
+
+			//FindCores
+			countInDistance_Lanes(psB, laneLabel, gB, radius, coreThr, maxCount, coreMask);
+		}
+
+		for(int lane = 0; lane < nLanes; lane++) {
+			if(psB->weight == NULL) {
+				laneView(laneLabel, coreMask, lane, count, psB->label, label, clusterID);
 			}
+			else {
+				//events are drawn among all background points, several of them at a location
+				simWeightedCase(caseCount, copyStart, countE, count, st->seed, first + lane, taken);
+				weightedView(psB, gB, radius, caseCount, coreThr, ncCase, psB->label, label, clusterID);
+			}
+			//GetTopLikelihood
+			simMaxLL = poiMaximumLL_Cores(psB, label, caseCount, gB, radius, countB, countE, clusterID, minCore, nonCorePoints, ws, settle);
+
+			//Compare and update
+			printf("Simulation: %d\tLL: %lf\n", first + lane, simMaxLL);
+			addSimulation(st, simMaxLL);
 		}
+
+		checkpointSimulation(st, opts, key, nSaved);
 	}
 
-	free(ind);
-	free(countPointsB);
-	free(countPointsE);
-	free(lambda);
+	free(coreThr);
+	free(laneLabel);
+	free(coreMask);
+	free(label);
+	free(clusterID);
+	free(caseCount);
+	free(copyStart);
+	free(taken);
+	freeNeighborCounts(ncCase);
+	freeExpandWorkspace(ws);
+	free(population);
+
+	finishSimulation(st, MODEL_POISSON, nSim, opts, cInfo);
+}
 
-	curInfo = cInfo;
-	for(int i = 0; i < nClusters; i++) {
-		curInfo->pValue = (double)(1+llAbove[i]) / (1+nSim);
-		curInfo = curInfo->next;
+/**
+ * NAME:	monteCarloPoiRaster
+ * DESCRIPTION:	calculate the P-Value of each cluster in a Poisson model against a background raster. the events of replication r are drawn from the raster with the random stream (seed, r), then indexed and clustered like the observed events. minCore is not applied to the replications, the same as in the point model
+ * PARAMETERS:
+ * 	struct rasterGrid * ra:	the background raster
+ *	double xMin:			the minimum X of the study area, which covers the raster
+ *	double yMin:			the minimum Y of the study area
+ *	double xMax:			the maximum X of the study area
+ *	double yMax:			the maximum Y of the study area
+ *	double radius:			the search radius the index was built for, with blocks of side radius / subdivide
+ *	int countE:				the number of event points
+ *	double baseLineRatio:	the ratio of the null hypothesis to the baseline
+ *	double significance: 	the significane level to tell a cluste core point
+ *	int minCore:			the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:		whether a cluster include non-core points
+ *	int nSim:				the number of simulation to be conducted
+ *	struct options * opts:	the seed, the range, the checkpoint, the shard file, the null cache and the index of the simulation
+ *	struct clusterInfo * cInfo:		the info of detected clusters, resulting p-values will be written to it
+ * RETURN: none
+ */
+void monteCarloPoiRaster(struct rasterGrid * ra, double xMin, double yMin, double xMax, double yMax, double radius, int countE, double baseLineRatio, double significance, int minCore, bool nonCorePoints, int nSim, struct options * opts, struct clusterInfo * cInfo) {
+
+	unsigned long long key = nullKey(rasterKey(ra), MODEL_POISSON, countE, radius, baseLineRatio, significance, minCore, nonCorePoints, opts);
+	struct mcState * st = startSimulation(cInfo, nSim, opts, key);
+
+	struct rngStream s;
+	double * x;
+	double * y;
+	struct gridIndex * g;
+	struct pointStore * ps;
+	struct neighborCounts * nc;
+	struct clusterInfo * simInfo;
+	int * clusterID;
+	double simMaxLL;
+	int nSaved = st->nDone;
+	struct expandWorkspace * ws = allocExpandWorkspace(countE);
+
+	for(int r = st->first + st->nDone; r < st->nSim; r++) {
+		//Simulate events
+		if(NULL == (x = (double *)malloc(sizeof(double) * countE))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		if(NULL == (y = (double *)malloc(sizeof(double) * countE))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		initRngStream(&s, st->seed, r);
+		for(int i = 0; i < countE; i++) {
+			sampleRaster(ra, &s, x + i, y + i);
+		}
+
+		g = indexPoints(x, y, countE, xMin, yMin, xMax, yMax, radius, opts->subdivide, opts->order);
+		ps = buildPointStore(x, y, NULL, countE, opts->precision, xMin, yMin, xMax, yMax, opts->resolution, false);
+		boundBlocks(g, ps);
+
+		//FindCores
+		nc = allocNeighborCounts(countE, maxStencilCount(g), false);
+		countInDistance_Single(ps, g, radius, nc);
+
+		//GetTopLikelihood
+		simInfo = NULL;
+		clusterID = doClusterPoiRaster(ps, g, ra, radius, countE, nc, baseLineRatio, significance, 0, nonCorePoints, &simInfo, ws);
+		simMaxLL = -1;
+		for(struct clusterInfo * curInfo = simInfo; curInfo != NULL; curInfo = curInfo->next) {
+			if(simMaxLL < curInfo->ll) {
+				simMaxLL = curInfo->ll;
+			}
+		}
+
+		//Compare and update
+		printf("Simulation: %d\tLL: %lf\n", r, simMaxLL);
+		addSimulation(st, simMaxLL);
+		checkpointSimulation(st, opts, key, nSaved);
+
+		recycleClusterInfo(ws, simInfo);
+		free(clusterID);
+		freeNeighborCounts(nc);
+		freePointStore(ps);
+		freeGridIndex(g);
 	}
+
+	freeExpandWorkspace(ws);
+	finishSimulation(st, MODEL_POISSON, nSim, opts, cInfo);
 }
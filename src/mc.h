@@ -1,6 +1,13 @@
 #ifndef MCH
 #define MCH
-void monteCarloBer(double * x, double * y, int * ind, int * index, int nBlockX, int nBlockY, double radius, double xMin, double yMin, int countCas, int countCon, double p, double significance, int minCore, bool nonCorePoints, int nSim, struct clusterInfo * cInfo);
-void monteCarloPoi(double * xB, double * yB, int * indexB, int nBlockX, int nBlockY, double radius, double xMin, double yMin, int countE, int countB, double baseLineRatio, double significance, int minCore, bool nonCorePoints, int nSim, struct clusterInfo * cInfo);
+
+struct pointStore;
+struct gridIndex;
+struct options;
+struct rasterGrid;
+
+void monteCarloBer(struct pointStore * ps, struct gridIndex * g, double radius, int countCas, int countCon, double p, double significance, int minCore, bool nonCorePoints, int nSim, struct options * opts, struct clusterInfo * cInfo);
+void monteCarloPoi(struct pointStore * psB, struct gridIndex * gB, double radius, int countE, int countB, double baseLineRatio, double significance, int minCore, bool nonCorePoints, int nSim, struct options * opts, struct clusterInfo * cInfo);
+void monteCarloPoiRaster(struct rasterGrid * ra, double xMin, double yMin, double xMax, double yMax, double radius, int countE, double baseLineRatio, double significance, int minCore, bool nonCorePoints, int nSim, struct options * opts, struct clusterInfo * cInfo);
 
 #endif
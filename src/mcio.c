@@ -0,0 +1,556 @@
+/**
+ * mcio.c
+ * Date: 10/18/2026
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "clusters.h"
+#include "mcio.h"
+
+#define CHECKPOINT_MAGIC "ESCIBMC3"
+#define SHARD_MAGIC "ESCIBSH1"
+#define NULL_CACHE_MAGIC "ESCIBNC1"
+
+/**
+ * NAME:	newMcState
+ * DESCRIPTION:	start the progress of a Monte Carlo simulation with no replication done
+ * PARAMETERS:
+ * 	struct clusterInfo * cInfo:	the info of detected clusters
+ * 	int first:					the first replication to be conducted
+ * 	int nSim:					the replication to stop before
+ * 	unsigned long long seed:	the seed of the simulation
+ * RETURN:
+ * 	TYPE:	struct mcState *
+ * 	VALUE:	the progress of the simulation
+ */
+struct mcState * newMcState(struct clusterInfo * cInfo, int first, int nSim, unsigned long long seed)
+{
+	struct mcState * st;
+	if(NULL == (st = (struct mcState *)malloc(sizeof(struct mcState))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	st->seed = seed;
+	st->first = first;
+	st->nSim = nSim;
+	st->nDone = 0;
+	st->nClusters = 0;
+	for(struct clusterInfo * curInfo = cInfo; curInfo != NULL; curInfo = curInfo->next)
+		st->nClusters ++;
+
+	if(NULL == (st->cLL = (double *)malloc(sizeof(double) * (st->nClusters + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (st->llAbove = (int *)malloc(sizeof(int) * (st->nClusters + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (st->simLL = (double *)malloc(sizeof(double) * (nSim - first + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	struct clusterInfo * curInfo = cInfo;
+	for(int i = 0; i < st->nClusters; i++)
+	{
+		st->cLL[i] = curInfo->ll;
+		st->llAbove[i] = 0;
+		curInfo = curInfo->next;
+	}
+	return st;
+}
+
+/**
+ * NAME:	freeMcState
+ * DESCRIPTION:	free the progress of a Monte Carlo simulation
+ * PARAMETERS:
+ * 	struct mcState * st:	the progress to free
+ * RETURN: none
+ */
+void freeMcState(struct mcState * st)
+{
+	if(st == NULL)
+		return;
+	free(st->cLL);
+	free(st->llAbove);
+	free(st->simLL);
+	free(st);
+}
+
+/**
+ * NAME:	addSimulation
+ * DESCRIPTION:	record the maximum log likelihood of the next replication and count the clusters it is not below
+ * PARAMETERS:
+ * 	struct mcState * st:	the progress of the simulation
+ * 	double ll:				the maximum log likelihood of the replication (-HUGE_VAL if it has no cluster to compare)
+ * RETURN: none
+ */
+void addSimulation(struct mcState * st, double ll)
+{
+	st->simLL[st->nDone] = ll;
+	st->nDone ++;
+	for(int j = 0; j < st->nClusters; j++)
+	{
+		if(st->cLL[j] <= ll)
+			st->llAbove[j] ++;
+	}
+}
+
+/**
+ * NAME:	setPValues
+ * DESCRIPTION:	write the p-values of the simulated replications to the info of detected clusters. a simulation of only a range of the replications (a shard) has no p-value of its own, ESCIB_Merge gives it from all shards, so NAN is written then
+ * PARAMETERS:
+ * 	struct mcState * st:		the progress of the simulation
+ * 	int nSim:					the number of replications of the whole simulation
+ * 	struct clusterInfo * cInfo:	the info of detected clusters
+ * RETURN: none
+ */
+void setPValues(struct mcState * st, int nSim, struct clusterInfo * cInfo)
+{
+	bool whole = (st->first == 0 && st->nSim == nSim);
+	struct clusterInfo * curInfo = cInfo;
+	for(int i = 0; i < st->nClusters; i++)
+	{
+		curInfo->pValue = whole ? (double)(1 + st->llAbove[i]) / (1 + st->nDone) : NAN;
+		curInfo = curInfo->next;
+	}
+}
+
+/**
+ * NAME:	loadCheckpoint
+ * DESCRIPTION:	resume a simulation from a checkpoint. the checkpoint must have been written under the same key of the points and parameters, for the same detected clusters and first replication; its seed replaces the seed of the simulation, and replications beyond the number to be conducted are dropped
+ * PARAMETERS:
+ * 	const char * file:		the checkpoint file
+ * 	unsigned long long key:	the key of the null distribution, see loadNullCache
+ * 	struct mcState * st:	the progress of the simulation, with no replication done
+ * RETURN:
+ * 	TYPE:	bool
+ * 	VALUE:	true if the checkpoint was loaded, false if the file does not exist
+ */
+bool loadCheckpoint(const char * file, unsigned long long key, struct mcState * st)
+{
+	FILE * input;
+	char magic[8];
+	unsigned long long fileKey;
+	int first, nClusters, nDone;
+	double ll;
+
+	if(NULL == (input = fopen(file, "rb")))
+		return false;
+
+	if(fread(magic, 1, 8, input) != 8 || memcmp(magic, CHECKPOINT_MAGIC, 8) != 0
+		|| fread(&fileKey, sizeof(unsigned long long), 1, input) != 1
+		|| fread(&st->seed, sizeof(unsigned long long), 1, input) != 1
+		|| fread(&first, sizeof(int), 1, input) != 1
+		|| fread(&nClusters, sizeof(int), 1, input) != 1
+		|| fread(&nDone, sizeof(int), 1, input) != 1)
+	{
+		printf("ERROR: %s is not a Monte Carlo checkpoint.\n", file);
+		exit(1);
+	}
+	if(fileKey != key)
+	{
+		printf("ERROR: Checkpoint %s was written for other points or parameters.\n", file);
+		exit(1);
+	}
+	if(first != st->first)
+	{
+		printf("ERROR: Checkpoint %s starts at replication %d, not %d.\n", file, first, st->first);
+		exit(1);
+	}
+	if(nClusters != st->nClusters)
+	{
+		printf("ERROR: Checkpoint %s was written for different clusters.\n", file);
+		exit(1);
+	}
+	for(int i = 0; i < nClusters; i++)
+	{
+		if(fread(&ll, sizeof(double), 1, input) != 1 || ll != st->cLL[i])
+		{
+			printf("ERROR: Checkpoint %s was written for different clusters.\n", file);
+			exit(1);
+		}
+	}
+	//the tallies are recounted from the replications, which may be fewer than the checkpoint holds
+	if(fseek(input, sizeof(int) * nClusters, SEEK_CUR) != 0)
+	{
+		printf("ERROR: Checkpoint %s is truncated.\n", file);
+		exit(1);
+	}
+	for(int i = 0; i < nDone && first + i < st->nSim; i++)
+	{
+		if(fread(&ll, sizeof(double), 1, input) != 1)
+		{
+			printf("ERROR: Checkpoint %s is truncated.\n", file);
+			exit(1);
+		}
+		addSimulation(st, ll);
+	}
+
+	fclose(input);
+	return true;
+}
+
+/**
+ * NAME:	saveCheckpoint
+ * DESCRIPTION:	write the progress of a simulation to a checkpoint: the key of the points and parameters, the seed, the first replication, the number of replications done, the log likelihoods of detected clusters, the tallies of replications not below each of them and the maximum log likelihood of every replication. the file is replaced atomically, so a preempted run always leaves a complete checkpoint
+ * PARAMETERS:
+ * 	const char * file:		the checkpoint file
+ * 	unsigned long long key:	the key of the null distribution
+ * 	struct mcState * st:	the progress of the simulation
+ * RETURN: none
+ */
+void saveCheckpoint(const char * file, unsigned long long key, struct mcState * st)
+{
+	FILE * output;
+	char * tmpFile = (char *) malloc((strlen(file) + 10) * sizeof(char));
+	tmpFile[0] = '\0';
+	strcat(tmpFile, file);
+	strcat(tmpFile, ".tmp");
+
+	if(NULL == (output = fopen(tmpFile, "wb")))
+	{
+		printf("ERROR: Can't open the checkpoint file.\n");
+		exit(1);
+	}
+
+	fwrite(CHECKPOINT_MAGIC, 1, 8, output);
+	fwrite(&key, sizeof(unsigned long long), 1, output);
+	fwrite(&st->seed, sizeof(unsigned long long), 1, output);
+	fwrite(&st->first, sizeof(int), 1, output);
+	fwrite(&st->nClusters, sizeof(int), 1, output);
+	fwrite(&st->nDone, sizeof(int), 1, output);
+	fwrite(st->cLL, sizeof(double), st->nClusters, output);
+	fwrite(st->llAbove, sizeof(int), st->nClusters, output);
+	fwrite(st->simLL, sizeof(double), st->nDone, output);
+
+	if(fclose(output) != 0 || rename(tmpFile, file) != 0)
+	{
+		printf("ERROR: Can't write the checkpoint file.\n");
+		exit(1);
+	}
+	free(tmpFile);
+}
+
+/**
+ * NAME:	loadNullCache
+ * DESCRIPTION:	take the replications of a simulation from a null cache. the maximum log likelihoods under the null hypothesis do not depend on the observed clusters, so a cache written under the same key serves any run on the same points; its seed replaces the seed of the simulation, and replications beyond the number to be conducted are not used. a cache written under another key is ignored with a warning, and replaced by the cache of this run when it is saved
+ * PARAMETERS:
+ * 	const char * file:			the null cache file
+ * 	unsigned long long key:		the key of the null hypothesis
+ * 	struct mcState * st:		the progress of the simulation, from the first replication with no replication done
+ * RETURN:
+ * 	TYPE:	bool
+ * 	VALUE:	true if the cache was loaded, false if the file does not exist or has another key
+ */
+bool loadNullCache(const char * file, unsigned long long key, struct mcState * st)
+{
+	FILE * input;
+	char magic[8];
+	unsigned long long fileKey;
+	unsigned long long seed;
+	int nDone;
+	double ll;
+
+	if(NULL == (input = fopen(file, "rb")))
+		return false;
+
+	if(fread(magic, 1, 8, input) != 8 || memcmp(magic, NULL_CACHE_MAGIC, 8) != 0
+		|| fread(&fileKey, sizeof(unsigned long long), 1, input) != 1
+		|| fread(&seed, sizeof(unsigned long long), 1, input) != 1
+		|| fread(&nDone, sizeof(int), 1, input) != 1)
+	{
+		printf("ERROR: %s is not a null cache.\n", file);
+		exit(1);
+	}
+	//a stale cache at a reused path is started afresh rather than aborting the run
+	if(fileKey != key)
+	{
+		printf("WARNING: Null cache %s was written for different points or parameters, a new cache replaces it.\n", file);
+		fclose(input);
+		return false;
+	}
+	st->seed = seed;
+	for(int i = 0; i < nDone && i < st->nSim; i++)
+	{
+		if(fread(&ll, sizeof(double), 1, input) != 1)
+		{
+			printf("ERROR: Null cache %s is truncated.\n", file);
+			exit(1);
+		}
+		addSimulation(st, ll);
+	}
+
+	fclose(input);
+	return true;
+}
+
+/**
+ * NAME:	saveNullCache
+ * DESCRIPTION:	write the replications of a simulation to a null cache: the key, the seed, the number of replications and the maximum log likelihood of every replication. like a checkpoint, the file is replaced atomically
+ * PARAMETERS:
+ * 	const char * file:			the null cache file
+ * 	unsigned long long key:		the key of the null hypothesis
+ * 	struct mcState * st:		the progress of the simulation, from the first replication
+ * RETURN: none
+ */
+void saveNullCache(const char * file, unsigned long long key, struct mcState * st)
+{
+	FILE * output;
+	char * tmpFile = (char *) malloc((strlen(file) + 10) * sizeof(char));
+	tmpFile[0] = '\0';
+	strcat(tmpFile, file);
+	strcat(tmpFile, ".tmp");
+
+	if(NULL == (output = fopen(tmpFile, "wb")))
+	{
+		printf("ERROR: Can't open the null cache file.\n");
+		exit(1);
+	}
+
+	fwrite(NULL_CACHE_MAGIC, 1, 8, output);
+	fwrite(&key, sizeof(unsigned long long), 1, output);
+	fwrite(&st->seed, sizeof(unsigned long long), 1, output);
+	fwrite(&st->nDone, sizeof(int), 1, output);
+	fwrite(st->simLL, sizeof(double), st->nDone, output);
+
+	if(fclose(output) != 0 || rename(tmpFile, file) != 0)
+	{
+		printf("ERROR: Can't write the null cache file.\n");
+		exit(1);
+	}
+	free(tmpFile);
+}
+
+/**
+ * NAME:	saveShard
+ * DESCRIPTION:	write the result of a simulated range of replications, to be merged with the other ranges by ESCIB_Merge: the model, the seed, the range, the total number of replications, the detected clusters and the maximum log likelihood of every replication in the range
+ * PARAMETERS:
+ * 	const char * file:			the shard file
+ * 	struct mcState * st:		the progress of the simulation, with the whole range done
+ * 	int model:					MODEL_BERNOULLI or MODEL_POISSON
+ * 	int nSimTotal:				the number of replications of all shards
+ * 	struct clusterInfo * cInfo:	the info of detected clusters
+ * RETURN: none
+ */
+void saveShard(const char * file, struct mcState * st, int model, int nSimTotal, struct clusterInfo * cInfo)
+{
+	FILE * output;
+
+	if(NULL == (output = fopen(file, "wb")))
+	{
+		printf("ERROR: Can't open the shard file.\n");
+		exit(1);
+	}
+
+	fwrite(SHARD_MAGIC, 1, 8, output);
+	fwrite(&model, sizeof(int), 1, output);
+	fwrite(&st->seed, sizeof(unsigned long long), 1, output);
+	fwrite(&st->first, sizeof(int), 1, output);
+	fwrite(&st->nDone, sizeof(int), 1, output);
+	fwrite(&nSimTotal, sizeof(int), 1, output);
+	fwrite(&st->nClusters, sizeof(int), 1, output);
+	for(struct clusterInfo * curInfo = cInfo; curInfo != NULL; curInfo = curInfo->next)
+	{
+		fwrite(&curInfo->clusterID, sizeof(int), 1, output);
+		fwrite(&curInfo->count0, sizeof(int), 1, output);
+		fwrite(&curInfo->count1, sizeof(int), 1, output);
+		fwrite(&curInfo->expCount1, sizeof(double), 1, output);
+		fwrite(&curInfo->ll, sizeof(double), 1, output);
+	}
+	fwrite(st->simLL, sizeof(double), st->nDone, output);
+
+	if(fclose(output) != 0)
+	{
+		printf("ERROR: Can't write the shard file.\n");
+		exit(1);
+	}
+}
+
+/**
+ * NAME:	loadShard
+ * DESCRIPTION:	read the result of a simulated range of replications
+ * PARAMETERS:
+ * 	const char * file:	the shard file
+ * RETURN:
+ * 	TYPE:	struct mcShard *
+ * 	VALUE:	the shard
+ */
+struct mcShard * loadShard(const char * file)
+{
+	FILE * input;
+	char magic[8];
+	int nClusters;
+	struct mcShard * sh;
+	struct clusterInfo * curInfo = NULL;
+	bool ok;
+
+	if(NULL == (input = fopen(file, "rb")))
+	{
+		printf("ERROR: Can't open the shard file %s.\n", file);
+		exit(1);
+	}
+	if(NULL == (sh = (struct mcShard *)malloc(sizeof(struct mcShard))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	ok = fread(magic, 1, 8, input) == 8 && memcmp(magic, SHARD_MAGIC, 8) == 0
+		&& fread(&sh->model, sizeof(int), 1, input) == 1
+		&& fread(&sh->seed, sizeof(unsigned long long), 1, input) == 1
+		&& fread(&sh->first, sizeof(int), 1, input) == 1
+		&& fread(&sh->nDone, sizeof(int), 1, input) == 1
+		&& fread(&sh->nSim, sizeof(int), 1, input) == 1
+		&& fread(&nClusters, sizeof(int), 1, input) == 1;
+	if(!ok)
+	{
+		printf("ERROR: %s is not a Monte Carlo shard.\n", file);
+		exit(1);
+	}
+
+	sh->cInfo = NULL;
+	for(int i = 0; i < nClusters; i++)
+	{
+		if(i == 0) {
+			sh->cInfo = (struct clusterInfo *) malloc (sizeof (struct clusterInfo));
+			curInfo = sh->cInfo;
+		}
+		else {
+			curInfo->next = (struct clusterInfo *) malloc (sizeof (struct clusterInfo));
+			curInfo = curInfo->next;
+		}
+		curInfo->next = NULL;
+		ok = fread(&curInfo->clusterID, sizeof(int), 1, input) == 1
+			&& fread(&curInfo->count0, sizeof(int), 1, input) == 1
+			&& fread(&curInfo->count1, sizeof(int), 1, input) == 1
+			&& fread(&curInfo->expCount1, sizeof(double), 1, input) == 1
+			&& fread(&curInfo->ll, sizeof(double), 1, input) == 1;
+		if(!ok)
+		{
+			printf("ERROR: Shard %s is truncated.\n", file);
+			exit(1);
+		}
+	}
+
+	if(NULL == (sh->simLL = (double *)malloc(sizeof(double) * (sh->nDone + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(fread(sh->simLL, sizeof(double), sh->nDone, input) != (size_t)sh->nDone)
+	{
+		printf("ERROR: Shard %s is truncated.\n", file);
+		exit(1);
+	}
+
+	fclose(input);
+	return sh;
+}
+
+/**
+ * NAME:	freeShard
+ * DESCRIPTION:	free a shard
+ * PARAMETERS:
+ * 	struct mcShard * sh:	the shard to free
+ * RETURN: none
+ */
+void freeShard(struct mcShard * sh)
+{
+	if(sh == NULL)
+		return;
+	freeClusterInfo(sh->cInfo);
+	free(sh->simLL);
+	free(sh);
+}
+
+/**
+ * NAME:	writeClusterInfo
+ * DESCRIPTION:	write the info of detected clusters to a csv file
+ * PARAMETERS:
+ * 	const char * file:			the output file
+ * 	int model:					MODEL_BERNOULLI or MODEL_POISSON
+ * 	struct clusterInfo * cInfo:	the info of detected clusters
+ * 	bool pValue:				whether to write the p-value of each cluster, NA if it is NAN
+ * RETURN: none
+ */
+void writeClusterInfo(const char * file, int model, struct clusterInfo * cInfo, bool pValue)
+{
+	FILE * output;
+
+	if(NULL == (output = fopen(file, "w"))) {
+		printf("ERROR: Can't open the output file.\n");
+		exit(1);
+	}
+
+	if(model == MODEL_BERNOULLI) {
+		if(pValue) {
+			fprintf(output, "ClusterID,nCas,nCon,LL,pValue\n");
+		}
+		else {
+			fprintf(output, "ClusterID,nCas,nCon,LL\n");
+		}
+	}
+	else {
+		if(pValue) {
+			fprintf(output, "ClusterID,Events,expEvents,LL,PValue\n");
+		}
+		else {
+			fprintf(output, "ClusterID,Events,expEvents,LL\n");
+		}
+	}
+
+	for(struct clusterInfo * curInfo = cInfo; curInfo != NULL; curInfo = curInfo->next) {
+		if(model == MODEL_BERNOULLI) {
+			if(pValue) {
+				if(isnan(curInfo->pValue))
+					fprintf(output, "%d,%d,%d,%lf,NA\n", curInfo->clusterID, curInfo->count1, curInfo->count0, curInfo->ll);
+				else
+					fprintf(output, "%d,%d,%d,%lf,%lf\n", curInfo->clusterID, curInfo->count1, curInfo->count0, curInfo->ll, curInfo->pValue);
+			}
+			else {
+				fprintf(output, "%d,%d,%d,%lf\n", curInfo->clusterID, curInfo->count1, curInfo->count0, curInfo->ll);
+			}
+		}
+		else {
+			if(pValue) {
+				if(isnan(curInfo->pValue))
+					fprintf(output, "%d,%d,%lf,%lf,NA\n", curInfo->clusterID, curInfo->count1, curInfo->expCount1, curInfo->ll);
+				else
+					fprintf(output, "%d,%d,%lf,%lf,%lf\n", curInfo->clusterID, curInfo->count1, curInfo->expCount1, curInfo->ll, curInfo->pValue);
+			}
+			else {
+				fprintf(output, "%d,%d,%lf,%lf\n", curInfo->clusterID, curInfo->count1, curInfo->expCount1, curInfo->ll);
+			}
+		}
+	}
+
+	fclose(output);
+}
+
+/**
+ * NAME:	freeClusterInfo
+ * DESCRIPTION:	free the info of detected clusters
+ * PARAMETERS:
+ * 	struct clusterInfo * cInfo:	the info to free
+ * RETURN: none
+ */
+void freeClusterInfo(struct clusterInfo * cInfo)
+{
+	struct clusterInfo * next;
+	while(cInfo != NULL) {
+		next = cInfo->next;
+		free(cInfo);
+		cInfo = next;
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef MCIOH
+#define MCIOH
+
+#define MODEL_BERNOULLI 0
+#define MODEL_POISSON 1
+
+struct clusterInfo;
+
+//the progress of a Monte Carlo simulation
+struct mcState {
+	unsigned long long seed;
+	int first;
+	int nSim;
+	int nDone;
+	int nClusters;
+	double * cLL;
+	int * llAbove;
+	double * simLL;
+};
+
+//the replications of a range simulated by one process, with the clusters they are compared to
+struct mcShard {
+	int model;
+	unsigned long long seed;
+	int first;
+	int nDone;
+	int nSim;
+	struct clusterInfo * cInfo;
+	double * simLL;
+};
+
+struct mcState * newMcState(struct clusterInfo * cInfo, int first, int nSim, unsigned long long seed);
+void freeMcState(struct mcState * st);
+void addSimulation(struct mcState * st, double ll);
+void setPValues(struct mcState * st, int nSim, struct clusterInfo * cInfo);
+bool loadCheckpoint(const char * file, unsigned long long key, struct mcState * st);
+void saveCheckpoint(const char * file, unsigned long long key, struct mcState * st);
+bool loadNullCache(const char * file, unsigned long long key, struct mcState * st);
+void saveNullCache(const char * file, unsigned long long key, struct mcState * st);
+void saveShard(const char * file, struct mcState * st, int model, int nSimTotal, struct clusterInfo * cInfo);
+struct mcShard * loadShard(const char * file);
+void freeShard(struct mcShard * sh);
+void writeClusterInfo(const char * file, int model, struct clusterInfo * cInfo, bool pValue);
+void freeClusterInfo(struct clusterInfo * cInfo);
+
+#endif
@@ -0,0 +1,258 @@
+/**
+ * memory.c
+ * Date: 10/18/2026
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <omp.h>
+#include "memory.h"
+
+//the numbers of the kernel's memory policy interface, so that libnuma is not needed
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+#ifndef MPOL_F_MEMS_ALLOWED
+#define MPOL_F_MEMS_ALLOWED (1 << 2)
+#endif
+#define MAX_NODES 1024
+
+//the policy is set once by the program before any large array is allocated
+static bool policyHugePages = false;
+static int policyNuma = NUMA_DEFAULT;
+static int nLargeArrays = 0;
+static double largeBytes = 0;
+
+/**
+ * NAME:	allowedNodes
+ * DESCRIPTION:	get the NUMA nodes the process may allocate memory on
+ * PARAMETERS:
+ * 	unsigned long * mask:	the output mask of the nodes, MAX_NODES bits
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the number of nodes, 1 if the kernel can't tell
+ */
+static int allowedNodes(unsigned long * mask)
+{
+	int bits = 8 * sizeof(unsigned long);
+	int nNodes = 0;
+	memset(mask, 0, MAX_NODES / 8);
+#ifdef SYS_get_mempolicy
+	int mode;
+	if(0 != syscall(SYS_get_mempolicy, &mode, mask, MAX_NODES, NULL, MPOL_F_MEMS_ALLOWED))
+	{
+		mask[0] = 1;
+		return 1;
+	}
+	for(int i = 0; i < MAX_NODES; i++)
+	{
+		if((mask[i / bits] >> (i % bits)) & 1)
+			nNodes ++;
+	}
+#endif
+	if(nNodes == 0)
+	{
+		mask[0] = 1;
+		nNodes = 1;
+	}
+	return nNodes;
+}
+
+/**
+ * NAME:	setMemoryPolicy
+ * DESCRIPTION:	set how the large arrays of points and of their counts, labels and clusters are placed in memory
+ * PARAMETERS:
+ * 	bool hugePages:	whether the arrays are aligned to 2 MB huge pages and the kernel is asked to back them with (transparent) huge pages
+ * 	int numa:		NUMA_DEFAULT to leave the pages on the node of the thread that writes them first, NUMA_FIRST_TOUCH to touch the pages of each array over the OpenMP threads in equal contiguous shares when it is allocated, or NUMA_INTERLEAVE to spread the pages over all nodes
+ * RETURN: none
+ */
+void setMemoryPolicy(bool hugePages, int numa)
+{
+	policyHugePages = hugePages;
+	policyNuma = numa;
+}
+
+/**
+ * NAME:	firstTouchPlacement
+ * DESCRIPTION:	get whether the pages of the large arrays are touched by the OpenMP threads in equal contiguous shares when they are allocated. the parallel kernels then give each thread the points of its own share, instead of scheduling them dynamically, so that each thread works on the memory of its own node
+ * PARAMETERS: none
+ * RETURN:
+ * 	TYPE:	bool
+ * 	VALUE:	whether the policy is NUMA_FIRST_TOUCH
+ */
+bool firstTouchPlacement()
+{
+	return policyNuma == NUMA_FIRST_TOUCH;
+}
+
+/**
+ * NAME:	placeArray
+ * DESCRIPTION:	apply the memory policy to the pages of a new array, before it is written
+ * PARAMETERS:
+ * 	void * a:		the array
+ * 	size_t bytes:	the size of the array
+ * RETURN: none
+ */
+static void placeArray(void * a, size_t bytes)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	//only the pages that lie wholly within the array are its own
+	char * lo = (char *)(((size_t)a + page - 1) / page * page);
+	char * hi = (char *)(((size_t)a + bytes) / page * page);
+	if(hi <= lo)
+		return;
+
+#ifdef MADV_HUGEPAGE
+	if(policyHugePages)
+		madvise(lo, hi - lo, MADV_HUGEPAGE);
+#endif
+#ifdef SYS_mbind
+	if(policyNuma == NUMA_INTERLEAVE)
+	{
+		unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))];
+		if(allowedNodes(mask) > 1)
+			syscall(SYS_mbind, lo, hi - lo, MPOL_INTERLEAVE, mask, MAX_NODES, 0);
+	}
+#endif
+	if(policyNuma == NUMA_FIRST_TOUCH)
+	{
+		long long nPages = (hi - lo) / page;
+		//thread t of n touches the pages from share t / n to (t + 1) / n of the array, the same shares of the points countInDistance gives each thread, see firstTouchPlacement
+		#pragma omp parallel
+		{
+			long long t = omp_get_thread_num();
+			long long nThreads = omp_get_num_threads();
+			for(long long k = nPages * t / nThreads; k < nPages * (t + 1) / nThreads; k++)
+			{
+				lo[k * page] = 0;
+			}
+		}
+	}
+}
+
+/**
+ * NAME:	allocArray
+ * DESCRIPTION:	allocate an array under the memory policy, to be freed with free. arrays smaller than a huge page are allocated with malloc
+ * PARAMETERS:
+ * 	size_t bytes:	the size of the array
+ * RETURN:
+ * 	TYPE:	void *
+ * 	VALUE:	the array, or NULL if out of memory
+ */
+void * allocArray(size_t bytes)
+{
+	void * a;
+	if(bytes < HUGE_PAGE_BYTES)
+		return malloc(bytes);
+
+	if(policyHugePages)
+	{
+		if(0 != posix_memalign(&a, HUGE_PAGE_BYTES, bytes))
+			return NULL;
+	}
+	else if(NULL == (a = malloc(bytes)))
+		return NULL;
+
+	nLargeArrays ++;
+	largeBytes += bytes;
+	if(policyHugePages || policyNuma != NUMA_DEFAULT)
+		placeArray(a, bytes);
+	return a;
+}
+
+/**
+ * NAME:	allocZeroArray
+ * DESCRIPTION:	allocArray with every byte set to 0
+ * PARAMETERS:
+ * 	size_t bytes:	the size of the array
+ * RETURN:
+ * 	TYPE:	void *
+ * 	VALUE:	the array, or NULL if out of memory
+ */
+void * allocZeroArray(size_t bytes)
+{
+	void * a;
+	//calloc gets fresh zero pages from the kernel without writing them
+	if(bytes < HUGE_PAGE_BYTES || (!policyHugePages && policyNuma == NUMA_DEFAULT))
+	{
+		if(bytes >= HUGE_PAGE_BYTES)
+		{
+			nLargeArrays ++;
+			largeBytes += bytes;
+		}
+		return calloc(bytes, 1);
+	}
+	if(NULL == (a = allocArray(bytes)))
+		return NULL;
+	memset(a, 0, bytes);
+	return a;
+}
+
+/**
+ * NAME:	hugePageBytes
+ * DESCRIPTION:	get the memory of the process backed by transparent huge pages
+ * PARAMETERS: none
+ * RETURN:
+ * 	TYPE:	double
+ * 	VALUE:	the number of bytes, -1 if the kernel does not report it
+ */
+static double hugePageBytes()
+{
+	FILE * file;
+	char line[256];
+	double kB = -1;
+	if(NULL == (file = fopen("/proc/self/smaps_rollup", "r")))
+		return -1;
+	while(fgets(line, sizeof(line), file) != NULL)
+	{
+		if(1 == sscanf(line, "AnonHugePages: %lf kB", &kB))
+			break;
+	}
+	fclose(file);
+	return kB < 0 ? -1 : kB * 1024;
+}
+
+/**
+ * NAME:	printMemoryReport
+ * DESCRIPTION:	print the large arrays allocated so far, how much of the memory is on huge pages, and where the pages and the threads are placed
+ * PARAMETERS: none
+ * RETURN: none
+ */
+void printMemoryReport()
+{
+	const char * numaNames[3] = {"default", "firstTouch", "interleave"};
+	const char * bindNames[5] = {"none", "true", "master", "close", "spread"};
+	unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))];
+	double huge = hugePageBytes();
+	int bind = (int)omp_get_proc_bind();
+
+	printf("Large arrays: %d, %.1lf MB (huge pages: %s)\n", nLargeArrays, largeBytes / (1 << 20), policyHugePages ? "2 MB" : "default");
+	if(huge >= 0)
+		printf("Memory on huge pages: %.1lf MB\n", huge / (1 << 20));
+	printf("NUMA placement: %s over %d node(s), %d thread(s), binding %s\n", numaNames[policyNuma], allowedNodes(mask), omp_get_max_threads(), (bind >= 0 && bind < 5) ? bindNames[bind] : "other");
+}
+
+/**
+ * NAME:	parseNumaPolicy
+ * DESCRIPTION:	parse the name of a NUMA placement
+ * PARAMETERS:
+ * 	const char * name:	default, firstTouch or interleave
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	NUMA_DEFAULT, NUMA_FIRST_TOUCH or NUMA_INTERLEAVE, or -1 if the name is unknown
+ */
+int parseNumaPolicy(const char * name)
+{
+	if(strcmp(name, "default") == 0)
+		return NUMA_DEFAULT;
+	if(strcmp(name, "firstTouch") == 0)
+		return NUMA_FIRST_TOUCH;
+	if(strcmp(name, "interleave") == 0)
+		return NUMA_INTERLEAVE;
+	return -1;
+}
@@ -0,0 +1,20 @@
+#ifndef MEMH
+#define MEMH
+
+#include <stddef.h>
+
+#define NUMA_DEFAULT 0
+#define NUMA_FIRST_TOUCH 1
+#define NUMA_INTERLEAVE 2
+
+//arrays of at least one huge page get the memory policy, smaller ones are plain malloc
+#define HUGE_PAGE_BYTES (1 << 21)
+
+void setMemoryPolicy(bool hugePages, int numa);
+bool firstTouchPlacement();
+void * allocArray(size_t bytes);
+void * allocZeroArray(size_t bytes);
+void printMemoryReport();
+int parseNumaPolicy(const char * name);
+
+#endif
@@ -0,0 +1,503 @@
+/**
+ * optics.c
+ * Date: 10/18/2026
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "io.h"
+#include "points.h"
+#include "optics.h"
+
+#define OPTICS_MAGIC "ESCIBOP1"
+
+/**
+ * NAME:	allocOPTICS
+ * DESCRIPTION:	allocate an OPTICS ordering
+ * PARAMETERS:
+ * 	int count:	the number of points
+ * RETURN:
+ * 	TYPE:	struct opticsOrder *
+ * 	VALUE:	the ordering
+ */
+static struct opticsOrder * allocOPTICS(int count)
+{
+	struct opticsOrder * oo;
+	if(NULL == (oo = (struct opticsOrder *)malloc(sizeof(struct opticsOrder))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	oo->count = count;
+	if(NULL == (oo->x = (double *)malloc(sizeof(double) * (count + 1))) || NULL == (oo->y = (double *)malloc(sizeof(double) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (oo->coreDist2 = (double *)malloc(sizeof(double) * (count + 1))) || NULL == (oo->reach2 = (double *)malloc(sizeof(double) * (count + 1)))
+		|| NULL == (oo->borderDist2 = (double *)malloc(sizeof(double) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (oo->borderOf = (int *)malloc(sizeof(int) * (count + 1))) || NULL == (oo->order = (int *)malloc(sizeof(int) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	return oo;
+}
+
+/**
+ * NAME:	siftUp
+ * DESCRIPTION:	move a point up the seed heap until its parent is not farther (ties are broken by the array index, so the ordering is deterministic)
+ */
+static void siftUp(int * heap, int * pos, double * key, int k)
+{
+	int p = heap[k];
+	int parent;
+	while(k > 0)
+	{
+		parent = (k - 1) / 2;
+		if(key[heap[parent]] < key[p] || (key[heap[parent]] == key[p] && heap[parent] < p))
+			break;
+		heap[k] = heap[parent];
+		pos[heap[k]] = k;
+		k = parent;
+	}
+	heap[k] = p;
+	pos[p] = k;
+}
+
+/**
+ * NAME:	siftDown
+ * DESCRIPTION:	move a point down the seed heap until its children are not nearer
+ */
+static void siftDown(int * heap, int * pos, double * key, int n, int k)
+{
+	int p = heap[k];
+	int child;
+	while((child = 2 * k + 1) < n)
+	{
+		if(child + 1 < n && (key[heap[child + 1]] < key[heap[child]] || (key[heap[child + 1]] == key[heap[child]] && heap[child + 1] < heap[child])))
+			child ++;
+		if(key[p] < key[heap[child]] || (key[p] == key[heap[child]] && p < heap[child]))
+			break;
+		heap[k] = heap[child];
+		pos[heap[k]] = k;
+		k = child;
+	}
+	heap[k] = p;
+	pos[p] = k;
+}
+
+/**
+ * NAME:	orderPoints
+ * DESCRIPTION:	compute the core distance of every point, the OPTICS ordering of the points and the smallest reachability distance of every point, using the search stencil of an index for a search radius of at least maxRadius
+ * PARAMETERS:
+ * 	T * x: 			the array of points' X values, in the precision of the point store
+ * 	T * y: 			the array of points' Y values, in the precision of the point store
+ * 	struct gridIndex * g:	the index of all points
+ *	D maxDist2:		the squared maximum radius in the precision of the point store
+ *	int minPts:		the minimum points to form a core points
+ * 	struct opticsOrder * oo:	the resulting ordering
+ * RETURN: none
+ */
+template <typename T, typename D>
+static void orderPoints(T * x, T * y, struct gridIndex * g, D maxDist2, int minPts, struct opticsOrder * oo)
+{
+	int count = g->count;
+	int nBlockX = g->nBlockX;
+	int nBlockY = g->nBlockY;
+	int colID, rowID;
+	int nbID, n, p;
+	D d2;
+
+	int * blockOf;
+	double * dist;
+	if(NULL == (blockOf = (int *)malloc(sizeof(int) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (dist = (double *)malloc(sizeof(double) * (maxStencilCount(g) + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	//CoreDistances: the minPts-th smallest distance within maxRadius, the point itself included
+	for(int blockID = 0; blockID < nBlockX * nBlockY; blockID ++)
+	{
+		colID = blockID % nBlockX;
+		rowID = blockID / nBlockX;
+		for(int i = g->start[blockID]; i < g->end[blockID]; i++)
+		{
+			blockOf[i] = blockID;
+			n = 0;
+			for(int s = 0; s < g->nStencil; s ++)
+			{
+				if(-1 == (nbID = stencilBlock(g, colID, rowID, s)))
+					continue;
+				for(int j = g->start[nbID]; j < g->end[nbID]; j++)
+				{
+					d2 = squaredDistance<T, D>(x[i], y[i], x[j], y[j]);
+					if(d2 <= maxDist2)
+						dist[n ++] = (double)d2;
+				}
+			}
+			if(n >= minPts)
+			{
+				std::nth_element(dist, dist + minPts - 1, dist + n);
+				oo->coreDist2[i] = dist[minPts - 1];
+			}
+			else
+			{
+				oo->coreDist2[i] = HUGE_VAL;
+			}
+		}
+	}
+	free(dist);
+
+	//Ordering: always expand the seed with the smallest reachability distance next
+	bool * done;
+	int * heap;
+	int * pos;
+	if(NULL == (done = (bool *)malloc(sizeof(bool) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (heap = (int *)malloc(sizeof(int) * (count + 1))) || NULL == (pos = (int *)malloc(sizeof(int) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int i = 0; i < count; i++)
+	{
+		done[i] = false;
+		pos[i] = -1;
+		oo->reach2[i] = HUGE_VAL;
+	}
+
+	int nOrdered = 0;
+	int nHeap = 0;
+	double r2;
+	for(int i = 0; i < count; i++)
+	{
+		if(done[i])
+			continue;
+		heap[0] = i;
+		pos[i] = 0;
+		nHeap = 1;
+		while(nHeap > 0)
+		{
+			p = heap[0];
+			pos[p] = -1;
+			nHeap --;
+			if(nHeap > 0)
+			{
+				heap[0] = heap[nHeap];
+				siftDown(heap, pos, oo->reach2, nHeap, 0);
+			}
+			done[p] = true;
+			oo->order[nOrdered ++] = p;
+			if(oo->coreDist2[p] == HUGE_VAL)
+				continue;
+
+			colID = blockOf[p] % nBlockX;
+			rowID = blockOf[p] / nBlockX;
+			for(int s = 0; s < g->nStencil; s ++)
+			{
+				if(-1 == (nbID = stencilBlock(g, colID, rowID, s)))
+					continue;
+				for(int j = g->start[nbID]; j < g->end[nbID]; j++)
+				{
+					if(done[j])
+						continue;
+					d2 = squaredDistance<T, D>(x[p], y[p], x[j], y[j]);
+					if(d2 > maxDist2)
+						continue;
+					r2 = ((double)d2 > oo->coreDist2[p]) ? (double)d2 : oo->coreDist2[p];
+					if(r2 >= oo->reach2[j])
+						continue;
+					oo->reach2[j] = r2;
+					if(pos[j] < 0)
+					{
+						heap[nHeap] = j;
+						pos[j] = nHeap;
+						nHeap ++;
+					}
+					siftUp(heap, pos, oo->reach2, pos[j]);
+				}
+			}
+		}
+	}
+	free(done);
+	free(heap);
+	free(pos);
+
+	//BorderDistances: the smallest reachability distance of each point from any core point, so border points can be given to a cluster at any radius
+	for(int i = 0; i < count; i++)
+	{
+		oo->borderDist2[i] = HUGE_VAL;
+		oo->borderOf[i] = -1;
+		colID = blockOf[i] % nBlockX;
+		rowID = blockOf[i] / nBlockX;
+		for(int s = 0; s < g->nStencil; s ++)
+		{
+			if(-1 == (nbID = stencilBlock(g, colID, rowID, s)))
+				continue;
+			for(int j = g->start[nbID]; j < g->end[nbID]; j++)
+			{
+				if(oo->coreDist2[j] >= oo->borderDist2[i])
+					continue;
+				d2 = squaredDistance<T, D>(x[i], y[i], x[j], y[j]);
+				if(d2 > maxDist2)
+					continue;
+				r2 = ((double)d2 > oo->coreDist2[j]) ? (double)d2 : oo->coreDist2[j];
+				if(r2 < oo->borderDist2[i])
+				{
+					oo->borderDist2[i] = r2;
+					oo->borderOf[i] = j;
+				}
+			}
+		}
+	}
+	free(blockOf);
+}
+
+/**
+ * NAME:	computeOPTICS
+ * DESCRIPTION:	compute the OPTICS ordering of all points up to a maximum radius, in the precision of the point store
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points
+ * 	struct gridIndex * g:	the index of all points, for a search radius of at least maxRadius
+ *	double maxRadius:		the largest search radius clusters can be extracted for
+ *	int minPts:				the minimum points to form a core points
+ * RETURN:
+ * 	TYPE:	struct opticsOrder *
+ * 	VALUE:	the ordering
+ */
+struct opticsOrder * computeOPTICS(struct pointStore * ps, struct gridIndex * g, double maxRadius, int minPts)
+{
+	struct opticsOrder * oo = allocOPTICS(ps->count);
+	oo->minPts = minPts;
+	oo->maxRadius = maxRadius;
+	oo->precision = ps->precision;
+	oo->resolution = ps->resolution;
+	for(int i = 0; i < ps->count; i++)
+	{
+		originalPoint(ps, i, &oo->x[i], &oo->y[i]);
+	}
+
+	if(ps->precision == PRECISION_FLOAT)
+		orderPoints(ps->xf, ps->yf, g, floatDist2(maxRadius), minPts, oo);
+	else if(ps->precision == PRECISION_INT)
+		orderPoints(ps->xq, ps->yq, g, quantDist2(ps, maxRadius), minPts, oo);
+	else
+		orderPoints(ps->x, ps->y, g, maxRadius * maxRadius, minPts, oo);
+	return oo;
+}
+
+/**
+ * NAME:	extractDBSCAN
+ * DESCRIPTION:	extract the DBSCAN clusters of a radius from an OPTICS ordering in linear time. the core points of a cluster are a run of the ordering that starts with a core point not reachable within the radius, so they are the same as DBSCAN finds; clusters with too few core points are dropped and the others are numbered by their first core point, as doClusterDBSCAN does. a border point goes to the cluster of the core point it is nearest to reach, which is the cluster doClusterDBSCAN gives it unless it is within the radius of more than one cluster
+ * PARAMETERS:
+ * 	struct opticsOrder * oo:	the ordering
+ *	double radius:		the search radius (not above the maximum radius of the ordering)
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ * RETURN:
+ * 	TYPE:	int *
+ * 	VALUE:	an array of length count: the cluster ID of each point
+ */
+int * extractDBSCAN(struct opticsOrder * oo, double radius, int minCore, bool nonCorePoints)
+{
+	int count = oo->count;
+
+	//the squared radius in the precision the ordering was computed in
+	struct pointStore ps;
+	ps.precision = oo->precision;
+	ps.resolution = oo->resolution;
+	double r2;
+	if(oo->precision == PRECISION_FLOAT)
+		r2 = (double)floatDist2(radius);
+	else if(oo->precision == PRECISION_INT)
+		r2 = (double)quantDist2(&ps, radius);
+	else
+		r2 = radius * radius;
+
+	int * runOf;
+	int * runCore;
+	int * clusterID;
+	if(NULL == (runOf = (int *)malloc(sizeof(int) * (count + 1))) || NULL == (runCore = (int *)malloc(sizeof(int) * (count + 2))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (clusterID = (int *)malloc(sizeof(int) * (count + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	//the runs of core points in the ordering
+	int run = 0;
+	int p;
+	runCore[0] = 0;
+	for(int k = 0; k < count; k++)
+	{
+		p = oo->order[k];
+		if(oo->coreDist2[p] > r2)
+		{
+			runOf[p] = 0;
+			continue;
+		}
+		if(oo->reach2[p] > r2 || run == 0)
+		{
+			run ++;
+			runCore[run] = 0;
+		}
+		runOf[p] = run;
+		runCore[run] ++;
+	}
+
+	//runCore holds the cluster ID of a run once its first core point is reached (-1 if dropped)
+	int cID = 0;
+	for(int i = 0; i < count; i++)
+	{
+		clusterID[i] = -1;
+		if(runOf[i] == 0)
+			continue;
+		if(runCore[runOf[i]] > 0)
+			runCore[runOf[i]] = (runCore[runOf[i]] > minCore) ? -(++ cID) : 0;
+		if(runCore[runOf[i]] < 0)
+			clusterID[i] = -runCore[runOf[i]];
+	}
+
+	if(nonCorePoints)
+	{
+		for(int i = 0; i < count; i++)
+		{
+			if(runOf[i] == 0 && oo->borderDist2[i] <= r2)
+				clusterID[i] = clusterID[oo->borderOf[i]];
+		}
+	}
+
+	free(runOf);
+	free(runCore);
+	return clusterID;
+}
+
+/**
+ * NAME:	saveOPTICS
+ * DESCRIPTION:	write an OPTICS ordering to a file, so clusters of other radii can be extracted without computing neighborhoods again
+ * PARAMETERS:
+ * 	const char * file:			the ordering file
+ * 	struct opticsOrder * oo:	the ordering
+ * RETURN: none
+ */
+void saveOPTICS(const char * file, struct opticsOrder * oo)
+{
+	FILE * output;
+
+	if(NULL == (output = fopen(file, "wb")))
+	{
+		printf("ERROR: Can't open the ordering file.\n");
+		exit(1);
+	}
+
+	fwrite(OPTICS_MAGIC, 1, 8, output);
+	fwrite(&oo->count, sizeof(int), 1, output);
+	fwrite(&oo->minPts, sizeof(int), 1, output);
+	fwrite(&oo->maxRadius, sizeof(double), 1, output);
+	fwrite(&oo->precision, sizeof(int), 1, output);
+	fwrite(&oo->resolution, sizeof(double), 1, output);
+	fwrite(oo->x, sizeof(double), oo->count, output);
+	fwrite(oo->y, sizeof(double), oo->count, output);
+	fwrite(oo->coreDist2, sizeof(double), oo->count, output);
+	fwrite(oo->reach2, sizeof(double), oo->count, output);
+	fwrite(oo->borderDist2, sizeof(double), oo->count, output);
+	fwrite(oo->borderOf, sizeof(int), oo->count, output);
+	fwrite(oo->order, sizeof(int), oo->count, output);
+
+	if(fclose(output) != 0)
+	{
+		printf("ERROR: Can't write the ordering file.\n");
+		exit(1);
+	}
+}
+
+/**
+ * NAME:	loadOPTICS
+ * DESCRIPTION:	read an OPTICS ordering from a file
+ * PARAMETERS:
+ * 	const char * file:	the ordering file
+ * RETURN:
+ * 	TYPE:	struct opticsOrder *
+ * 	VALUE:	the ordering
+ */
+struct opticsOrder * loadOPTICS(const char * file)
+{
+	FILE * input;
+	char magic[8];
+	int count;
+
+	if(NULL == (input = fopen(file, "rb")))
+	{
+		printf("ERROR: Can't open the ordering file %s.\n", file);
+		exit(1);
+	}
+	if(fread(magic, 1, 8, input) != 8 || memcmp(magic, OPTICS_MAGIC, 8) != 0 || fread(&count, sizeof(int), 1, input) != 1 || count < 0)
+	{
+		printf("ERROR: %s is not an OPTICS ordering.\n", file);
+		exit(1);
+	}
+
+	struct opticsOrder * oo = allocOPTICS(count);
+	bool ok = fread(&oo->minPts, sizeof(int), 1, input) == 1
+		&& fread(&oo->maxRadius, sizeof(double), 1, input) == 1
+		&& fread(&oo->precision, sizeof(int), 1, input) == 1
+		&& fread(&oo->resolution, sizeof(double), 1, input) == 1
+		&& fread(oo->x, sizeof(double), count, input) == (size_t)count
+		&& fread(oo->y, sizeof(double), count, input) == (size_t)count
+		&& fread(oo->coreDist2, sizeof(double), count, input) == (size_t)count
+		&& fread(oo->reach2, sizeof(double), count, input) == (size_t)count
+		&& fread(oo->borderDist2, sizeof(double), count, input) == (size_t)count
+		&& fread(oo->borderOf, sizeof(int), count, input) == (size_t)count
+		&& fread(oo->order, sizeof(int), count, input) == (size_t)count;
+	if(!ok)
+	{
+		printf("ERROR: Ordering %s is truncated.\n", file);
+		exit(1);
+	}
+
+	fclose(input);
+	return oo;
+}
+
+/**
+ * NAME:	freeOPTICS
+ * DESCRIPTION:	free an OPTICS ordering
+ * PARAMETERS:
+ * 	struct opticsOrder * oo:	the ordering to free
+ * RETURN: none
+ */
+void freeOPTICS(struct opticsOrder * oo)
+{
+	if(oo == NULL)
+		return;
+	free(oo->x);
+	free(oo->y);
+	free(oo->coreDist2);
+	free(oo->reach2);
+	free(oo->borderDist2);
+	free(oo->borderOf);
+	free(oo->order);
+	free(oo);
+}
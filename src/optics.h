@@ -0,0 +1,29 @@
+#ifndef OPTICSH
+#define OPTICSH
+
+struct pointStore;
+struct gridIndex;
+
+//an OPTICS ordering of the points, from which DBSCAN clusters of any radius up to maxRadius are extracted. squared distances are in the units and precision of the point store
+struct opticsOrder {
+	int count;
+	int minPts;
+	double maxRadius;
+	int precision;
+	double resolution;
+	double * x;
+	double * y;
+	double * coreDist2;		//the squared distance of the minPts-th nearest point (HUGE_VAL if beyond maxRadius)
+	double * reach2;		//the squared reachability distance when the point was ordered (HUGE_VAL if none)
+	double * borderDist2;	//the smallest squared reachability distance of the point from any point
+	int * borderOf;			//the point it is reached from at that distance (-1 if none)
+	int * order;			//the points in OPTICS order
+};
+
+struct opticsOrder * computeOPTICS(struct pointStore * ps, struct gridIndex * g, double maxRadius, int minPts);
+int * extractDBSCAN(struct opticsOrder * oo, double radius, int minCore, bool nonCorePoints);
+void saveOPTICS(const char * file, struct opticsOrder * oo);
+struct opticsOrder * loadOPTICS(const char * file);
+void freeOPTICS(struct opticsOrder * oo);
+
+#endif
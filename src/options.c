@@ -0,0 +1,258 @@
+/**
+ * options.c
+ * Date: 10/18/2026
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "io.h"
+#include "points.h"
+#include "rng.h"
+#include "cellDBSCAN.h"
+#include "memory.h"
+#include "options.h"
+
+/**
+ * NAME:	parseOptions
+ * DESCRIPTION:	parse the optional "-name value" pairs following the positional arguments of a program; any option that is not given keeps its default value
+ * PARAMETERS:
+ * 	int argc:				the number of arguments
+ * 	char ** argv:			the arguments
+ * 	int first:				the index of the first optional argument
+ * 	struct options * opts:	the parsed options
+ * RETURN: none
+ */
+void parseOptions(int argc, char ** argv, int first, struct options * opts)
+{
+	opts->precision = PRECISION_DOUBLE;
+	opts->resolution = 0;
+	opts->validate = false;
+	opts->order = ORDER_ROW;
+	opts->subdivide = 1;
+	opts->seed = 0;
+	opts->checkpoint = NULL;
+	opts->checkpointEvery = 64;
+	opts->simFirst = 0;
+	opts->simEnd = -1;
+	opts->shard = NULL;
+	opts->nullCache = NULL;
+	opts->engine = ENGINE_STENCIL;
+	opts->rho = 0.01;
+	opts->optics = NULL;
+	opts->tile = 0;
+	opts->tmpDir = NULL;
+	opts->collapse = false;
+	opts->raster = false;
+	opts->hugePages = false;
+	opts->numa = NUMA_DEFAULT;
+	bool seedGiven = false;
+
+	for(int i = first; i < argc; i += 2)
+	{
+		//the only option with two values
+		if(strcmp(argv[i], "-simRange") == 0)
+		{
+			if(i + 2 >= argc)
+			{
+				printf("ERROR: Missing value for option %s\n", argv[i]);
+				exit(1);
+			}
+			opts->simFirst = atoi(argv[i + 1]);
+			opts->simEnd = atoi(argv[i + 2]);
+			if(opts->simFirst < 0 || opts->simEnd <= opts->simFirst)
+			{
+				printf("ERROR: -simRange needs 0 <= start < end\n");
+				exit(1);
+			}
+			i ++;
+			continue;
+		}
+
+		if(i + 1 >= argc)
+		{
+			printf("ERROR: Missing value for option %s\n", argv[i]);
+			exit(1);
+		}
+
+		if(strcmp(argv[i], "-precision") == 0)
+		{
+			if(-1 == (opts->precision = parsePrecision(argv[i + 1])))
+			{
+				printf("ERROR: Unknown precision %s (double, float or int)\n", argv[i + 1]);
+				exit(1);
+			}
+		}
+		else if(strcmp(argv[i], "-resolution") == 0)
+		{
+			opts->resolution = atof(argv[i + 1]);
+		}
+		else if(strcmp(argv[i], "-validate") == 0)
+		{
+			opts->validate = (atoi(argv[i + 1]) != 0);
+		}
+		else if(strcmp(argv[i], "-order") == 0)
+		{
+			if(-1 == (opts->order = parseOrder(argv[i + 1])))
+			{
+				printf("ERROR: Unknown block order %s (row, morton or hilbert)\n", argv[i + 1]);
+				exit(1);
+			}
+		}
+		else if(strcmp(argv[i], "-subdivide") == 0)
+		{
+			if(-1 == (opts->subdivide = parseSubdivide(argv[i + 1])))
+			{
+				printf("ERROR: -subdivide needs auto or 1 to %d\n", MAX_SUBDIVIDE);
+				exit(1);
+			}
+		}
+		else if(strcmp(argv[i], "-engine") == 0)
+		{
+			if(-1 == (opts->engine = parseEngine(argv[i + 1])))
+			{
+				printf("ERROR: Unknown DBSCAN engine %s (stencil, cell or approx)\n", argv[i + 1]);
+				exit(1);
+			}
+		}
+		else if(strcmp(argv[i], "-rho") == 0)
+		{
+			opts->rho = atof(argv[i + 1]);
+			//the sub-cells of a cell are numbered in 32 bits
+			if(opts->rho < 0.0001 || opts->rho > 1)
+			{
+				printf("ERROR: -rho must be between 0.0001 and 1\n");
+				exit(1);
+			}
+		}
+		else if(strcmp(argv[i], "-optics") == 0)
+		{
+			opts->optics = argv[i + 1];
+		}
+		else if(strcmp(argv[i], "-tile") == 0)
+		{
+			if((opts->tile = atoi(argv[i + 1])) < 1)
+			{
+				printf("ERROR: -tile must be a positive number of search radii\n");
+				exit(1);
+			}
+		}
+		else if(strcmp(argv[i], "-tmpDir") == 0)
+		{
+			opts->tmpDir = argv[i + 1];
+		}
+		else if(strcmp(argv[i], "-collapse") == 0)
+		{
+			opts->collapse = (atoi(argv[i + 1]) != 0);
+		}
+		else if(strcmp(argv[i], "-raster") == 0)
+		{
+			opts->raster = (atoi(argv[i + 1]) != 0);
+		}
+		else if(strcmp(argv[i], "-hugePages") == 0)
+		{
+			opts->hugePages = (atoi(argv[i + 1]) != 0);
+		}
+		else if(strcmp(argv[i], "-numa") == 0)
+		{
+			if(-1 == (opts->numa = parseNumaPolicy(argv[i + 1])))
+			{
+				printf("ERROR: Unknown NUMA placement %s (default, firstTouch or interleave)\n", argv[i + 1]);
+				exit(1);
+			}
+		}
+		else if(strcmp(argv[i], "-seed") == 0)
+		{
+			opts->seed = strtoull(argv[i + 1], NULL, 10);
+			seedGiven = true;
+		}
+		else if(strcmp(argv[i], "-checkpoint") == 0)
+		{
+			opts->checkpoint = argv[i + 1];
+		}
+		else if(strcmp(argv[i], "-shard") == 0)
+		{
+			opts->shard = argv[i + 1];
+		}
+		else if(strcmp(argv[i], "-nullCache") == 0)
+		{
+			opts->nullCache = argv[i + 1];
+		}
+		else if(strcmp(argv[i], "-checkpointEvery") == 0)
+		{
+			if((opts->checkpointEvery = atoi(argv[i + 1])) < 1)
+			{
+				printf("ERROR: -checkpointEvery must be positive\n");
+				exit(1);
+			}
+		}
+		else
+		{
+			printf("ERROR: Unknown option %s\n", argv[i]);
+			printOptionsUsage();
+			exit(1);
+		}
+	}
+
+	if(opts->precision == PRECISION_INT && opts->resolution <= 0)
+	{
+		printf("ERROR: -precision int requires a positive -resolution\n");
+		exit(1);
+	}
+
+	if(opts->simEnd >= 0 && opts->shard == NULL)
+	{
+		printf("ERROR: -simRange requires a -shard file for the result\n");
+		exit(1);
+	}
+
+	if(opts->shard != NULL && !seedGiven)
+	{
+		printf("ERROR: -shard requires a -seed shared by all shards\n");
+		exit(1);
+	}
+
+	//the cache holds the replications from the first one on, and is saved as often as a checkpoint
+	if(opts->nullCache != NULL && (opts->simEnd >= 0 || opts->checkpoint != NULL))
+	{
+		printf("ERROR: -nullCache can't be combined with -simRange or -checkpoint\n");
+		exit(1);
+	}
+
+	if(!seedGiven)
+	{
+		opts->seed = randomSeed();
+	}
+}
+
+/**
+ * NAME:	printOptionsUsage
+ * DESCRIPTION:	print the optional arguments shared by all programs
+ * PARAMETERS: none
+ * RETURN: none
+ */
+void printOptionsUsage()
+{
+	printf("Options:\n");
+	printf("\t-precision double|float|int\tcoordinate precision used to count neighbors (default: double)\n");
+	printf("\t-resolution r\tquantization step of -precision int, in the units of the input coordinates\n");
+	printf("\t-validate 0|1\treport point pairs whose neighbor test differs from double precision\n");
+	printf("\t-order row|morton|hilbert\tstorage order of index blocks and of the points in them (default: row)\n");
+	printf("\t-subdivide k|auto\tindex blocks per searchRadius; the search stencil is the blocks that meet the search circle, and blocks inside it are counted without distance tests. auto picks k from the point density (default: 1)\n");
+	printf("\t-engine stencil|cell|approx\tDBSCAN engine, cell skips the distance tests within dense cells, approx is rho-approximate (default: stencil, DBSCAN only)\n");
+	printf("\t-rho r\tapproximation of -engine approx: points farther than (1 + r) * searchRadius are never neighbors (default: 0.01)\n");
+	printf("\t-optics file\tsave an OPTICS ordering up to searchRadius, to extract clusters of smaller radii with OPTICS_Extract (DBSCAN only)\n");
+	printf("\t-tile t\tprocess the points in tiles of t * t searchRadius with a halo of one searchRadius, read one at a time from a temporary file, so memory is bounded by the tile size instead of the data; needs nSim 0 (default: all points in memory, ESCIB_Poisson only)\n");
+	printf("\t-tmpDir dir\tdirectory of the temporary tile and coordinate files, which should be on disk (default: $TMPDIR, or /tmp)\n");
+	printf("\t-collapse 0|1\tmerge the points at exactly the same location into one weighted point (ESCIB_Bernoulli and ESCIB_Poisson only)\n");
+	printf("\t-raster 0|1\tread the background as an ESRI ASCII grid of background counts instead of points (ESCIB_Poisson only)\n");
+	printf("\t-hugePages 0|1\talign the large arrays to 2 MB and back them with transparent huge pages (default: 0)\n");
+	printf("\t-numa default|firstTouch|interleave\tNUMA placement of the large arrays: where they are first written, touched in shares by the OpenMP threads, or spread over all nodes (default: default)\n");
+	printf("\t-seed n\tseed of the Monte Carlo simulation (default: random)\n");
+	printf("\t-checkpoint file\tsave the Monte Carlo progress to a file, and resume (or extend) from it if it exists\n");
+	printf("\t-checkpointEvery n\treplications between checkpoints (default: 64)\n");
+	printf("\t-simRange start end\tonly simulate replications start to end - 1 (default: all)\n");
+	printf("\t-shard file\twrite the simulated replications to a shard file, to be merged by ESCIB_Merge\n");
+	printf("\t-nullCache file\ttake the replications from a cache of the null distribution, and add the new ones to it; a cache of other points or parameters is replaced\n");
+}
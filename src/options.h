@@ -0,0 +1,31 @@
+#ifndef OPH
+#define OPH
+
+struct options {
+	int precision;
+	double resolution;
+	bool validate;
+	int order;
+	int subdivide;
+	unsigned long long seed;
+	const char * checkpoint;
+	int checkpointEvery;
+	int simFirst;
+	int simEnd;
+	const char * shard;
+	const char * nullCache;
+	int engine;
+	double rho;
+	const char * optics;
+	int tile;
+	const char * tmpDir;
+	bool collapse;
+	bool raster;
+	bool hugePages;
+	int numa;
+};
+
+void parseOptions(int argc, char ** argv, int first, struct options * opts);
+void printOptionsUsage();
+
+#endif
@@ -0,0 +1,476 @@
+/**
+ * points.c
+ * Date: 10/18/2026
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <sys/types.h>
+#include "io.h"
+#include "points.h"
+#include "memory.h"
+
+/**
+ * NAME:	buildPointStore
+ * DESCRIPTION:	move the (already indexed) points into a point store. coordinates are kept in the requested precision only: float coordinates and quantized coordinates are both stored as offsets from (xMin, yMin) so that no precision is wasted on the absolute position of the study area. type indicators are packed into one bit per point
+ * PARAMETERS:
+ * 	double * x:			points' X values, owned by the store from now on (freed if not kept)
+ * 	double * y:			points' Y values, owned by the store from now on (freed if not kept)
+ * 	int * ind:			points' type indicator (1 or 0), freed after packing; NULL if the points have no types
+ * 	int count:			the total number of points
+ * 	int precision:		PRECISION_DOUBLE, PRECISION_FLOAT or PRECISION_INT
+ * 	double xMin:		the minimum X of all points
+ * 	double yMin:		the minimum Y of all points
+ * 	double xMax:		the maximum X of all points, used to check the quantized range
+ * 	double yMax:		the maximum Y of all points, used to check the quantized range
+ * 	double resolution:	the side length of one quantization step (only used by PRECISION_INT)
+ * 	bool keepDouble:	whether to keep the double coordinates along with a reduced precision copy, for validatePrecision or for the output (see spillCoordinates)
+ * RETURN:
+ * 	TYPE:	struct pointStore *
+ * 	VALUE:	the store of all points
+ */
+struct pointStore * buildPointStore(double * x, double * y, int * ind, int count, int precision, double xMin, double yMin, double xMax, double yMax, double resolution, bool keepDouble)
+{
+	struct pointStore * ps;
+
+	if(NULL == (ps = (struct pointStore *)malloc(sizeof(struct pointStore))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	ps->count = count;
+	ps->precision = precision;
+	ps->x = x;
+	ps->y = y;
+	ps->xf = NULL;
+	ps->yf = NULL;
+	ps->xq = NULL;
+	ps->yq = NULL;
+	ps->xMin = xMin;
+	ps->yMin = yMin;
+	ps->resolution = resolution;
+	ps->label = NULL;
+	ps->weight = NULL;
+	ps->original = NULL;
+	ps->nextOriginal = 0;
+
+	if(precision == PRECISION_FLOAT)
+	{
+		if(NULL == (ps->xf = (float *)allocArray(sizeof(float) * count)))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		if(NULL == (ps->yf = (float *)allocArray(sizeof(float) * count)))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		for(int i = 0; i < count; i++)
+		{
+			ps->xf[i] = (float)(x[i] - xMin);
+			ps->yf[i] = (float)(y[i] - yMin);
+		}
+	}
+	else if(precision == PRECISION_INT)
+	{
+		if(resolution <= 0)
+		{
+			printf("ERROR: A positive resolution is required for quantized coordinates.\n");
+			exit(1);
+		}
+		if((xMax - xMin) / resolution >= INT_MAX || (yMax - yMin) / resolution >= INT_MAX)
+		{
+			printf("ERROR: Resolution %lf is too fine to quantize the study area into 32-bit integers.\n", resolution);
+			exit(1);
+		}
+		if(NULL == (ps->xq = (int *)allocArray(sizeof(int) * count)))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		if(NULL == (ps->yq = (int *)allocArray(sizeof(int) * count)))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		for(int i = 0; i < count; i++)
+		{
+			ps->xq[i] = (int)llround((x[i] - xMin) / resolution);
+			ps->yq[i] = (int)llround((y[i] - yMin) / resolution);
+		}
+	}
+
+	if(precision != PRECISION_DOUBLE && !keepDouble)
+	{
+		free(x);
+		free(y);
+		ps->x = NULL;
+		ps->y = NULL;
+	}
+
+	if(ind != NULL)
+	{
+		ps->label = allocLabels(count);
+		for(int i = 0; i < count; i++)
+		{
+			if(ind[i] == 1)
+				SET_LABEL(ps->label, i);
+		}
+		free(ind);
+	}
+
+	return ps;
+}
+
+/**
+ * NAME:	freePointStore
+ * DESCRIPTION:	free a point store and all its arrays
+ * PARAMETERS:
+ * 	struct pointStore * ps: the store to free
+ * RETURN: none
+ */
+void freePointStore(struct pointStore * ps)
+{
+	if(ps == NULL)
+		return;
+	free(ps->x);
+	free(ps->y);
+	free(ps->xf);
+	free(ps->yf);
+	free(ps->xq);
+	free(ps->yq);
+	free(ps->label);
+	free(ps->weight);
+	if(ps->original != NULL)
+		fclose(ps->original);
+	free(ps);
+}
+
+/**
+ * NAME:	pointX
+ * DESCRIPTION:	get the X value of a point, reconstructed from the stored precision if the double coordinates are not kept
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points
+ * 	int i:					the array index of the point
+ * RETURN:
+ * 	TYPE:	double
+ * 	VALUE:	the X value of the point
+ */
+double pointX(struct pointStore * ps, int i)
+{
+	if(ps->x != NULL)
+		return ps->x[i];
+	if(ps->precision == PRECISION_FLOAT)
+		return ps->xMin + ps->xf[i];
+	return ps->xMin + ps->xq[i] * ps->resolution;
+}
+
+/**
+ * NAME:	pointY
+ * DESCRIPTION:	get the Y value of a point, reconstructed from the stored precision if the double coordinates are not kept
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points
+ * 	int i:					the array index of the point
+ * RETURN:
+ * 	TYPE:	double
+ * 	VALUE:	the Y value of the point
+ */
+double pointY(struct pointStore * ps, int i)
+{
+	if(ps->y != NULL)
+		return ps->y[i];
+	if(ps->precision == PRECISION_FLOAT)
+		return ps->yMin + ps->yf[i];
+	return ps->yMin + ps->yq[i] * ps->resolution;
+}
+
+/**
+ * NAME:	spillCoordinates
+ * DESCRIPTION:	move the double coordinates kept along with a reduced precision copy to a temporary file, from which originalPoint reads them back for the output. the reduced copy is only for counting and expanding, so the output keeps the input coordinates without holding them in memory
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points, built with keepDouble
+ * 	const char * tmpDir:	the directory of the temporary file (NULL: $TMPDIR, or /tmp)
+ * RETURN: none
+ */
+void spillCoordinates(struct pointStore * ps, const char * tmpDir)
+{
+	double xy[2];
+	if(ps->precision == PRECISION_DOUBLE || ps->x == NULL)
+		return;
+	if(NULL == (ps->original = openTempFile(tmpDir)))
+	{
+		printf("ERROR: Can't create the coordinate file in %s.\n", tmpDir != NULL ? tmpDir : "$TMPDIR or /tmp");
+		exit(1);
+	}
+	for(int i = 0; i < ps->count; i++)
+	{
+		xy[0] = ps->x[i];
+		xy[1] = ps->y[i];
+		if(1 != fwrite(xy, sizeof(xy), 1, ps->original))
+		{
+			printf("ERROR: Can't write the coordinate file.\n");
+			exit(1);
+		}
+	}
+	fflush(ps->original);
+	ps->nextOriginal = ps->count;
+	free(ps->x);
+	free(ps->y);
+	ps->x = NULL;
+	ps->y = NULL;
+}
+
+/**
+ * NAME:	originalPoint
+ * DESCRIPTION:	get the input coordinates of a point for the output: the kept double coordinates, those spilled by spillCoordinates (read in order, so a pass over all points reads the file once), or else the ones reconstructed from the stored precision
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points
+ * 	int i:					the array index of the point
+ * 	double * x, double * y:	the output coordinates
+ * RETURN: none
+ */
+void originalPoint(struct pointStore * ps, int i, double * x, double * y)
+{
+	double xy[2];
+	if(ps->original == NULL)
+	{
+		*x = pointX(ps, i);
+		*y = pointY(ps, i);
+		return;
+	}
+	if(i != ps->nextOriginal && 0 != fseeko(ps->original, (off_t)i * sizeof(xy), SEEK_SET))
+	{
+		printf("ERROR: Can't read the coordinate file.\n");
+		exit(1);
+	}
+	if(1 != fread(xy, sizeof(xy), 1, ps->original))
+	{
+		printf("ERROR: Can't read the coordinate file.\n");
+		exit(1);
+	}
+	ps->nextOriginal = i + 1;
+	*x = xy[0];
+	*y = xy[1];
+}
+
+template <typename T>
+static void boundRangesT(int nRanges, int * start, int * end, T * x, T * y, double * bxMin, double * byMin, double * bxMax, double * byMax)
+{
+	T xMin, yMin, xMax, yMax;
+
+	for(int b = 0; b < nRanges; b++)
+	{
+		if(start[b] == end[b])
+		{
+			bxMin[b] = byMin[b] = bxMax[b] = byMax[b] = 0;
+			continue;
+		}
+		xMin = xMax = x[start[b]];
+		yMin = yMax = y[start[b]];
+		for(int i = start[b] + 1; i < end[b]; i++)
+		{
+			if(x[i] < xMin)
+				xMin = x[i];
+			if(x[i] > xMax)
+				xMax = x[i];
+			if(y[i] < yMin)
+				yMin = y[i];
+			if(y[i] > yMax)
+				yMax = y[i];
+		}
+		//float and int coordinates are exactly representable, so the bounds convert back to T unchanged
+		bxMin[b] = (double)xMin;
+		byMin[b] = (double)yMin;
+		bxMax[b] = (double)xMax;
+		byMax[b] = (double)yMax;
+	}
+}
+
+template <typename T>
+static void boundBlocksT(struct gridIndex * g, T * x, T * y)
+{
+	boundRangesT(g->nBlockX * g->nBlockY, g->start, g->end, x, y, g->bxMin, g->byMin, g->bxMax, g->byMax);
+	boundRangesT(g->nQuad, g->quadStart, g->quadEnd, x, y, g->qxMin, g->qyMin, g->qxMax, g->qyMax);
+}
+
+/**
+ * NAME:	boundBlocks
+ * DESCRIPTION:	store the tight bounding box of the points in each block and each quadtree node of an index, in the precision and units of the point store, so that whole blocks can be accepted or rejected by blockToPoint and blockToBlock
+ * PARAMETERS:
+ * 	struct gridIndex * g:	the index of the points
+ * 	struct pointStore * ps:	the store of the same (indexed) points
+ * RETURN: none
+ */
+void boundBlocks(struct gridIndex * g, struct pointStore * ps)
+{
+	int nBlocks = g->nBlockX * g->nBlockY;
+	double ** bounds[8] = {&g->bxMin, &g->byMin, &g->bxMax, &g->byMax, &g->qxMin, &g->qyMin, &g->qxMax, &g->qyMax};
+
+	for(int k = 0; k < 8; k++)
+	{
+		if(*bounds[k] == NULL && NULL == (*bounds[k] = (double *)malloc(sizeof(double) * ((k < 4) ? nBlocks : (g->nQuad + 1)))))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+	}
+
+	if(ps->precision == PRECISION_FLOAT)
+		boundBlocksT(g, ps->xf, ps->yf);
+	else if(ps->precision == PRECISION_INT)
+		boundBlocksT(g, ps->xq, ps->yq);
+	else
+		boundBlocksT(g, ps->x, ps->y);
+}
+
+/**
+ * NAME:	pointStoreBytes
+ * DESCRIPTION:	get the memory used by a point store
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the store of all points
+ * RETURN:
+ * 	TYPE:	double
+ * 	VALUE:	the average number of bytes stored per point
+ */
+double pointStoreBytes(struct pointStore * ps)
+{
+	double bytes = 0;
+	if(ps->x != NULL)
+		bytes += 2 * sizeof(double);
+	if(ps->xf != NULL)
+		bytes += 2 * sizeof(float);
+	if(ps->xq != NULL)
+		bytes += 2 * sizeof(int);
+	if(ps->label != NULL)
+		bytes += 1.0 / 8;
+	if(ps->weight != NULL)
+		bytes += sizeof(int);
+	return bytes;
+}
+
+/**
+ * NAME:	allocLabels
+ * DESCRIPTION:	allocate bit-packed type labels for a number of points, all labels are initialized to 0
+ * PARAMETERS:
+ * 	int count: the number of points
+ * RETURN:
+ * 	TYPE:	unsigned long long *
+ * 	VALUE:	the labels, read and written with GET_LABEL, SET_LABEL and CLEAR_LABEL
+ */
+unsigned long long * allocLabels(int count)
+{
+	unsigned long long * label;
+	if(NULL == (label = (unsigned long long *)allocZeroArray(sizeof(unsigned long long) * LABEL_WORDS(count))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	return label;
+}
+
+/**
+ * NAME:	allocNeighborCounts
+ * DESCRIPTION:	allocate the counters of points within a distance of each point, using 2-byte counters if no count can exceed 65535 and 4-byte counters otherwise
+ * PARAMETERS:
+ * 	int count:		the number of points
+ * 	int maxCount:	an upper bound of any count, e.g. the largest number of points in the search stencil of a block
+ * 	bool twoTypes:	whether to count the two types of points separately (c0 and c1) or all points together (c0 only)
+ * RETURN:
+ * 	TYPE:	struct neighborCounts *
+ * 	VALUE:	the (uninitialized) counters, read with COUNT_AT
+ */
+struct neighborCounts * allocNeighborCounts(int count, int maxCount, bool twoTypes)
+{
+	struct neighborCounts * nc;
+	if(NULL == (nc = (struct neighborCounts *)malloc(sizeof(struct neighborCounts))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	nc->count = count;
+	nc->width = (maxCount <= 65535) ? 2 : 4;
+	nc->c1 = NULL;
+	if(NULL == (nc->c0 = allocArray((size_t)nc->width * count)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(twoTypes && NULL == (nc->c1 = allocArray((size_t)nc->width * count)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	return nc;
+}
+
+/**
+ * NAME:	freeNeighborCounts
+ * DESCRIPTION:	free the counters of points within a distance
+ * PARAMETERS:
+ * 	struct neighborCounts * nc: the counters to free
+ * RETURN: none
+ */
+void freeNeighborCounts(struct neighborCounts * nc)
+{
+	if(nc == NULL)
+		return;
+	free(nc->c0);
+	free(nc->c1);
+	free(nc);
+}
+
+/**
+ * NAME:	floatDist2
+ * DESCRIPTION:	get the squared distance threshold used by single-precision neighbor tests
+ * PARAMETERS:
+ * 	double distance: the distance
+ * RETURN:
+ * 	TYPE:	float
+ * 	VALUE:	the squared distance in single precision
+ */
+float floatDist2(double distance)
+{
+	return (float)(distance * distance);
+}
+
+/**
+ * NAME:	quantDist2
+ * DESCRIPTION:	get the squared distance threshold, in quantization steps, used by exact integer neighbor tests. since the squared distance of two quantized points is an integer, comparing it with the floor of (distance / resolution)^2 is exact
+ * PARAMETERS:
+ * 	struct pointStore * ps:	the (quantized) store of points
+ * 	double distance:		the distance
+ * RETURN:
+ * 	TYPE:	long long
+ * 	VALUE:	the squared distance in quantization steps
+ */
+long long quantDist2(struct pointStore * ps, double distance)
+{
+	long double d = (long double)distance / ps->resolution;
+	return (long long)floorl(d * d);
+}
+
+/**
+ * NAME:	parsePrecision
+ * DESCRIPTION:	convert the name of a coordinate precision to its code
+ * PARAMETERS:
+ * 	const char * name: "double", "float" or "int"
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	PRECISION_DOUBLE, PRECISION_FLOAT, PRECISION_INT, or -1 if the name is unknown
+ */
+int parsePrecision(const char * name)
+{
+	if(strcmp(name, "double") == 0)
+		return PRECISION_DOUBLE;
+	if(strcmp(name, "float") == 0)
+		return PRECISION_FLOAT;
+	if(strcmp(name, "int") == 0)
+		return PRECISION_INT;
+	return -1;
+}
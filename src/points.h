@@ -0,0 +1,85 @@
+#ifndef PSH
+#define PSH
+
+#include <stdio.h>
+
+#define PRECISION_DOUBLE 0
+#define PRECISION_FLOAT 1
+#define PRECISION_INT 2
+
+//type labels are bit-packed, 64 points per word
+#define LABEL_WORDS(count) (((count) + 63) >> 6)
+#define GET_LABEL(label, i) ((int)(((label)[(i) >> 6] >> ((i) & 63)) & 1ULL))
+#define SET_LABEL(label, i) ((label)[(i) >> 6] |= (1ULL << ((i) & 63)))
+#define CLEAR_LABEL(label, i) ((label)[(i) >> 6] &= ~(1ULL << ((i) & 63)))
+
+//counters are 2 or 4 bytes wide, see allocNeighborCounts
+#define COUNT_AT(nc, c, i) ((nc)->width == 2 ? (int)(((unsigned short *)(c))[i]) : ((int *)(c))[i])
+
+struct gridIndex;
+
+struct pointStore {
+	int count;
+	int precision;
+	double * x;
+	double * y;
+	float * xf;
+	float * yf;
+	int * xq;
+	int * yq;
+	double xMin;
+	double yMin;
+	double resolution;
+	unsigned long long * label;
+	int * weight;		//the number of points at each stored location, owned by the store (NULL: every location holds one point)
+	FILE * original;	//the input coordinates of the points in store order, moved out of memory by spillCoordinates (NULL: not spilled)
+	int nextOriginal;	//the point the file is positioned at
+};
+
+struct neighborCounts {
+	int count;
+	int width;
+	void * c0;
+	void * c1;
+};
+
+/**
+ * NAME:	inDistance
+ * DESCRIPTION:	test whether two points are within a distance. the coordinates are widened to D before subtracting, so int coordinates are tested exactly in 64 bits and float coordinates entirely in single precision
+ */
+template <typename T, typename D>
+static inline bool inDistance(T x1, T y1, T x2, T y2, D dist2)
+{
+	D dx = (D)x2 - (D)x1;
+	D dy = (D)y2 - (D)y1;
+	return dist2 >= dx * dx + dy * dy;
+}
+
+/**
+ * NAME:	squaredDistance
+ * DESCRIPTION:	the squared distance of two points, computed as inDistance does, so comparing it with a squared radius gives the same result
+ */
+template <typename T, typename D>
+static inline D squaredDistance(T x1, T y1, T x2, T y2)
+{
+	D dx = (D)x2 - (D)x1;
+	D dy = (D)y2 - (D)y1;
+	return dx * dx + dy * dy;
+}
+
+struct pointStore * buildPointStore(double * x, double * y, int * ind, int count, int precision, double xMin, double yMin, double xMax, double yMax, double resolution, bool keepDouble);
+void freePointStore(struct pointStore * ps);
+void boundBlocks(struct gridIndex * g, struct pointStore * ps);
+double pointX(struct pointStore * ps, int i);
+double pointY(struct pointStore * ps, int i);
+void spillCoordinates(struct pointStore * ps, const char * tmpDir);
+void originalPoint(struct pointStore * ps, int i, double * x, double * y);
+double pointStoreBytes(struct pointStore * ps);
+unsigned long long * allocLabels(int count);
+struct neighborCounts * allocNeighborCounts(int count, int maxCount, bool twoTypes);
+void freeNeighborCounts(struct neighborCounts * nc);
+float floatDist2(double distance);
+long long quantDist2(struct pointStore * ps, double distance);
+int parsePrecision(const char * name);
+
+#endif
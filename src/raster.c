@@ -0,0 +1,372 @@
+/**
+ * raster.c
+ * Date: 10/18/2026
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include "points.h"
+#include "rng.h"
+#include "raster.h"
+
+/**
+ * NAME:	readRaster
+ * DESCRIPTION:	read a background raster from an ESRI ASCII grid: a header of ncols, nrows, xllcorner (or xllcenter), yllcorner (or yllcenter), cellsize and an optional NODATA_value, then the cells row by row from the top. a cell is the number of background points in it, NODATA cells are empty
+ * PARAMETERS:
+ * 	FILE * file:	the input file
+ * RETURN:
+ * 	TYPE:	struct rasterGrid *
+ * 	VALUE:	the raster
+ */
+struct rasterGrid * readRaster(FILE * file)
+{
+	char key[64];
+	double value;
+	int nCols = -1;
+	int nRows = -1;
+	double xLL = 0;
+	double yLL = 0;
+	bool center = false;
+	double cellSize = -1;
+	double noData = 0;
+	bool hasNoData = false;
+	bool hasValue = false;
+
+	rewind(file);
+	while(fscanf(file, "%63s", key) == 1)
+	{
+		//the header ends at the first number
+		if(!isalpha((unsigned char)key[0]))
+		{
+			value = atof(key);
+			hasValue = true;
+			break;
+		}
+		if(fscanf(file, "%lf", &value) != 1)
+		{
+			printf("ERROR: Missing value of %s in the raster header\n", key);
+			exit(1);
+		}
+		if(strcasecmp(key, "ncols") == 0)
+			nCols = (int)value;
+		else if(strcasecmp(key, "nrows") == 0)
+			nRows = (int)value;
+		else if(strcasecmp(key, "xllcorner") == 0 || strcasecmp(key, "xllcenter") == 0)
+		{
+			xLL = value;
+			center = (strcasecmp(key, "xllcenter") == 0);
+		}
+		else if(strcasecmp(key, "yllcorner") == 0 || strcasecmp(key, "yllcenter") == 0)
+			yLL = value;
+		else if(strcasecmp(key, "cellsize") == 0)
+			cellSize = value;
+		else if(strcasecmp(key, "nodata_value") == 0)
+		{
+			noData = value;
+			hasNoData = true;
+		}
+		else
+		{
+			printf("ERROR: Unknown raster header %s\n", key);
+			exit(1);
+		}
+	}
+	if(nCols <= 0 || nRows <= 0 || cellSize <= 0)
+	{
+		printf("ERROR: The raster header needs positive ncols, nrows and cellsize\n");
+		exit(1);
+	}
+
+	struct rasterGrid * ra;
+	if(NULL == (ra = (struct rasterGrid *)malloc(sizeof(struct rasterGrid))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	ra->nCols = nCols;
+	ra->nRows = nRows;
+	ra->cellSize = cellSize;
+	ra->xMin = center ? xLL - cellSize / 2 : xLL;
+	ra->yMin = center ? yLL - cellSize / 2 : yLL;
+	ra->stamp = NULL;
+	ra->nStamp = 0;
+	if(NULL == (ra->sat = (double *)malloc(sizeof(double) * (nCols + 1) * (nRows + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	//the rows of the file run from the top down, so each row is first kept as the sum of its own cells, and the rows below are added once they are all read
+	double * row;
+	for(int i = 0; i <= nCols; i++)
+		ra->sat[i] = 0;
+	for(int j = nRows - 1; j >= 0; j--)
+	{
+		row = ra->sat + (long long)(j + 1) * (nCols + 1);
+		row[0] = 0;
+		for(int i = 0; i < nCols; i++)
+		{
+			if(!hasValue && fscanf(file, "%lf", &value) != 1)
+			{
+				printf("ERROR: The raster has fewer than %d * %d cells\n", nCols, nRows);
+				exit(1);
+			}
+			hasValue = false;
+			if(hasNoData && value == noData)
+				value = 0;
+			if(value < 0)
+			{
+				printf("ERROR: Negative background %lf in the raster\n", value);
+				exit(1);
+			}
+			row[i + 1] = row[i] + value;
+		}
+	}
+	for(int j = 1; j <= nRows; j++)
+	{
+		for(int i = 0; i <= nCols; i++)
+			ra->sat[(long long)j * (nCols + 1) + i] += ra->sat[(long long)(j - 1) * (nCols + 1) + i];
+	}
+
+	ra->total = ra->sat[(long long)nRows * (nCols + 1) + nCols];
+	if(ra->total <= 0)
+	{
+		printf("ERROR: The raster has no background\n");
+		exit(1);
+	}
+
+	return ra;
+}
+
+/**
+ * NAME:	rectMass
+ * DESCRIPTION:	the sum of the cells of rows j0 to j1 and columns i0 to i1, from the summed-area table
+ */
+static inline double rectMass(struct rasterGrid * ra, int j0, int j1, int i0, int i1)
+{
+	double * lo = ra->sat + (long long)j0 * (ra->nCols + 1);
+	double * hi = ra->sat + (long long)(j1 + 1) * (ra->nCols + 1);
+	return hi[i1 + 1] - hi[i0] - lo[i1 + 1] + lo[i0];
+}
+
+/**
+ * NAME:	centerSpan
+ * DESCRIPTION:	find the cells of a row whose centers are within a distance of a location. they are one run of columns, taken from the chord of the disk at the centers of the row and then moved to agree with the distance test of each cell, so that rasterDiskMass and rasterClusterMass count the same cells
+ * PARAMETERS:
+ * 	struct rasterGrid * ra:	the raster
+ * 	double x:			the X value of the location
+ * 	double dy:			the Y value of the centers of the row less that of the location
+ * 	double r2:			the distance squared
+ * 	int * i0:			the output first column
+ * 	int * i1:			the output last column, less than i0 if no center is within the distance
+ * RETURN: none
+ */
+static inline void centerSpan(struct rasterGrid * ra, double x, double dy, double r2, int * i0, int * i1)
+{
+	double cs = ra->cellSize;
+	double half = sqrt(r2 - dy * dy);
+	double dx;
+	int a = (int)ceil((x - half - ra->xMin) / cs - 0.5);
+	int b = (int)floor((x + half - ra->xMin) / cs - 0.5);
+
+	//the rounding of the chord may be off by one cell at either end
+	dx = ra->xMin + (a - 0.5) * cs - x;
+	if(dx * dx + dy * dy <= r2)
+		a --;
+	dx = ra->xMin + (a + 0.5) * cs - x;
+	if(dx * dx + dy * dy > r2)
+		a ++;
+	dx = ra->xMin + (b + 1.5) * cs - x;
+	if(dx * dx + dy * dy <= r2)
+		b ++;
+	dx = ra->xMin + (b + 0.5) * cs - x;
+	if(dx * dx + dy * dy > r2)
+		b --;
+
+	*i0 = (a < 0) ? 0 : a;
+	*i1 = (b > ra->nCols - 1) ? ra->nCols - 1 : b;
+}
+
+/**
+ * NAME:	rasterDiskMass
+ * DESCRIPTION:	get the number of background points within a distance of a location: the cells whose centers are within the distance, as in rasterClusterMass. the cells make one run of columns in each row, and the rows with the same run make one rectangle summed from the summed-area table, so the cost is the number of different runs, a few per row only at the top and bottom of the disk
+ * PARAMETERS:
+ * 	struct rasterGrid * ra:	the raster
+ * 	double x:			the X value of the location
+ * 	double y:			the Y value of the location
+ * 	double radius:		the distance
+ * RETURN:
+ * 	TYPE:	double
+ * 	VALUE:	the number of background points
+ */
+double rasterDiskMass(struct rasterGrid * ra, double x, double y, double radius)
+{
+	double cs = ra->cellSize;
+	double r2 = radius * radius;
+	double mass = 0;
+	double dy;
+	int i0, i1;
+	int start = -1;
+	int s0 = 0;
+	int s1 = -1;
+
+	int j0 = (int)ceil((y - radius - ra->yMin) / cs - 0.5);
+	int j1 = (int)floor((y + radius - ra->yMin) / cs - 0.5);
+	if(j0 < 0)
+		j0 = 0;
+	if(j1 > ra->nRows - 1)
+		j1 = ra->nRows - 1;
+
+	//the rows from start to j - 1 all have the run s0 to s1
+	for(int j = j0; j <= j1 + 1; j++)
+	{
+		i0 = 0;
+		i1 = -1;
+		if(j <= j1)
+		{
+			dy = ra->yMin + (j + 0.5) * cs - y;
+			if(dy * dy <= r2)
+				centerSpan(ra, x, dy, r2, &i0, &i1);
+		}
+		if(start >= 0 && i0 == s0 && i1 == s1)
+			continue;
+		if(start >= 0 && s0 <= s1)
+			mass += rectMass(ra, start, j - 1, s0, s1);
+		start = j;
+		s0 = i0;
+		s1 = i1;
+	}
+	return mass;
+}
+
+/**
+ * NAME:	rasterClusterMass
+ * DESCRIPTION:	get the number of background points of a cluster: the cells whose centers are within a distance of any of its core points, each cell counted once
+ * PARAMETERS:
+ * 	struct rasterGrid * ra:	the raster
+ * 	struct pointStore * ps:	the store of the points
+ * 	int * points:		the array indexes of the core points of the cluster
+ * 	int n:				the number of core points
+ * 	double radius:		the distance
+ * RETURN:
+ * 	TYPE:	double
+ * 	VALUE:	the number of background points
+ */
+double rasterClusterMass(struct rasterGrid * ra, struct pointStore * ps, int * points, int n, double radius)
+{
+	double cs = ra->cellSize;
+	double r2 = radius * radius;
+	double mass = 0;
+	double x, y, dy;
+	int j0, j1, i0, i1;
+	int * stamp;
+
+	//the stamps are only cleared when they wrap around
+	if(ra->stamp == NULL || ra->nStamp == 0x7fffffff)
+	{
+		free(ra->stamp);
+		if(NULL == (ra->stamp = (int *)calloc((long long)ra->nCols * ra->nRows, sizeof(int))))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		ra->nStamp = 0;
+	}
+	ra->nStamp ++;
+
+	for(int k = 0; k < n; k++)
+	{
+		x = pointX(ps, points[k]);
+		y = pointY(ps, points[k]);
+		j0 = (int)ceil((y - radius - ra->yMin) / cs - 0.5);
+		j1 = (int)floor((y + radius - ra->yMin) / cs - 0.5);
+		if(j0 < 0)
+			j0 = 0;
+		if(j1 > ra->nRows - 1)
+			j1 = ra->nRows - 1;
+		for(int j = j0; j <= j1; j++)
+		{
+			dy = ra->yMin + (j + 0.5) * cs - y;
+			if(dy * dy > r2)
+				continue;
+			centerSpan(ra, x, dy, r2, &i0, &i1);
+			stamp = ra->stamp + (long long)j * ra->nCols;
+			for(int i = i0; i <= i1; i++)
+			{
+				if(stamp[i] == ra->nStamp)
+					continue;
+				stamp[i] = ra->nStamp;
+				mass += rectMass(ra, j, j, i, i);
+			}
+		}
+	}
+	return mass;
+}
+
+/**
+ * NAME:	sampleRaster
+ * DESCRIPTION:	draw a location from the background: a cell with a probability in proportion to its number of background points, then a uniform location within the cell
+ * PARAMETERS:
+ * 	struct rasterGrid * ra:	the raster
+ * 	struct rngStream * s:	the random stream
+ * 	double * x:			the output X value
+ * 	double * y:			the output Y value
+ * RETURN: none
+ */
+void sampleRaster(struct rasterGrid * ra, struct rngStream * s, double * x, double * y)
+{
+	double t = rngUniform(s) * ra->total;
+	int lo, hi, mid;
+
+	//the last row starting at or before t, and the last cell of it. the rows below row j sum to sat[j * (nCols + 1) + nCols]
+	int n1 = ra->nCols + 1;
+	lo = 0;
+	hi = ra->nRows - 1;
+	while(lo < hi)
+	{
+		mid = (lo + hi + 1) / 2;
+		if(ra->sat[(long long)mid * n1 + ra->nCols] <= t)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	int j = lo;
+	double * below = ra->sat + (long long)j * n1;
+	double * row = below + n1;
+	t -= below[ra->nCols];
+
+	lo = 0;
+	hi = ra->nCols - 1;
+	while(lo < hi)
+	{
+		mid = (lo + hi + 1) / 2;
+		if(row[mid] - below[mid] <= t)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	*x = ra->xMin + (lo + rngUniform(s)) * ra->cellSize;
+	*y = ra->yMin + (j + rngUniform(s)) * ra->cellSize;
+}
+
+/**
+ * NAME:	freeRaster
+ * DESCRIPTION:	free a raster
+ * PARAMETERS:
+ * 	struct rasterGrid * ra: the raster to free
+ * RETURN: none
+ */
+void freeRaster(struct rasterGrid * ra)
+{
+	if(ra == NULL)
+		return;
+	free(ra->sat);
+	free(ra->stamp);
+	free(ra);
+}
@@ -0,0 +1,28 @@
+#ifndef RASTERH
+#define RASTERH
+
+#include <stdio.h>
+
+struct pointStore;
+struct rngStream;
+
+//a background raster: the number of background points in each cell. the cells are kept as a 2-D summed-area table, so any rectangle of cells is summed in O(1)
+struct rasterGrid {
+	int nCols;
+	int nRows;
+	double xMin;		//the lower left corner of the raster
+	double yMin;
+	double cellSize;
+	double total;		//the sum of all cells
+	double * sat;		//sat[j * (nCols + 1) + i] is the sum of the cells of rows 0 to j - 1 and columns 0 to i - 1, row 0 being the bottom row
+	int * stamp;		//the last cluster each cell was counted for, see rasterClusterMass
+	int nStamp;
+};
+
+struct rasterGrid * readRaster(FILE * file);
+double rasterDiskMass(struct rasterGrid * ra, double x, double y, double radius);
+double rasterClusterMass(struct rasterGrid * ra, struct pointStore * ps, int * points, int n, double radius);
+void sampleRaster(struct rasterGrid * ra, struct rngStream * s, double * x, double * y);
+void freeRaster(struct rasterGrid * ra);
+
+#endif
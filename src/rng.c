@@ -0,0 +1,146 @@
+/**
+ * rng.c
+ * Date: 10/18/2026
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include "rng.h"
+
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+
+/**
+ * NAME:	philox4x32
+ * DESCRIPTION:	the Philox4x32-10 bijection of a 128-bit counter under a 64-bit key
+ * PARAMETERS:
+ * 	const unsigned int * ctr:	the 4 words of the counter
+ * 	const unsigned int * key:	the 2 words of the key
+ * 	unsigned int * out:			the 4 output words
+ * RETURN: none
+ */
+static void philox4x32(const unsigned int * ctr, const unsigned int * key, unsigned int * out)
+{
+	unsigned int c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+	unsigned int k0 = key[0], k1 = key[1];
+	unsigned long long p0, p1;
+
+	for(int round = 0; round < 10; round ++)
+	{
+		p0 = (unsigned long long)PHILOX_M0 * c0;
+		p1 = (unsigned long long)PHILOX_M1 * c2;
+		c0 = (unsigned int)(p1 >> 32) ^ c1 ^ k0;
+		c1 = (unsigned int)p1;
+		c2 = (unsigned int)(p0 >> 32) ^ c3 ^ k1;
+		c3 = (unsigned int)p0;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+/**
+ * NAME:	initRngStream
+ * DESCRIPTION:	start the random stream of a seed and a stream number (e.g. a Monte Carlo replication). the seed is the key and the stream number the upper half of the counter, so streams never overlap
+ * PARAMETERS:
+ * 	struct rngStream * s:		the stream
+ * 	unsigned long long seed:	the seed
+ * 	unsigned long long stream:	the stream number
+ * RETURN: none
+ */
+void initRngStream(struct rngStream * s, unsigned long long seed, unsigned long long stream)
+{
+	s->key[0] = (unsigned int)seed;
+	s->key[1] = (unsigned int)(seed >> 32);
+	s->ctr[0] = 0;
+	s->ctr[1] = 0;
+	s->ctr[2] = (unsigned int)stream;
+	s->ctr[3] = (unsigned int)(stream >> 32);
+	s->nBuf = 0;
+}
+
+/**
+ * NAME:	rngNext
+ * DESCRIPTION:	draw the next 32 random bits of a stream
+ * PARAMETERS:
+ * 	struct rngStream * s:	the stream
+ * RETURN:
+ * 	TYPE:	unsigned int
+ * 	VALUE:	a uniform 32-bit random number
+ */
+unsigned int rngNext(struct rngStream * s)
+{
+	if(s->nBuf == 0)
+	{
+		philox4x32(s->ctr, s->key, s->buf);
+		if(++ s->ctr[0] == 0)
+			s->ctr[1] ++;
+		s->nBuf = 4;
+	}
+	s->nBuf --;
+	return s->buf[s->nBuf];
+}
+
+/**
+ * NAME:	rngBounded
+ * DESCRIPTION:	draw a uniform integer below a bound without modulo bias, using Lemire's multiply-and-reject method, which only divides in the rare case a draw may have to be rejected
+ * PARAMETERS:
+ * 	struct rngStream * s:	the stream
+ * 	unsigned int range:		the bound (positive)
+ * RETURN:
+ * 	TYPE:	unsigned int
+ * 	VALUE:	a uniform integer in [0, range)
+ */
+unsigned int rngBounded(struct rngStream * s, unsigned int range)
+{
+	unsigned long long m = (unsigned long long)rngNext(s) * range;
+	unsigned int l = (unsigned int)m;
+	if(l < range)
+	{
+		unsigned int t = (0U - range) % range;
+		while(l < t)
+		{
+			m = (unsigned long long)rngNext(s) * range;
+			l = (unsigned int)m;
+		}
+	}
+	return (unsigned int)(m >> 32);
+}
+
+/**
+ * NAME:	rngUniform
+ * DESCRIPTION:	draw a uniform double from 53 random bits
+ * PARAMETERS:
+ * 	struct rngStream * s:	the stream
+ * RETURN:
+ * 	TYPE:	double
+ * 	VALUE:	a uniform number in [0, 1)
+ */
+double rngUniform(struct rngStream * s)
+{
+	unsigned long long hi = rngNext(s) >> 5;
+	unsigned long long lo = rngNext(s) >> 6;
+	return (double)((hi << 26) | lo) / 9007199254740992.0;
+}
+
+/**
+ * NAME:	randomSeed
+ * DESCRIPTION:	draw a seed from the system entropy source, for runs that are not given one
+ * PARAMETERS: none
+ * RETURN:
+ * 	TYPE:	unsigned long long
+ * 	VALUE:	a random 64-bit seed
+ */
+unsigned long long randomSeed()
+{
+	std::random_device rd;
+	return ((unsigned long long)rd() << 32) ^ rd();
+}
@@ -0,0 +1,18 @@
+#ifndef RNGH
+#define RNGH
+
+//a Philox4x32-10 stream: the numbers only depend on the key and the counter, so any stream can be generated independently of the others
+struct rngStream {
+	unsigned int key[2];
+	unsigned int ctr[4];
+	unsigned int buf[4];
+	int nBuf;
+};
+
+void initRngStream(struct rngStream * s, unsigned long long seed, unsigned long long stream);
+unsigned int rngNext(struct rngStream * s);
+unsigned int rngBounded(struct rngStream * s, unsigned int range);
+double rngUniform(struct rngStream * s);
+unsigned long long randomSeed();
+
+#endif
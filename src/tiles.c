@@ -0,0 +1,1108 @@
+/**
+ * tiles.c
+ * Date: 10/18/2026
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "io.h"
+#include "points.h"
+#include "options.h"
+#include "countPoints.h"
+#include "clusters.h"
+#include "tiles.h"
+
+//where a point of a tile file lies: in the tile only, in the tile and the halo of others, or in the halo of the tile
+#define POINT_INNER 0
+#define POINT_EDGE 1
+#define POINT_HALO 2
+
+//the position of a point in the storage order of an index of all points, see storageKey
+struct orderKey {
+	unsigned long long block;
+	unsigned long long point;
+	int id;
+};
+
+//a tile and its halo, indexed and stored like all points are in memory
+struct tileWork {
+	int count;
+	struct pointStore * ps;
+	struct gridIndex * g;
+	int * id;				//the input position of each stored point
+	char * place;			//POINT_INNER, POINT_EDGE or POINT_HALO
+	struct orderKey * key;	//the storage order of the points of the tile (not set for the halo)
+};
+
+//an event core point in the halo of another tile, with the union-find forest that joins the clusters crossing tile borders
+struct edgeCore {
+	int id;
+	int parent;
+	int cores;				//the number of core points of the clusters joined at this point, and the first of them
+	struct orderKey key;
+};
+
+//a cluster with enough core points, with the points that joined it from all tiles
+struct tileCluster {
+	struct orderKey key;
+	int count0;
+	int count1;
+};
+
+/**
+ * NAME:	keyBefore
+ * DESCRIPTION:	test whether a point comes before another one in the storage order of an index of all points
+ */
+static inline bool keyBefore(struct orderKey * a, struct orderKey * b)
+{
+	if(a->block != b->block)
+		return a->block < b->block;
+	if(a->point != b->point)
+		return a->point < b->point;
+	return a->id < b->id;
+}
+
+/**
+ * NAME:	findRoot
+ * DESCRIPTION:	find the root of a point in a union-find forest, halving the path on the way
+ */
+static inline int findRoot(int * parent, int i)
+{
+	while(parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+/**
+ * NAME:	joinRoots
+ * DESCRIPTION:	join the trees of two points in a union-find forest, the smaller root becoming the root of both
+ */
+static inline void joinRoots(int * parent, int a, int b)
+{
+	a = findRoot(parent, a);
+	b = findRoot(parent, b);
+	if(a < b)
+		parent[b] = a;
+	else if(b < a)
+		parent[a] = b;
+}
+
+/**
+ * NAME:	findEdgeRoot
+ * DESCRIPTION:	findRoot for the forest of the edge core points
+ */
+static inline int findEdgeRoot(struct edgeCore * edge, int e)
+{
+	while(edge[e].parent != e)
+	{
+		edge[e].parent = edge[edge[e].parent].parent;
+		e = edge[e].parent;
+	}
+	return e;
+}
+
+/**
+ * NAME:	compareEdgeID
+ * DESCRIPTION:	compare two edge core points by their input position for qsort and bsearch
+ */
+static int compareEdgeID(const void * a, const void * b)
+{
+	return ((const struct edgeCore *)a)->id - ((const struct edgeCore *)b)->id;
+}
+
+/**
+ * NAME:	findEdge
+ * DESCRIPTION:	find an edge core point by its input position
+ * PARAMETERS:
+ * 	struct edgeCore * edge:	the edge core points, sorted by input position
+ * 	int nEdge:		the number of edge core points
+ * 	int id:			the input position of the point
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the index of the point in edge, or -1 if it is not an edge core point
+ */
+static int findEdge(struct edgeCore * edge, int nEdge, int id)
+{
+	struct edgeCore key;
+	struct edgeCore * found;
+	key.id = id;
+	if(NULL == (found = (struct edgeCore *)bsearch(&key, edge, nEdge, sizeof(struct edgeCore), compareEdgeID)))
+		return -1;
+	return (int)(found - edge);
+}
+
+/**
+ * NAME:	tilesOfPoint
+ * DESCRIPTION:	find the tiles a point is stored in: the tile it falls in, and the tiles whose halo holds it because it is in a radius-sized block on their border
+ * PARAMETERS:
+ * 	struct tileSet * ts:	the tiles
+ * 	double x, double y:		the point
+ * 	int * tiles:			output, the tile of the point first, then up to 8 tiles whose halo holds it
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the number of tiles
+ */
+static int tilesOfPoint(struct tileSet * ts, double x, double y, int * tiles)
+{
+	int colID = (int)((x - ts->xMin) / ts->radius);
+	int rowID = (int)((y - ts->yMin) / ts->radius);
+	int tc = colID / ts->tileRadii;
+	int tr = rowID / ts->tileRadii;
+	int c0 = (colID % ts->tileRadii == 0 && tc > 0) ? tc - 1 : tc;
+	int c1 = (colID % ts->tileRadii == ts->tileRadii - 1 && tc < ts->nTileX - 1) ? tc + 1 : tc;
+	int r0 = (rowID % ts->tileRadii == 0 && tr > 0) ? tr - 1 : tr;
+	int r1 = (rowID % ts->tileRadii == ts->tileRadii - 1 && tr < ts->nTileY - 1) ? tr + 1 : tr;
+	int n = 1;
+
+	tiles[0] = tr * ts->nTileX + tc;
+	for(int r = r0; r <= r1; r++)
+	{
+		for(int c = c0; c <= c1; c++)
+		{
+			if(r != tr || c != tc)
+				tiles[n ++] = r * ts->nTileX + c;
+		}
+	}
+	return n;
+}
+
+/**
+ * NAME:	flushTile
+ * DESCRIPTION:	write the buffered records of a tile to its place in the tile file
+ */
+static void flushTile(struct tileSet * ts, int t, struct tilePoint * buffer, int * nBuffer, long long * next)
+{
+	if(0 != fseeko(ts->file, (off_t)next[t] * sizeof(struct tilePoint), SEEK_SET) || (size_t)nBuffer[t] != fwrite(buffer + (long long)t * TILE_BUFFER, sizeof(struct tilePoint), nBuffer[t], ts->file))
+	{
+		printf("ERROR: Can't write the tile file.\n");
+		exit(1);
+	}
+	next[t] += nBuffer[t];
+	nBuffer[t] = 0;
+}
+
+/**
+ * NAME:	partitionTiles
+ * DESCRIPTION:	partition the points of some input files into tiles of tileRadii * tileRadii search radii with their halos, written to a temporary file. the inputs are read twice, once to size the tiles and once to fill them, and only a small buffer per tile is kept in memory
+ * PARAMETERS:
+ * 	FILE ** inputs:		the input files, whose points are numbered one file after another
+ * 	int nInputs:		the number of input files
+ * 	double xMin:		the minimum X of all points
+ * 	double yMin:		the minimum Y of all points
+ * 	double xMax:		the maximum X of all points
+ * 	double yMax:		the maximum Y of all points
+ * 	double radius:		the search radius, which is also the width of the halo
+ * 	int tileRadii:		the side length of a tile in search radii
+ * 	const char * tmpDir:	the directory of the tile file (NULL: $TMPDIR, or /tmp)
+ * RETURN:
+ * 	TYPE:	struct tileSet *
+ * 	VALUE:	the tiles
+ */
+struct tileSet * partitionTiles(FILE ** inputs, int nInputs, double xMin, double yMin, double xMax, double yMax, double radius, int tileRadii, const char * tmpDir)
+{
+	struct tileSet * ts;
+	struct tilePoint * buffer;
+	int * nBuffer;
+	long long * next;
+	struct tilePoint p;
+	double x, y;
+	int tiles[9];
+	int n, id, w;
+
+	if(NULL == (ts = (struct tileSet *)malloc(sizeof(struct tileSet))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	ts->xMin = xMin;
+	ts->yMin = yMin;
+	ts->xMax = xMax;
+	ts->yMax = yMax;
+	ts->radius = radius;
+	ts->tileRadii = tileRadii;
+	ts->nTileX = ((int)((xMax - xMin) / radius) + tileRadii) / tileRadii;
+	ts->nTileY = ((int)((yMax - yMin) / radius) + tileRadii) / tileRadii;
+
+	int nTiles = ts->nTileX * ts->nTileY;
+
+	if(NULL == (ts->first = (long long *)calloc(nTiles + 1, sizeof(long long))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	//Read all points the 1st time to get the number of records of each tile
+
+	for(int f = 0; f < nInputs; f++)
+	{
+		rewind(inputs[f]);
+		while(readPoint(inputs[f], &x, &y, &w))
+		{
+			n = tilesOfPoint(ts, x, y, tiles);
+			for(int k = 0; k < n; k++)
+				ts->first[tiles[k] + 1] ++;
+		}
+	}
+	ts->maxRecords = 0;
+	for(int t = 0; t < nTiles; t++)
+	{
+		if(ts->first[t + 1] > ts->maxRecords)
+			ts->maxRecords = (int)ts->first[t + 1];
+		ts->first[t + 1] += ts->first[t];
+	}
+
+	//Read all points the 2nd time to write them to their tiles
+
+	if(NULL == (ts->file = openTempFile(tmpDir)))
+	{
+		printf("ERROR: Can't create the tile file in %s.\n", tmpDir != NULL ? tmpDir : "$TMPDIR or /tmp");
+		exit(1);
+	}
+	if(NULL == (buffer = (struct tilePoint *)malloc(sizeof(struct tilePoint) * TILE_BUFFER * nTiles)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (nBuffer = (int *)calloc(nTiles, sizeof(int))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (next = (long long *)malloc(sizeof(long long) * nTiles)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int t = 0; t < nTiles; t++)
+		next[t] = ts->first[t];
+
+	memset(&p, 0, sizeof(struct tilePoint));
+	id = 0;
+	for(int f = 0; f < nInputs; f++)
+	{
+		rewind(inputs[f]);
+		while(readPoint(inputs[f], &p.x, &p.y, &w))
+		{
+			p.id = id ++;
+			n = tilesOfPoint(ts, p.x, p.y, tiles);
+			for(int k = 0; k < n; k++)
+			{
+				buffer[(long long)tiles[k] * TILE_BUFFER + nBuffer[tiles[k]]] = p;
+				if(++ nBuffer[tiles[k]] == TILE_BUFFER)
+					flushTile(ts, tiles[k], buffer, nBuffer, next);
+			}
+		}
+	}
+	for(int t = 0; t < nTiles; t++)
+	{
+		if(nBuffer[t] > 0)
+			flushTile(ts, t, buffer, nBuffer, next);
+	}
+
+	free(buffer);
+	free(nBuffer);
+	free(next);
+	return ts;
+}
+
+/**
+ * NAME:	readTile
+ * DESCRIPTION:	read the records of a tile from the tile file
+ * PARAMETERS:
+ * 	struct tileSet * ts:	the tiles
+ * 	int t:					the tile
+ * RETURN:
+ * 	TYPE:	struct tilePoint *
+ * 	VALUE:	the records of the tile, in input order
+ */
+static struct tilePoint * readTile(struct tileSet * ts, int t)
+{
+	long long n = ts->first[t + 1] - ts->first[t];
+	struct tilePoint * recs;
+
+	if(NULL == (recs = (struct tilePoint *)malloc(sizeof(struct tilePoint) * (n + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(0 != fseeko(ts->file, (off_t)ts->first[t] * sizeof(struct tilePoint), SEEK_SET) || (size_t)n != fread(recs, sizeof(struct tilePoint), n, ts->file))
+	{
+		printf("ERROR: Can't read the tile file.\n");
+		exit(1);
+	}
+	return recs;
+}
+
+/**
+ * NAME:	pickSubdivideTiles
+ * DESCRIPTION:	pickSubdivide for points in tiles, reading one tile at a time. every radius-sized block falls in one tile, so the density is the same as that of all points in memory
+ * PARAMETERS:
+ * 	struct tileSet * ts:	the tiles
+ * 	int count:				the number of points
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the number of blocks per search radius, 1 to MAX_SUBDIVIDE
+ */
+int pickSubdivideTiles(struct tileSet * ts, int count)
+{
+	int tr = ts->tileRadii;
+	int * pointsInB;
+	struct tilePoint * recs;
+	int tiles[9];
+	double density = 0;
+
+	if(count == 0)
+		return 1;
+	if(NULL == (pointsInB = (int *)malloc(sizeof(int) * tr * tr)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int t = 0; t < ts->nTileX * ts->nTileY; t++)
+	{
+		for(int b = 0; b < tr * tr; b++)
+			pointsInB[b] = 0;
+		recs = readTile(ts, t);
+		for(long long i = 0; i < ts->first[t + 1] - ts->first[t]; i++)
+		{
+			tilesOfPoint(ts, recs[i].x, recs[i].y, tiles);
+			if(tiles[0] == t)
+				pointsInB[((int)((recs[i].y - ts->yMin) / ts->radius) % tr) * tr + (int)((recs[i].x - ts->xMin) / ts->radius) % tr] ++;
+		}
+		for(int b = 0; b < tr * tr; b++)
+			density += (double)pointsInB[b] * pointsInB[b];
+		free(recs);
+	}
+	free(pointsInB);
+
+	return subdivideForDensity(density / count, count, ts->xMin, ts->yMin, ts->xMax, ts->yMax, ts->radius);
+}
+
+/**
+ * NAME:	openTile
+ * DESCRIPTION:	read a tile with its halo, index and store its points as all points are in memory, and find where each point of the tile is in the storage order of an index of all points
+ * PARAMETERS:
+ * 	struct tileSet * ts:	the tiles
+ * 	int t:					the tile
+ * 	int countType0:			the number of points of type 0, which come first in the inputs
+ * 	struct options * opts:	the precision, order and subdivide of the index and store
+ * 	struct tileWork * w:	output, the tile
+ * RETURN:
+ * 	TYPE:	bool
+ * 	VALUE:	false if the tile and its halo hold no points
+ */
+static bool openTile(struct tileSet * ts, int t, int countType0, struct options * opts, struct tileWork * w)
+{
+	int n = (int)(ts->first[t + 1] - ts->first[t]);
+	struct tilePoint * recs;
+	double * x;
+	double * y;
+	int * ind;
+	int * type;
+	char * placeOf;
+	int * blockOf;
+	int * pointsInB;
+	int tiles[9];
+	int nTiles;
+	double txMin, tyMin, txMax, tyMax;
+
+	w->count = n;
+	if(n == 0)
+		return false;
+
+	recs = readTile(ts, t);
+
+	if(NULL == (x = (double *)malloc(sizeof(double) * n)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (y = (double *)malloc(sizeof(double) * n)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (ind = (int *)malloc(sizeof(int) * n)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (placeOf = (char *)malloc(sizeof(char) * n)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (blockOf = (int *)malloc(sizeof(int) * n)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	txMin = txMax = recs[0].x;
+	tyMin = tyMax = recs[0].y;
+	for(int i = 0; i < n; i++)
+	{
+		x[i] = recs[i].x;
+		y[i] = recs[i].y;
+		ind[i] = i;
+		txMin = (x[i] < txMin) ? x[i] : txMin;
+		txMax = (x[i] > txMax) ? x[i] : txMax;
+		tyMin = (y[i] < tyMin) ? y[i] : tyMin;
+		tyMax = (y[i] > tyMax) ? y[i] : tyMax;
+		nTiles = tilesOfPoint(ts, x[i], y[i], tiles);
+		if(tiles[0] != t)
+			placeOf[i] = POINT_HALO;
+		else
+			placeOf[i] = (nTiles > 1) ? POINT_EDGE : POINT_INNER;
+	}
+
+	//the number of points of the tile in each block of an index of all points, which decides whether the block is sorted
+	double blockSize = ts->radius / opts->subdivide;
+	int col0 = (int)((txMin - ts->xMin) / blockSize);
+	int row0 = (int)((tyMin - ts->yMin) / blockSize);
+	int nCol = (int)((txMax - ts->xMin) / blockSize) - col0 + 1;
+	int nRow = (int)((tyMax - ts->yMin) / blockSize) - row0 + 1;
+	if(NULL == (pointsInB = (int *)calloc((size_t)nCol * nRow, sizeof(int))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int i = 0; i < n; i++)
+	{
+		blockOf[i] = ((int)((y[i] - ts->yMin) / blockSize) - row0) * nCol + (int)((x[i] - ts->xMin) / blockSize) - col0;
+		if(placeOf[i] != POINT_HALO)
+			pointsInB[blockOf[i]] ++;
+	}
+
+	w->g = indexPoints(x, y, ind, n, txMin, tyMin, txMax, tyMax, ts->radius, opts->subdivide, opts->order);
+
+	if(NULL == (type = (int *)malloc(sizeof(int) * n)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (w->id = (int *)malloc(sizeof(int) * n)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (w->place = (char *)malloc(sizeof(char) * n)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (w->key = (struct orderKey *)malloc(sizeof(struct orderKey) * n)))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	struct tilePoint * r;
+	for(int i = 0; i < n; i++)
+	{
+		r = recs + ind[i];
+		w->id[i] = r->id;
+		w->place[i] = placeOf[ind[i]];
+		type[i] = (r->id >= countType0) ? 1 : 0;
+		if(w->place[i] != POINT_HALO)
+		{
+			storageKey(r->x, r->y, ts->xMin, ts->yMin, ts->xMax, ts->yMax, ts->radius, opts->subdivide, opts->order, pointsInB[blockOf[ind[i]]], &w->key[i].block, &w->key[i].point);
+			w->key[i].id = r->id;
+		}
+	}
+	free(ind);
+	free(recs);
+	free(placeOf);
+	free(blockOf);
+	free(pointsInB);
+
+	//the store is quantized from the bounding box of all points, so the coordinates and neighbor tests are those of all points in memory. a tile is small enough to keep its input coordinates for the output
+	w->ps = buildPointStore(x, y, type, n, opts->precision, ts->xMin, ts->yMin, ts->xMax, ts->yMax, opts->resolution, true);
+	boundBlocks(w->g, w->ps);
+	return true;
+}
+
+/**
+ * NAME:	closeTile
+ * DESCRIPTION:	free a tile opened by openTile
+ */
+static void closeTile(struct tileWork * w)
+{
+	freePointStore(w->ps);
+	freeGridIndex(w->g);
+	free(w->id);
+	free(w->place);
+	free(w->key);
+}
+
+/**
+ * NAME:	linkCores
+ * DESCRIPTION:	join the event core points of a tile with the event core points within the search radius of them, in the tile or its halo
+ * PARAMETERS:
+ * 	T * x: 			the array of points' X values, in the precision of the point store
+ * 	T * y: 			the array of points' Y values, in the precision of the point store
+ * 	struct gridIndex * g:	the index of the tile and its halo
+ *	D dist2:		the squared search radius in the precision of the point store
+ *	bool * eCore:	whether each point is an event core point
+ *	char * place:	where each point lies, POINT_INNER, POINT_EDGE or POINT_HALO
+ *	int * parent:	the union-find forest of the points
+ * RETURN: none
+ */
+template <typename T, typename D>
+static void linkCores(T * x, T * y, struct gridIndex * g, D dist2, bool * eCore, char * place, int * parent)
+{
+	int blockID, colID, rowID;
+	int nbID, rel, rStart, rEnd;
+	struct blockWalk walk;
+
+	for(int iB = 0; iB < g->nBlockX * g->nBlockY; iB ++)
+	{
+		blockID = g->blocks[iB];
+		colID = blockID % g->nBlockX;
+		rowID = blockID / g->nBlockX;
+		for(int i = g->start[blockID]; i < g->end[blockID]; i++)
+		{
+			if(!eCore[i] || place[i] == POINT_HALO)
+				continue;
+			for(int s = 0; s < g->nStencil; s ++)
+			{
+				if(-1 == (nbID = stencilBlock(g, colID, rowID, s)))
+					continue;
+				startWalk(g, s, nbID, BLOCK_UNKNOWN, &walk);
+				while(nextRange(g, &walk, x[i], y[i], dist2, &rStart, &rEnd, &rel))
+				{
+					for(int j = rStart; j < rEnd; j ++)
+					{
+						if(eCore[j] && j != i && (rel == BLOCK_IN || inDistance(x[i], y[i], x[j], y[j], dist2)))
+							joinRoots(parent, i, j);
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+ * NAME:	firstCluster
+ * DESCRIPTION:	find the cluster a point of a tile that is not an event core point joins. clusterPoi expands the clusters one by one in the storage order of their first core point, and a point joins the first of them to reach it. if that one has too few core points the point is only taken by a later one when non-core points are, and the next cluster expanded takes over its ID and skips the points it reached
+ * PARAMETERS:
+ * 	T * x: 			the array of points' X values, in the precision of the point store
+ * 	T * y: 			the array of points' Y values, in the precision of the point store
+ * 	struct gridIndex * g:	the index of the tile and its halo
+ *	D dist2:		the squared search radius in the precision of the point store
+ *	bool * eCore:	whether each point is an event core point
+ *	int * parent:	the union-find forest of the event core points
+ *	struct orderKey * rootKey:	the first core point of the cluster of each root
+ *	int * rootCluster:	the cluster ID of each root, or minus the ID it is expanded with if it has too few core points
+ *	int i:			the point
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ *	int * reach:	work space for the roots of the clusters that reach the point
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the cluster ID, or -1 if none
+ */
+template <typename T, typename D>
+static int firstCluster(T * x, T * y, struct gridIndex * g, D dist2, bool * eCore, int * parent, struct orderKey * rootKey, int * rootCluster, int i, bool nonCorePoints, int * reach)
+{
+	int blockID = blockOfPoint(g, i);
+	int colID = blockID % g->nBlockX;
+	int rowID = blockID / g->nBlockX;
+	int nbID, rel, rStart, rEnd, root, k;
+	int nReach = 0;
+	int first = -1;
+	struct blockWalk walk;
+
+	for(int s = 0; s < g->nStencil; s ++)
+	{
+		if(-1 == (nbID = stencilBlock(g, colID, rowID, s)))
+			continue;
+		startWalk(g, s, nbID, BLOCK_UNKNOWN, &walk);
+		while(nextRange(g, &walk, x[i], y[i], dist2, &rStart, &rEnd, &rel))
+		{
+			for(int j = rStart; j < rEnd; j ++)
+			{
+				if(eCore[j] && (rel == BLOCK_IN || inDistance(x[i], y[i], x[j], y[j], dist2)))
+				{
+					root = findRoot(parent, j);
+					for(k = 0; k < nReach && reach[k] != root; k++);
+					if(k == nReach)
+						reach[nReach ++] = root;
+				}
+			}
+		}
+	}
+
+	for(int r = 0; r < nReach; r++)
+	{
+		if(nonCorePoints)
+		{
+			if(rootCluster[reach[r]] < 0)
+				continue;
+			for(k = 0; k < nReach && rootCluster[reach[k]] != -rootCluster[reach[r]]; k++);
+			if(k < nReach)
+				continue;
+		}
+		if(first == -1 || keyBefore(rootKey + reach[r], rootKey + first))
+			first = reach[r];
+	}
+	return (first == -1 || rootCluster[first] < 0) ? -1 : rootCluster[first];
+}
+
+/**
+ * NAME:	tileStatus
+ * DESCRIPTION:	read or write whether each point of a tile and its halo passes the Poisson test, kept in a temporary file in the same layout as the tile file
+ */
+static void tileStatus(struct tileSet * ts, FILE * file, int t, char * core, int n, bool write)
+{
+	bool ok = (0 == fseeko(file, (off_t)ts->first[t], SEEK_SET));
+	if(ok)
+		ok = (size_t)n == (write ? fwrite(core, sizeof(char), n, file) : fread(core, sizeof(char), n, file));
+	if(!ok)
+	{
+		printf("ERROR: Can't %s the tile status file.\n", write ? "write" : "read");
+		exit(1);
+	}
+}
+
+/**
+ * NAME:	connectTile
+ * DESCRIPTION:	find the event core points of an opened tile and its halo, and join them within the tile. the core points of the halo are the edge core points of the other tiles
+ * PARAMETERS:
+ * 	struct tileWork * w:	the tile
+ * 	char * core:			whether each point of the tile passes the Poisson test
+ * 	struct edgeCore * edge:	the edge core points of all tiles
+ * 	int nEdge:				the number of edge core points
+ * 	double radius:			the search radius
+ * 	bool * eCore:			output, whether each point is an event core point
+ * 	int * parent:			output, the union-find forest of the event core points
+ * RETURN: none
+ */
+static void connectTile(struct tileWork * w, char * core, struct edgeCore * edge, int nEdge, double radius, bool * eCore, int * parent)
+{
+	struct pointStore * ps = w->ps;
+	for(int i = 0; i < w->count; i++)
+	{
+		if(w->place[i] == POINT_HALO)
+			eCore[i] = (findEdge(edge, nEdge, w->id[i]) >= 0);
+		else
+			eCore[i] = core[i] && GET_LABEL(ps->label, i) == 1;
+		parent[i] = i;
+	}
+	if(ps->precision == PRECISION_FLOAT)
+		linkCores(ps->xf, ps->yf, w->g, floatDist2(radius), eCore, w->place, parent);
+	else if(ps->precision == PRECISION_INT)
+		linkCores(ps->xq, ps->yq, w->g, quantDist2(ps, radius), eCore, w->place, parent);
+	else
+		linkCores(ps->x, ps->y, w->g, radius * radius, eCore, w->place, parent);
+}
+
+/**
+ * NAME:	compareClusterKey
+ * DESCRIPTION:	order clusters by their first core point for qsort
+ */
+static int compareClusterKey(const void * a, const void * b)
+{
+	struct tileCluster * ca = *(struct tileCluster **)a;
+	struct tileCluster * cb = *(struct tileCluster **)b;
+	if(keyBefore(&ca->key, &cb->key))
+		return -1;
+	return keyBefore(&cb->key, &ca->key) ? 1 : 0;
+}
+
+/**
+ * NAME:	clusterRank
+ * DESCRIPTION:	count the clusters whose first core point comes before a point, by binary search
+ * PARAMETERS:
+ * 	struct tileCluster ** ordered:	the clusters, ordered by their first core point
+ * 	int nClusters:		the number of clusters
+ * 	struct orderKey * key:	the point
+ * RETURN:
+ * 	TYPE:	int
+ * 	VALUE:	the number of clusters before the point
+ */
+static int clusterRank(struct tileCluster ** ordered, int nClusters, struct orderKey * key)
+{
+	int lo = 0;
+	int hi = nClusters;
+	int mid;
+	while(lo < hi)
+	{
+		mid = (lo + hi) / 2;
+		if(keyBefore(&ordered[mid]->key, key))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/**
+ * NAME:	addCluster
+ * DESCRIPTION:	add a cluster with enough core points, growing the array of clusters as needed
+ */
+static void addCluster(struct tileCluster ** pClusters, int * pN, int * pCap, struct orderKey * key)
+{
+	if(*pN == *pCap)
+	{
+		*pCap = (*pCap == 0) ? 256 : (*pCap * 2);
+		if(NULL == (*pClusters = (struct tileCluster *)realloc(*pClusters, sizeof(struct tileCluster) * *pCap)))
+		{
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+	}
+	(*pClusters)[*pN].key = *key;
+	(*pClusters)[*pN].count0 = 0;
+	(*pClusters)[*pN].count1 = 0;
+	(*pN) ++;
+}
+
+/**
+ * NAME:	clusterPoiTiles
+ * DESCRIPTION:	cluster all event points based on a Possion Test as clusterPoi does, reading one tile at a time, and write the event points with their cluster IDs. the tiles are read three times: to count the neighbors of their points and keep whether they pass the test; to join the event core points within each tile and, through a union-find forest of the core points in the halos, across tiles; and to assign the other points and write the output. clusters are numbered in the storage order of their first core point, as clusterPoi numbers them, so the clusters and their info are the same as in memory; the points are written tile by tile
+ * PARAMETERS:
+ * 	struct tileSet * ts:	the tiles of the background and event points, background first
+ *	int countB:			the number of background points
+ *	int countE:			the number of event points
+ *	double baseLineRatio:	the ratio of the null hypothesis to the baseline, scaling the local lambda of each point
+ *	double significance: 	the significane level to tell a cluste core point
+ *	int minCore:		the minimum number of core points in each cluster (each cluste should have more core points than minCore)
+ *	bool nonCorePoints:	whether a cluster include non-core points
+ *	struct options * opts:	the precision, order and subdivide (already picked) of the tile indexes
+ *	const char * output:	the output file of event points
+ * RETURN:
+ * 	TYPE:	struct clusterInfo *
+ * 	VALUE:	the info of the clusters
+ */
+struct clusterInfo * clusterPoiTiles(struct tileSet * ts, int countB, int countE, double baseLineRatio, double significance, int minCore, bool nonCorePoints, struct options * opts, const char * output)
+{
+	int nTiles = ts->nTileX * ts->nTileY;
+	int maxN = ts->maxRecords;
+	struct tileWork w;
+	struct pointStore * ps;
+	struct neighborCounts * nc;
+	FILE * statusFile;
+	FILE * outputFile;
+	char * core;
+	bool * eCore;
+	int * parent;
+	int * rootEdge;
+	int * rootCores;
+	struct orderKey * rootKey;
+	int * rootCluster;
+	int * reach;
+	struct edgeCore * edge = NULL;
+	int nEdge = 0, capEdge = 0;
+	struct tileCluster * clusters = NULL;
+	int nClusters = 0, capClusters = 0;
+	int root, e, rank, cluster;
+
+	if(NULL == (core = (char *)malloc(sizeof(char) * (maxN + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (statusFile = openTempFile(opts->tmpDir)))
+	{
+		printf("ERROR: Can't create the tile status file in %s.\n", opts->tmpDir != NULL ? opts->tmpDir : "$TMPDIR or /tmp");
+		exit(1);
+	}
+
+	//1st pass: count the neighbors of the points of each tile, the halo holds every point within the search radius of them
+
+	for(int t = 0; t < nTiles; t++)
+	{
+		if(!openTile(ts, t, countB, opts, &w))
+			continue;
+		nc = allocNeighborCounts(w.count, maxStencilCount(w.g), true);
+		countInDistance(w.ps, w.ps->label, w.g, ts->radius, nc);
+		for(int i = 0; i < w.count; i++)
+		{
+			core[i] = (w.place[i] != POINT_HALO && PossionTest(COUNT_AT(nc, nc->c1, i), (double)(COUNT_AT(nc, nc->c0, i)) * countE * baseLineRatio / countB) < significance);
+			if(core[i] && w.place[i] == POINT_EDGE && GET_LABEL(w.ps->label, i) == 1)
+			{
+				if(nEdge == capEdge)
+				{
+					capEdge = (capEdge == 0) ? 1024 : capEdge * 2;
+					if(NULL == (edge = (struct edgeCore *)realloc(edge, sizeof(struct edgeCore) * capEdge)))
+					{
+						printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+						exit(1);
+					}
+				}
+				edge[nEdge].id = w.id[i];
+				nEdge ++;
+			}
+		}
+		tileStatus(ts, statusFile, t, core, w.count, true);
+		freeNeighborCounts(nc);
+		closeTile(&w);
+	}
+
+	qsort(edge, nEdge, sizeof(struct edgeCore), compareEdgeID);
+	for(e = 0; e < nEdge; e++)
+	{
+		edge[e].parent = e;
+		edge[e].cores = 0;
+	}
+
+	if(NULL == (eCore = (bool *)malloc(sizeof(bool) * (maxN + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (parent = (int *)malloc(sizeof(int) * (maxN + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (rootEdge = (int *)malloc(sizeof(int) * (maxN + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (rootCores = (int *)malloc(sizeof(int) * (maxN + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (rootKey = (struct orderKey *)malloc(sizeof(struct orderKey) * (maxN + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (rootCluster = (int *)malloc(sizeof(int) * (maxN + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (reach = (int *)malloc(sizeof(int) * (maxN + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	//2nd pass: join the core points within each tile, and the clusters of a tile with those of the tiles around it through the edge core points they share. the core points of a cluster crossing tile borders are counted at one of its edge core points, the others are complete within the tile
+
+	for(int t = 0; t < nTiles; t++)
+	{
+		if(!openTile(ts, t, countB, opts, &w))
+			continue;
+		tileStatus(ts, statusFile, t, core, w.count, false);
+		connectTile(&w, core, edge, nEdge, ts->radius, eCore, parent);
+		for(int i = 0; i < w.count; i++)
+		{
+			rootEdge[i] = -1;
+			rootCores[i] = 0;
+		}
+		for(int i = 0; i < w.count; i++)
+		{
+			if(!eCore[i] || w.place[i] == POINT_INNER)
+				continue;
+			root = findRoot(parent, i);
+			e = findEdge(edge, nEdge, w.id[i]);
+			if(rootEdge[root] == -1)
+				rootEdge[root] = e;
+			else if(findEdgeRoot(edge, e) != findEdgeRoot(edge, rootEdge[root]))
+				edge[findEdgeRoot(edge, e)].parent = findEdgeRoot(edge, rootEdge[root]);
+		}
+		for(int i = 0; i < w.count; i++)
+		{
+			if(!eCore[i] || w.place[i] == POINT_HALO)
+				continue;
+			root = findRoot(parent, i);
+			if(-1 != (e = rootEdge[root]))
+			{
+				if(edge[e].cores == 0 || keyBefore(w.key + i, &edge[e].key))
+					edge[e].key = w.key[i];
+				edge[e].cores ++;
+			}
+			else
+			{
+				if(rootCores[root] == 0 || keyBefore(w.key + i, rootKey + root))
+					rootKey[root] = w.key[i];
+				rootCores[root] ++;
+			}
+		}
+		for(int i = 0; i < w.count; i++)
+		{
+			if(eCore[i] && parent[i] == i && rootEdge[i] == -1 && rootCores[i] > minCore)
+				addCluster(&clusters, &nClusters, &capClusters, rootKey + i);
+		}
+		closeTile(&w);
+	}
+
+	//gather the core points of each cluster crossing tile borders at its root
+	for(e = 0; e < nEdge; e++)
+	{
+		root = findEdgeRoot(edge, e);
+		if(root == e || edge[e].cores == 0)
+			continue;
+		if(edge[root].cores == 0 || keyBefore(&edge[e].key, &edge[root].key))
+			edge[root].key = edge[e].key;
+		edge[root].cores += edge[e].cores;
+	}
+	for(e = 0; e < nEdge; e++)
+	{
+		if(edge[e].parent == e && edge[e].cores > minCore)
+			addCluster(&clusters, &nClusters, &capClusters, &edge[e].key);
+	}
+
+	//number the clusters in the order clusterPoi expands them
+
+	struct tileCluster ** ordered;
+	if(NULL == (ordered = (struct tileCluster **)malloc(sizeof(struct tileCluster *) * (nClusters + 1))))
+	{
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int c = 0; c < nClusters; c++)
+		ordered[c] = clusters + c;
+	qsort(ordered, nClusters, sizeof(struct tileCluster *), compareClusterKey);
+
+	//3rd pass: find the cluster of every point of each tile and write the event points
+
+	if(NULL == (outputFile = fopen(output, "w"))) {
+		printf("ERROR: Can't open the output file.\n");
+		exit(1);
+	}
+
+	for(int t = 0; t < nTiles; t++)
+	{
+		if(!openTile(ts, t, countB, opts, &w))
+			continue;
+		tileStatus(ts, statusFile, t, core, w.count, false);
+		connectTile(&w, core, edge, nEdge, ts->radius, eCore, parent);
+
+		//the first core point and the number of core points of each cluster, taken from the edge core points for those crossing tile borders
+		for(int i = 0; i < w.count; i++)
+		{
+			rootEdge[i] = -1;
+			rootCores[i] = 0;
+		}
+		for(int i = 0; i < w.count; i++)
+		{
+			if(eCore[i] && w.place[i] != POINT_INNER)
+				rootEdge[findRoot(parent, i)] = findEdgeRoot(edge, findEdge(edge, nEdge, w.id[i]));
+		}
+		for(int i = 0; i < w.count; i++)
+		{
+			if(!eCore[i] || w.place[i] == POINT_HALO || rootEdge[root = findRoot(parent, i)] != -1)
+				continue;
+			if(rootCores[root] == 0 || keyBefore(w.key + i, rootKey + root))
+				rootKey[root] = w.key[i];
+			rootCores[root] ++;
+		}
+		for(int i = 0; i < w.count; i++)
+		{
+			if(!eCore[i] || parent[i] != i)
+				continue;
+			if(-1 != (e = rootEdge[i]))
+			{
+				rootCores[i] = edge[e].cores;
+				rootKey[i] = edge[e].key;
+			}
+			//a cluster with too few core points is expanded with the ID of the next cluster
+			rank = clusterRank(ordered, nClusters, rootKey + i);
+			rootCluster[i] = (rootCores[i] > minCore) ? (rank + 1) : -(rank + 1);
+		}
+
+		ps = w.ps;
+		for(int i = 0; i < w.count; i++)
+		{
+			if(w.place[i] == POINT_HALO)
+				continue;
+			if(eCore[i])
+				cluster = rootCluster[findRoot(parent, i)];
+			else if(!nonCorePoints && (!core[i] || GET_LABEL(ps->label, i) == 1))
+				cluster = -1;
+			else if(ps->precision == PRECISION_FLOAT)
+				cluster = firstCluster(ps->xf, ps->yf, w.g, floatDist2(ts->radius), eCore, parent, rootKey, rootCluster, i, nonCorePoints, reach);
+			else if(ps->precision == PRECISION_INT)
+				cluster = firstCluster(ps->xq, ps->yq, w.g, quantDist2(ps, ts->radius), eCore, parent, rootKey, rootCluster, i, nonCorePoints, reach);
+			else
+				cluster = firstCluster(ps->x, ps->y, w.g, ts->radius * ts->radius, eCore, parent, rootKey, rootCluster, i, nonCorePoints, reach);
+			if(cluster < 0)
+				cluster = -1;
+
+			if(GET_LABEL(ps->label, i) == 0)
+			{
+				if(cluster != -1)
+					ordered[cluster - 1]->count0 ++;
+				continue;
+			}
+			if(cluster != -1)
+				ordered[cluster - 1]->count1 ++;
+			fprintf(outputFile, "%lf,%lf,%d\n", ps->x[i], ps->y[i], cluster);
+		}
+		closeTile(&w);
+	}
+
+	fclose(outputFile);
+	fclose(statusFile);
+	free(core);
+	free(eCore);
+	free(parent);
+	free(rootEdge);
+	free(rootCores);
+	free(rootKey);
+	free(rootCluster);
+	free(reach);
+	free(edge);
+
+	struct clusterInfo * cInfo = NULL;
+	struct clusterInfo * curInfo = NULL;
+	for(int c = 0; c < nClusters; c++)
+	{
+		int nEInCluster = ordered[c]->count1;
+		int nBInCluster = ordered[c]->count0;
+		double expEventInCluster = (double)(nBInCluster) / countB * countE;
+		double LL = nEInCluster * log(nEInCluster/expEventInCluster);
+		if(nEInCluster < countE) {
+			LL += (countE - nEInCluster) * log((countE - nEInCluster) / (countE - expEventInCluster));
+		}
+
+		if(c == 0) {
+			cInfo = (struct clusterInfo *) malloc (sizeof (struct clusterInfo));
+			curInfo = cInfo;
+		}
+		else {
+			curInfo->next = (struct clusterInfo *) malloc (sizeof (struct clusterInfo));
+			curInfo = curInfo->next;
+		}
+		curInfo->clusterID = c + 1;
+		curInfo->count1 = nEInCluster;
+		curInfo->count0 = nBInCluster;
+		curInfo->expCount1 = expEventInCluster;
+		curInfo->ll = LL;
+		curInfo->next = NULL;
+	}
+	free(ordered);
+	free(clusters);
+
+	return cInfo;
+}
+
+/**
+ * NAME:	freeTileSet
+ * DESCRIPTION:	free the tiles and remove their temporary file
+ * PARAMETERS:
+ * 	struct tileSet * ts: the tiles to free
+ * RETURN: none
+ */
+void freeTileSet(struct tileSet * ts)
+{
+	if(ts == NULL)
+		return;
+	fclose(ts->file);
+	free(ts->first);
+	free(ts);
+}
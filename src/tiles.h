@@ -0,0 +1,39 @@
+#ifndef TILESH
+#define TILESH
+
+#include <stdio.h>
+
+struct options;
+struct clusterInfo;
+
+//the points of each tile are buffered in blocks of this many before they are written to the tile file
+#define TILE_BUFFER 64
+
+//a point in the tile file. id is the position of the point in the input files taken one after another
+struct tilePoint {
+	double x;
+	double y;
+	int id;
+};
+
+//points partitioned into square tiles of tileRadii * tileRadii search radii. the records of each tile are the points in it and a halo of the points in the radius-sized blocks around it, in input order, and are kept in a temporary file
+struct tileSet {
+	double xMin;
+	double yMin;
+	double xMax;
+	double yMax;
+	double radius;
+	int tileRadii;
+	int nTileX;
+	int nTileY;
+	int maxRecords;		//the most records of any tile
+	long long * first;	//the records of tile t are first[t] to first[t + 1] - 1
+	FILE * file;
+};
+
+struct tileSet * partitionTiles(FILE ** inputs, int nInputs, double xMin, double yMin, double xMax, double yMax, double radius, int tileRadii, const char * tmpDir);
+int pickSubdivideTiles(struct tileSet * ts, int count);
+struct clusterInfo * clusterPoiTiles(struct tileSet * ts, int countB, int countE, double baseLineRatio, double significance, int minCore, bool nonCorePoints, struct options * opts, const char * output);
+void freeTileSet(struct tileSet * ts);
+
+#endif